@@ -0,0 +1,102 @@
+/** @defgroup CM3_bitband_defines Bit-band Defines
+ *
+ * @brief <b>Bit-band alias access for Cortex-M3/M4</b>
+ *
+ * @ingroup CM3_defines
+ *
+ * LGPL License Terms @ref lgpl_license
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_CM3_BITBAND_H
+#define LIBOPENCM3_CM3_BITBAND_H
+
+/**@{*/
+
+/*
+ * The first MiB of SRAM (0x20000000) and of the peripheral space
+ * (0x40000000) are mirrored 32 times in an alias region, one word per bit.
+ * Writing 0 or 1 to an alias word clears or sets just that bit in a single
+ * bus transaction, so no read-modify-write (and no CM_ATOMIC_BLOCK()) is
+ * needed. Reading it returns the bit.
+ *
+ * Only ARMv7-M parts with the optional bit-band feature have the alias
+ * regions: Cortex-M3 and Cortex-M4, but not Cortex-M0/M0+/M23/M33 nor
+ * Cortex-M7. Beware of peripheral registers with bits that are cleared by
+ * writing 1 (or 0): the alias write is still a read-modify-write of the whole
+ * register in hardware.
+ */
+
+#if !defined(__ARM_ARCH_7M__) && !defined(__ARM_ARCH_7EM__)
+#error "Bit-banding is only available on Cortex-M3 and Cortex-M4"
+#endif
+
+#if defined(STM32F7) || defined(STM32H7)
+#error "Cortex-M7 parts have no bit-band regions"
+#endif
+
+#include <libopencm3/cm3/common.h>
+
+#define BITBAND_SRAM_BASE	0x20000000U
+#define BITBAND_SRAM_ALIAS	0x22000000U
+#define BITBAND_PERIPH_BASE	0x40000000U
+#define BITBAND_PERIPH_ALIAS	0x42000000U
+/** Size of each bit-banded region */
+#define BITBAND_REGION_SIZE	0x00100000U
+
+/** Alias word address of bit of the word at addr. Constant when addr and bit
+ * are, so it can be used in static initialisers. */
+#define BITBAND_ADDR(addr, bit) \
+	((((uint32_t)(addr)) & 0xF0000000U) + 0x02000000U + \
+	 ((((uint32_t)(addr)) & 0x000FFFFFU) << 5) + ((uint32_t)(bit) << 2))
+
+/** Alias word of a bit, as an lvalue */
+#define BITBAND(addr, bit)	MMIO32(BITBAND_ADDR(addr, bit))
+
+/** Check that addr lies in one of the bit-banded regions */
+#define BITBAND_VALID(addr) \
+	((((uint32_t)(addr)) - BITBAND_SRAM_BASE) < BITBAND_REGION_SIZE || \
+	 (((uint32_t)(addr)) - BITBAND_PERIPH_BASE) < BITBAND_REGION_SIZE)
+
+/** Set bit of the 32 bit word at addr */
+static inline void bitband_set(volatile void *addr, uint8_t bit)
+{
+	BITBAND(addr, bit) = 1;
+}
+
+/** Clear bit of the 32 bit word at addr */
+static inline void bitband_clear(volatile void *addr, uint8_t bit)
+{
+	BITBAND(addr, bit) = 0;
+}
+
+/** Write bit of the 32 bit word at addr */
+static inline void bitband_write(volatile void *addr, uint8_t bit, bool value)
+{
+	BITBAND(addr, bit) = value;
+}
+
+/** Read bit of the 32 bit word at addr */
+static inline bool bitband_get(volatile void *addr, uint8_t bit)
+{
+	return BITBAND(addr, bit);
+}
+
+/**@}*/
+
+#endif
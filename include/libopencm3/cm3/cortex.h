@@ -150,6 +150,61 @@ static inline uint32_t cm_mask_faults(uint32_t mask)
 }
 #endif
 
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Get base priority mask
+ *
+ * @returns uint32_t Current BASEPRI value, 0 if no priority masking is active
+ */
+__attribute__((always_inline))
+static inline uint32_t cm_get_basepri(void)
+{
+	register uint32_t result;
+	__asm__ volatile ("MRS %0, BASEPRI"  : "=r" (result));
+	return result;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Set base priority mask
+ *
+ * Interrupts with a priority value numerically greater than or equal to
+ * @p basepri are masked, higher priority interrupts remain enabled. The value
+ * is encoded the same way as for @ref nvic_set_priority. Writing 0 disables
+ * priority masking.
+ *
+ * @param[in] basepri uint32_t New BASEPRI value
+ * @returns uint32_t old BASEPRI value
+ */
+__attribute__((always_inline))
+static inline uint32_t cm_set_basepri(uint32_t basepri)
+{
+	register uint32_t old;
+	__asm__ __volatile__ ("MRS %0, BASEPRI"  : "=r" (old));
+	__asm__ __volatile__ (""  : : : "memory");
+	__asm__ __volatile__ ("MSR BASEPRI, %0" : : "r" (basepri) : "memory");
+	return old;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Raise base priority mask
+ *
+ * Like @ref cm_set_basepri, but uses BASEPRI_MAX so the mask is only changed
+ * if it makes masking stricter. Nested calls therefore never lower the
+ * priority ceiling set by an outer section. A value of 0 is ignored.
+ *
+ * @param[in] basepri uint32_t Priority to mask up to
+ * @returns uint32_t old BASEPRI value, to be passed to @ref cm_set_basepri
+ */
+__attribute__((always_inline))
+static inline uint32_t cm_raise_basepri(uint32_t basepri)
+{
+	register uint32_t old;
+	__asm__ __volatile__ ("MRS %0, BASEPRI"  : "=r" (old));
+	__asm__ __volatile__ ("MSR BASEPRI_MAX, %0" : : "r" (basepri) : "memory");
+	return old;
+}
+#endif
+
 /**@}*/
 
 /*===========================================================================*/
@@ -278,6 +333,58 @@ static inline uint32_t __cm_atomic_set(uint32_t *val)
 #define CM_ATOMIC_CONTEXT()	uint32_t __CM_SAVER(true)
 #endif /* defined(__DOXYGEN__) */
 
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#if !defined(__DOXYGEN__)
+/* Do not populate this definition outside */
+static inline uint32_t __cm_basepri_restore(uint32_t *val)
+{
+	return cm_set_basepri(*val);
+}
+
+#define __CM_BASEPRI_SAVER(prio)					\
+	__bp_save __attribute__((__cleanup__(__cm_basepri_restore))) =	\
+	cm_raise_basepri(prio)
+
+#endif /* !defined(__DOXYGEN) */
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Priority Declare block
+ *
+ * Like @ref CM_ATOMIC_BLOCK, but only masks interrupts whose priority is
+ * numerically greater than or equal to @p prio, leaving more urgent handlers
+ * running. Blocks nest: an inner block never lowers the mask of an outer one,
+ * and the previous BASEPRI is restored on exit of the block.
+ *
+ * @warning The usage of sentences break or continue is prohibited in the block
+ * due to implementation of this macro!
+ *
+ * @code
+ * CM_PRIORITY_BLOCK(0x80) {	// priorities 0x80 ... 0xff are masked
+ *     shared_with_usb_isr++;
+ * }				// BASEPRI is restored automatically
+ * @endcode
+ */
+#if defined(__DOXYGEN__)
+#define CM_PRIORITY_BLOCK(prio)
+#else /* defined(__DOXYGEN__) */
+#define CM_PRIORITY_BLOCK(prio)						\
+	for (uint32_t __CM_BASEPRI_SAVER(prio), __my = true; __my; __my = false)
+#endif /* defined(__DOXYGEN__) */
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Priority Declare context
+ *
+ * Like @ref CM_ATOMIC_CONTEXT, but masks only interrupts of priority @p prio
+ * and lower, from the place where it is declared to the end of the block.
+ */
+#if defined(__DOXYGEN__)
+#define CM_PRIORITY_CONTEXT(prio)
+#else /* defined(__DOXYGEN__) */
+#define CM_PRIORITY_CONTEXT(prio)	uint32_t __CM_BASEPRI_SAVER(prio)
+#endif /* defined(__DOXYGEN__) */
+#endif
+
 /**@}*/
 
 
@@ -146,17 +146,45 @@ IRQ numbers -3 and -6 to -9 are reserved
 
 #include <libopencm3/dispatch/nvic.h>
 
+/* --- NVIC priority ceiling lock ----------------------------------------- */
+
+/** Priority ceiling lock, see @ref nvic_ceiling_init */
+struct nvic_ceiling {
+	/** Most urgent (numerically lowest) priority sharing the data, or 0
+	 * if none does */
+	uint8_t ceiling;
+	/** An interrupt at priority 0 shares the data, which BASEPRI cannot
+	 * mask */
+	bool primask;
+};
+
+/* Marks a PRIMASK state returned from nvic_ceiling_enter() */
+#define NVIC_CEILING_PRIMASK		(1U << 31)
+
 /* --- NVIC functions ------------------------------------------------------ */
 
 BEGIN_DECLS
 
+#if defined(LIBOPENCM3_INLINE)
+static inline void nvic_enable_irq(uint8_t irqn)
+{
+	NVIC_ISER(irqn / 32) = (1 << (irqn % 32));
+}
+#else
 void nvic_enable_irq(uint8_t irqn);
+#endif
 void nvic_disable_irq(uint8_t irqn);
 uint8_t nvic_get_pending_irq(uint8_t irqn);
 void nvic_set_pending_irq(uint8_t irqn);
 void nvic_clear_pending_irq(uint8_t irqn);
 uint8_t nvic_get_irq_enabled(uint8_t irqn);
 void nvic_set_priority(uint8_t irqn, uint8_t priority);
+uint8_t nvic_get_priority(uint8_t irqn);
+
+void nvic_ceiling_init(struct nvic_ceiling *lock, uint8_t ceiling);
+void nvic_ceiling_add_irq(struct nvic_ceiling *lock, uint8_t irqn);
+uint32_t nvic_ceiling_enter(const struct nvic_ceiling *lock);
+void nvic_ceiling_exit(const struct nvic_ceiling *lock, uint32_t state);
 
 /* Those defined only on ARMv7 and above */
 #if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
@@ -54,6 +54,79 @@ void mutex_unlock(mutex_t *m);
 
 #endif
 
+/* --- Lock-free primitives ------------------------------------------------ */
+
+/* The following primitives are usable from any mix of thread and interrupt
+ * context on every core.  ARMv7-M uses LDREX/STREX loops, ARMv6-M (which has
+ * no exclusive monitor) briefly masks interrupts with PRIMASK, and non-ARM
+ * builds use the compiler's C11 atomic builtins so that code built on top of
+ * them can be exercised on a host.
+ */
+
+uint32_t sync_critical_enter(void);
+void sync_critical_exit(uint32_t state);
+
+bool sync_cas(volatile uint32_t *addr, uint32_t expected, uint32_t desired);
+uint32_t sync_fetch_add(volatile uint32_t *addr, uint32_t val);
+uint32_t sync_fetch_or(volatile uint32_t *addr, uint32_t mask);
+uint32_t sync_fetch_and(volatile uint32_t *addr, uint32_t mask);
+
+/* Atomic bit flags: a 32 bit word in which each bit is an independent flag. */
+typedef volatile uint32_t sync_flags_t;
+
+void sync_flags_set(sync_flags_t *flags, uint32_t mask);
+void sync_flags_clear(sync_flags_t *flags, uint32_t mask);
+uint32_t sync_flags_test_and_clear(sync_flags_t *flags, uint32_t mask);
+
+/* Single producer, single consumer ring buffer.
+ *
+ * One context may put, one (other) context may get; no locking is needed.
+ * The element count must be a power of two; the head and tail indices run
+ * freely and wrap, so all count slots are usable.
+ */
+struct sync_ring {
+	uint8_t *buf;
+	uint16_t elem_size;
+	uint32_t mask;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+};
+
+bool sync_ring_init(struct sync_ring *ring, void *buf, uint16_t elem_size,
+		    uint32_t count);
+void sync_ring_reset(struct sync_ring *ring);
+uint32_t sync_ring_level(const struct sync_ring *ring);
+uint32_t sync_ring_space(const struct sync_ring *ring);
+bool sync_ring_put(struct sync_ring *ring, const void *elem);
+bool sync_ring_get(struct sync_ring *ring, void *elem);
+bool sync_ring_peek(const struct sync_ring *ring, void *elem);
+uint32_t sync_ring_write(struct sync_ring *ring, const void *data,
+			 uint32_t count);
+uint32_t sync_ring_read(struct sync_ring *ring, void *data, uint32_t count);
+
+/* Multiple producer, single consumer bounded queue.
+ *
+ * Any number of contexts (threads and interrupts of any priority) may put,
+ * a single context may get.  Each slot carries a sequence word which tells
+ * whether it is free, being filled, or ready; producers claim a slot with a
+ * compare-and-swap on the head index, so a producer interrupted mid-copy
+ * never blocks the others.  seq must provide count words.
+ */
+struct sync_mpsc {
+	uint8_t *buf;
+	volatile uint32_t *seq;
+	uint16_t elem_size;
+	uint32_t mask;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+};
+
+bool sync_mpsc_init(struct sync_mpsc *q, void *buf, uint32_t *seq,
+		    uint16_t elem_size, uint32_t count);
+bool sync_mpsc_put(struct sync_mpsc *q, const void *elem);
+bool sync_mpsc_get(struct sync_mpsc *q, void *elem);
+bool sync_mpsc_empty(const struct sync_mpsc *q);
+
 END_DECLS
 
 #endif
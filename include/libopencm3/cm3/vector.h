@@ -65,4 +65,12 @@ typedef struct {
 extern unsigned _data_loadaddr, _data, _edata, _ebss, _stack;
 extern vector_table_t vector_table;
 
+/** Called from reset_handler() before constructors run and before the .xdram
+ * section is zeroed. Override it to bring up clocks and external memory (eg
+ * with sdram_init()) that static data is placed in. Weak, does nothing by
+ * default. */
+BEGIN_DECLS
+void external_memory_setup(void);
+END_DECLS
+
 #endif
@@ -0,0 +1,87 @@
+/** @addtogroup CM3_bitband_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_STM32_BITBAND_H
+#define LIBOPENCM3_STM32_BITBAND_H
+
+/* Cortex-M3/M4 families; the others have no bit-band regions. */
+#if !defined(STM32F1) && !defined(STM32F2) && !defined(STM32F3) && \
+    !defined(STM32F4) && !defined(STM32L1) && !defined(STM32G4) && \
+    !defined(STM32L4)
+#       error "bitband.h not available for this family."
+#endif
+
+#include <libopencm3/cm3/bitband.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/timer.h>
+
+/**@{*/
+
+/*
+ * Single bit updates of often shared registers without a read-modify-write,
+ * so they are safe against interrupts without masking them. The bit masks
+ * taken by the EXTI and timer wrappers must have exactly one bit set.
+ */
+
+static inline void bitband_rcc_periph_clock_enable(enum rcc_periph_clken clken)
+{
+	BITBAND(RCC_BASE + (clken >> 5), clken & 0x1f) = 1;
+}
+
+static inline void bitband_rcc_periph_clock_disable(enum rcc_periph_clken clken)
+{
+	BITBAND(RCC_BASE + (clken >> 5), clken & 0x1f) = 0;
+}
+
+static inline void bitband_rcc_periph_reset_hold(enum rcc_periph_rst rst)
+{
+	BITBAND(RCC_BASE + (rst >> 5), rst & 0x1f) = 1;
+}
+
+static inline void bitband_rcc_periph_reset_release(enum rcc_periph_rst rst)
+{
+	BITBAND(RCC_BASE + (rst >> 5), rst & 0x1f) = 0;
+}
+
+static inline void bitband_exti_enable_request(uint32_t exti)
+{
+	BITBAND(&EXTI_IMR, __builtin_ctz(exti)) = 1;
+}
+
+static inline void bitband_exti_disable_request(uint32_t exti)
+{
+	BITBAND(&EXTI_IMR, __builtin_ctz(exti)) = 0;
+}
+
+static inline void bitband_timer_enable_irq(uint32_t timer_peripheral,
+					    uint32_t irq)
+{
+	BITBAND(&TIM_DIER(timer_peripheral), __builtin_ctz(irq)) = 1;
+}
+
+static inline void bitband_timer_disable_irq(uint32_t timer_peripheral,
+					     uint32_t irq)
+{
+	BITBAND(&TIM_DIER(timer_peripheral), __builtin_ctz(irq)) = 0;
+}
+
+/**@}*/
+
+#endif
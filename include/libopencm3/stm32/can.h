@@ -36,6 +36,7 @@ LGPL License Terms @ref lgpl_license
 
 #include <libopencm3/stm32/memorymap.h>
 #include <libopencm3/cm3/common.h>
+#include <libopencm3/cm3/sync.h>
 
 /**@{*/
 
@@ -640,6 +641,132 @@ LGPL License Terms @ref lgpl_license
 
 /* FB[31:0]: Filter bits */
 
+/* --- Filter compiler ----------------------------------------------------- */
+
+/*
+ * can_filter_compile() turns a list of wanted identifiers and identifier
+ * ranges into filter bank settings, which can_filter_program() then writes
+ * in one pass. Ranges are split into aligned id/mask blocks; single
+ * identifiers go into list banks (four standard or two extended per bank),
+ * blocks into mask banks (two standard or one extended per bank). When that
+ * needs more banks than allowed, the closest blocks are merged, so that some
+ * unwanted identifiers may pass but no wanted one is dropped.
+ *
+ * The generated filters accept data frames only. The compiler does not touch
+ * the hardware and can be run on a host, with can_filter_match() standing in
+ * for the filter logic.
+ */
+
+/** One identifier, or an inclusive range of identifiers, to accept */
+struct can_filter_rule {
+	uint32_t id;
+	/** Last identifier of the range, id for a single identifier */
+	uint32_t last;
+	bool ext;
+	/** FIFO the frames are routed to, 0 or 1 */
+	uint8_t fifo;
+};
+
+/** Compiler scratch: one id/mask block */
+struct can_filter_block {
+	uint32_t id;
+	/** Bits of id that must match */
+	uint32_t mask;
+	bool ext;
+	uint8_t fifo;
+};
+
+/** Settings of one filter bank, as for can_filter_init() */
+struct can_filter_bank {
+	uint32_t fr1;
+	uint32_t fr2;
+	bool scale_32bit;
+	bool id_list_mode;
+	uint8_t fifo;
+};
+
+/* --- Interrupt driven port ----------------------------------------------- */
+
+/*
+ * A CAN port wraps one bxCAN instance with a software transmit queue and a
+ * receive queue, both serviced from interrupts.
+ *
+ * The transmit queue is kept in arbitration order, and the three hardware
+ * mailboxes always hold the highest priority frames: when a frame is queued
+ * that beats a frame already waiting in a mailbox, that mailbox is aborted
+ * and its frame goes back to the queue. Frames with the same identifier are
+ * sent in the order they were queued.
+ *
+ * Received frames from both FIFOs are moved to a lock-free queue, so the two
+ * receive interrupts may run at different priorities. Reading the queue is
+ * limited to one context.
+ *
+ * The application calls can_port_tx_isr(), can_port_rx0_isr(),
+ * can_port_rx1_isr() and can_port_sce_isr() from the matching vectors and
+ * enables them in the NVIC.
+ */
+
+/** One CAN frame as kept in the port queues */
+struct can_frame {
+	/** 11 bit standard or 29 bit extended identifier */
+	uint32_t id;
+	bool ext;
+	bool rtr;
+	/** Payload length, 0 ... 8 */
+	uint8_t len;
+	/** Receive: index of the matching filter */
+	uint8_t fmi;
+	/** Receive: capture of the time triggered mode timer */
+	uint16_t timestamp;
+	/** Payload, word aligned so it moves to and from the mailbox registers
+	 * as two words */
+	union {
+		uint8_t data8[8];
+		uint32_t data32[2];
+	} data;
+};
+
+/** Counters, only ever incremented by the driver */
+struct can_port_stats {
+	/** Frames transmitted */
+	uint32_t tx_frames;
+	/** Frames taken from the hardware FIFOs */
+	uint32_t rx_frames;
+	/** Mailboxes aborted to make way for a higher priority frame */
+	uint32_t tx_preempted;
+	/** Frames that ended without being sent, e.g. with NART set */
+	uint32_t tx_failed;
+	/** Frames lost because a hardware FIFO overflowed */
+	uint32_t rx_overruns;
+	/** Frames dropped because the receive queue was full */
+	uint32_t rx_dropped;
+	/** Error interrupts with a new last error code */
+	uint32_t bus_errors;
+	/** Transitions to the error passive state */
+	uint32_t error_passive;
+	/** Transitions to bus off */
+	uint32_t bus_off;
+};
+
+struct can_port {
+	uint32_t canport;
+	/** Transmit queue storage, tx_size frames */
+	struct can_frame *tx_queue;
+	uint16_t tx_size;
+	/** Receive queue, see sync_mpsc */
+	struct sync_mpsc rx;
+	volatile struct can_port_stats stats;
+
+	/* State, private to the driver. */
+	uint16_t tx_count;
+	/** Copy of the frame in each mailbox, to requeue it if aborted */
+	struct can_frame mbox[3];
+	uint8_t mbox_busy;
+	uint8_t mbox_abort;
+	/** Error state seen by the last error interrupt */
+	uint32_t esr;
+};
+
 /* --- CAN functions -------------------------------------------------------- */
 
 BEGIN_DECLS
@@ -675,6 +802,26 @@ uint32_t can_receive(uint32_t canport, uint8_t fifo, bool release, uint32_t *id,
 void can_fifo_release(uint32_t canport, uint8_t fifo);
 bool can_available_mailbox(uint32_t canport);
 uint32_t can_fifo_pending(uint32_t canport, uint8_t fifo);
+
+int can_filter_compile(const struct can_filter_rule *rules, uint32_t nrules,
+		       struct can_filter_block *work, uint32_t work_size,
+		       struct can_filter_bank *banks, uint32_t max_banks);
+void can_filter_program(uint32_t first, const struct can_filter_bank *banks,
+			uint32_t nbanks);
+bool can_filter_match(const struct can_filter_bank *banks, uint32_t nbanks,
+		      uint32_t id, bool ext, uint8_t *fifo);
+
+bool can_port_init(struct can_port *port, uint32_t canport,
+		   struct can_frame *tx_queue, uint16_t tx_size,
+		   struct can_frame *rx_buf, uint32_t *rx_seq, uint32_t rx_size);
+void can_port_stop(struct can_port *port);
+int can_port_send(struct can_port *port, const struct can_frame *frame);
+bool can_port_receive(struct can_port *port, struct can_frame *frame);
+uint16_t can_port_tx_pending(struct can_port *port);
+void can_port_tx_isr(struct can_port *port);
+void can_port_rx0_isr(struct can_port *port);
+void can_port_rx1_isr(struct can_port *port);
+void can_port_sce_isr(struct can_port *port);
 END_DECLS
 
 /**@}*/
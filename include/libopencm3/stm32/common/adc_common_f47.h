@@ -0,0 +1,110 @@
+/** @addtogroup adc_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* THIS FILE SHOULD NOT BE INCLUDED DIRECTLY, BUT ONLY VIA ADC.H */
+
+#pragma once
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/*
+ * Multi ADC streaming.
+ *
+ * ADC1 (master) and ADC2, or ADC2 and ADC3 (slaves) convert in one of the
+ * dual or triple modes, and the common data register ADC_CDR is moved into a
+ * circular buffer by a single DMA stream. The buffer is used as two halves:
+ * while the DMA fills one half, the application gets the other one from the
+ * callback. Interleaved triple mode with the common DMA lets three 2.4 Msps
+ * converters deliver 7.2 Msps.
+ *
+ * The application sets up the channels, sample times, resolution and the
+ * trigger (or continuous mode) of each ADC and powers them on. It calls
+ * adc_stream_dma_isr() from the DMA stream interrupt and adc_stream_adc_isr()
+ * from adc_isr(), and enables both in the NVIC.
+ *
+ * An ADC overrun stops the DMA requests. The driver counts it, reports it and
+ * restarts the stream at the start of the buffer; the samples converted in
+ * between are lost.
+ */
+
+/** @defgroup adc_stream_event ADC stream events
+@{*/
+/** An ADC overran, samples were lost */
+#define ADC_STREAM_OVERRUN		(1 << 0)
+/** The DMA stream reported a transfer error and was stopped */
+#define ADC_STREAM_DMA_ERROR		(1 << 1)
+/** The callback for a half ran late, the DMA was already refilling it */
+#define ADC_STREAM_LATE			(1 << 2)
+/**@}*/
+
+struct adc_stream;
+
+/** Called from the DMA interrupt when one half of the buffer is full.
+ * @param stream The stream
+ * @param data First sample of the half
+ * @param transfers Number of DMA transfers in the half: halfwords in
+ * ADC_CCR_DMA_MODE_1 and _3, words in ADC_CCR_DMA_MODE_2
+ */
+typedef void (*adc_stream_cb)(struct adc_stream *stream, void *data,
+			      uint32_t transfers);
+/** Called from interrupt context with @ref adc_stream_event flags */
+typedef void (*adc_stream_event_cb)(struct adc_stream *stream,
+				    uint32_t events);
+
+struct adc_stream {
+	/** Multi ADC mode, ADC_CCR_MULTI_DUAL_* or ADC_CCR_MULTI_TRIPLE_* */
+	uint32_t multi_mode;
+	/** Common DMA mode, @ref adc_dma_mode other than ADC_CCR_DMA_DISABLE */
+	uint32_t dma_mode;
+	/** Sampling phase delay for interleaved modes, @ref adc_delay */
+	uint32_t delay;
+	/** DMA controller, stream and DMA_SxCR_CHSEL_x serving ADC1 */
+	uint32_t dma;
+	uint8_t stream;
+	uint32_t channel;
+	/** Circular buffer, 16 bit aligned (32 bit in ADC_CCR_DMA_MODE_2) */
+	void *buffer;
+	/** Size of the buffer in DMA transfers, even and at most 65534 */
+	uint32_t transfers;
+	adc_stream_cb half;
+	adc_stream_event_cb event;
+	void *user;
+	/** Statistics */
+	volatile uint32_t blocks;
+	volatile uint32_t overruns;
+	volatile uint32_t errors;
+	volatile uint32_t late;
+};
+
+BEGIN_DECLS
+
+void adc_set_multi_mode(uint32_t mode);
+void adc_enable_vbat_sensor(void);
+void adc_disable_vbat_sensor(void);
+
+bool adc_stream_start(struct adc_stream *stream);
+void adc_stream_stop(struct adc_stream *stream);
+void adc_stream_dma_isr(void);
+void adc_stream_adc_isr(void);
+
+END_DECLS
+
+/**@}*/
@@ -0,0 +1,90 @@
+/** @addtogroup dac_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* THIS FILE SHOULD NOT BE INCLUDED DIRECTLY, BUT ONLY VIA DAC.H */
+
+#pragma once
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/*
+ * Waveform streaming to the DAC.
+ *
+ * A timer TRGO selected as the DAC trigger sets the sample rate. On each
+ * trigger the DAC latches its data holding register and requests the next
+ * sample, which a DMA stream fetches from the sample buffer, so the CPU only
+ * refills buffers. With both channels, one request moves a sample pair
+ * through the dual data register and the channels update together.
+ *
+ * A single buffer is played circularly and refilled by halves, or two buffers
+ * are alternated in double buffer mode, as for timer bursts.
+ *
+ * The application sets up the timer and the output pins, calls
+ * dac_stream_isr() from the DMA stream interrupt and, to recover from
+ * underruns, dac_stream_underrun_isr() from the DAC interrupt. On parts with
+ * a DMAMUX (H7) the request is routed there and dma_channel is left 0.
+ */
+
+struct dac_stream;
+
+/** Called from the DMA interrupt when samples may be rewritten.
+ * @param stream The stream
+ * @param part Double buffer: buffer 0 or 1. Single buffer: 0 for the first
+ * half, 1 for the second half.
+ */
+typedef void (*dac_stream_cb)(struct dac_stream *stream, unsigned part);
+
+struct dac_stream {
+	uint32_t dac;
+	/** DAC_CHANNEL1, DAC_CHANNEL2 or DAC_CHANNEL_BOTH */
+	int channel;
+	/** Sample format. Samples are bytes for a single channel with
+	 * DAC_ALIGN_RIGHT8, halfwords for a single channel with 12 bits and
+	 * for byte pairs, and words (channel 2 in the upper halfword) for two
+	 * channels with 12 bits. */
+	enum dac_align align;
+	/** DAC_CR_TSELx_* of the channel(s) used, selecting a timer TRGO */
+	uint32_t trigger;
+	/** DMA controller, stream and DMA_SxCR_CHSEL_x serving the DAC
+	 * channel 1 request (channel 2 when only that one is used) */
+	uint32_t dma;
+	uint8_t stream;
+	uint32_t dma_channel;
+	/** Sample buffers; a second one selects double buffer mode */
+	const void *buffers[2];
+	/** Samples per buffer, 2 ... 65535 */
+	uint16_t samples;
+	dac_stream_cb refill;
+	void *user;
+	/** Statistics */
+	volatile uint32_t underruns;
+};
+
+BEGIN_DECLS
+
+void dac_stream_start(struct dac_stream *stream);
+void dac_stream_stop(struct dac_stream *stream);
+void dac_stream_isr(struct dac_stream *stream);
+void dac_stream_underrun_isr(struct dac_stream *stream);
+
+END_DECLS
+
+/**@}*/
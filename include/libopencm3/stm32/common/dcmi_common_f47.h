@@ -226,4 +226,79 @@
  */
 #define DCMI_DR				MMIO32(DCMI_BASE + 0x28U)
 
+/*
+ * Frame capture.
+ *
+ * Frames are moved from DCMI_DR to memory by a DMA stream, so the CPU is
+ * only involved once per frame. In continuous mode the stream runs in
+ * double buffer mode: one buffer is filled while the application processes
+ * the other.
+ *
+ * For uncompressed data each buffer must hold exactly one (cropped) frame;
+ * the DMA switches buffers by itself and the frame is reported from the DMA
+ * transfer complete interrupt. In JPEG mode frames vary in length: a buffer
+ * only has to be large enough, and the frame is reported from the DCMI frame
+ * interrupt, which restarts the stream on the other buffer.
+ *
+ * The application calls dcmi_capture_isr() from dcmi_isr() and
+ * dcmi_capture_dma_isr() from the DMA stream interrupt, and enables both in
+ * the NVIC.
+ */
+
+struct dcmi_capture;
+
+/** Frame callback, from interrupt context. len is in bytes. The buffer
+ * belongs to the application until the callback returns; in continuous mode
+ * it is refilled two frames later. */
+typedef void (*dcmi_frame_cb)(struct dcmi_capture *cap, uint32_t *buf,
+			      uint32_t len);
+/** Event callback, from interrupt context, with DCMI_RIS_* flags */
+typedef void (*dcmi_event_cb)(struct dcmi_capture *cap, uint32_t events);
+
+struct dcmi_capture {
+	/** DMA controller, stream and channel serving the DCMI */
+	uint32_t dma;
+	uint8_t stream;
+	uint32_t channel;
+	/** Capture buffers; the second one is used in continuous mode only */
+	uint32_t *buffers[2];
+	/** Size of each buffer in 32-bit words */
+	uint16_t words;
+	dcmi_frame_cb frame;
+	/** Called for the DCMI_IER_LINE/DCMI_IER_VSYNC events enabled in
+	 * events, and for overrun and synchronisation errors */
+	dcmi_event_cb event;
+	uint32_t events;
+	void *user;
+	/** Statistics */
+	volatile uint32_t frames;
+	volatile uint32_t errors;
+	/* Private to the driver. */
+	bool continuous;
+	bool jpeg;
+};
+
+BEGIN_DECLS
+
+void dcmi_set_config(uint32_t flags);
+void dcmi_set_crop_window(uint16_t x, uint16_t y, uint16_t count,
+			  uint16_t lines);
+void dcmi_enable_crop(void);
+void dcmi_disable_crop(void);
+void dcmi_enable_jpeg(void);
+void dcmi_disable_jpeg(void);
+void dcmi_enable(void);
+void dcmi_disable(void);
+void dcmi_enable_interrupts(uint32_t interrupts);
+void dcmi_disable_interrupts(uint32_t interrupts);
+uint32_t dcmi_get_interrupt_flags(void);
+void dcmi_clear_interrupt_flags(uint32_t flags);
+
+bool dcmi_capture_start(struct dcmi_capture *cap, bool continuous);
+void dcmi_capture_stop(struct dcmi_capture *cap);
+void dcmi_capture_isr(void);
+void dcmi_capture_dma_isr(void);
+
+END_DECLS
+
 /**@}*/
@@ -141,7 +141,7 @@
 /** DMA2D Output PFC Control Register */
 #define DMA2D_OPFCCR			MMIO32(DMA2D_BASE + 0x34U)
 #define DMA2D_OPFCCR_CM_SHIFT		0
-#define DMA2D_OPFCCR_CM_MASK		0x3
+#define DMA2D_OPFCCR_CM_MASK		0x7
 #define DMA2D_OPFCCR_CM_ARGB8888	0
 #define DMA2D_OPFCCR_CM_RGB888		1
 #define DMA2D_OPFCCR_CM_RGB565		2
@@ -185,4 +185,84 @@
 #define DMA2D_BG_CLUT			(uint32_t *)(DMA2D_BASE + 0x800U)
 
 /**@}*/
+
+#include <stdbool.h>
+#include <libopencm3/cm3/common.h>
+
+/** An input layer (foreground or background) of a DMA2D operation */
+struct dma2d_layer {
+	/** Address of the first pixel */
+	uint32_t addr;
+	/** Pixels to skip at the end of each line (stride - width) */
+	uint16_t offset;
+	/** Pixel format, DMA2D_xPFCCR_CM_* */
+	uint8_t format;
+	/** Alpha mode, DMA2D_xPFCCR_AM_*, and the alpha it uses */
+	uint8_t alpha_mode;
+	uint8_t alpha;
+	/** RGB color for the A8 and A4 formats */
+	uint32_t color;
+	/** CLUT for the L8/L4/AL44/AL88 formats, NULL to keep the loaded one */
+	const uint32_t *clut;
+	/** CLUT entries (1 ... 256) */
+	uint16_t clut_size;
+	/** CLUT entries are packed RGB888 rather than ARGB8888 */
+	bool clut_rgb888;
+};
+
+struct dma2d_op;
+
+/** Completion callback for queued operations, called from
+ * dma2d_queue_irq_handler(). */
+typedef void (*dma2d_callback)(struct dma2d_op *op, bool error);
+
+/** One DMA2D transfer: register to memory (fill), memory to memory (copy,
+ * optionally converting the pixel format) or memory to memory with blending
+ * of the foreground over the background.
+ */
+struct dma2d_op {
+	/** DMA2D_CR_MODE_* */
+	uint8_t mode;
+	/** Source for copies, and the blended foreground */
+	struct dma2d_layer fg;
+	/** Blended background */
+	struct dma2d_layer bg;
+	/** Output address, line offset and format (DMA2D_OPFCCR_CM_*) */
+	uint32_t out;
+	uint16_t out_offset;
+	uint8_t out_format;
+	/** Fill color for register to memory, in the output format */
+	uint32_t color;
+	uint16_t width;
+	uint16_t height;
+	dma2d_callback callback;
+	void *user;
+	/* Private to the driver. */
+	struct dma2d_op *next;
+};
+
+BEGIN_DECLS
+
+void dma2d_setup(const struct dma2d_op *op);
+void dma2d_start(void);
+bool dma2d_busy(void);
+bool dma2d_wait(void);
+void dma2d_abort(void);
+bool dma2d_run(const struct dma2d_op *op);
+
+void dma2d_fill(uint32_t out, uint16_t out_offset, uint8_t out_format,
+		uint16_t width, uint16_t height, uint32_t color);
+void dma2d_copy(const struct dma2d_layer *src, uint32_t out,
+		uint16_t out_offset, uint8_t out_format,
+		uint16_t width, uint16_t height);
+void dma2d_blend(const struct dma2d_layer *fg, const struct dma2d_layer *bg,
+		 uint32_t out, uint16_t out_offset, uint8_t out_format,
+		 uint16_t width, uint16_t height);
+
+void dma2d_submit(struct dma2d_op *op);
+bool dma2d_queue_empty(void);
+void dma2d_queue_irq_handler(void);
+
+END_DECLS
+
 #endif
@@ -0,0 +1,85 @@
+/** @addtogroup flash_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/*
+ * Interrupt driven flash jobs.
+ *
+ * Jobs are queued with flash_async_submit() and executed one hardware
+ * operation at a time from the flash interrupt, so an erase or a long
+ * programming run never stalls the CPU. Parts with independent bank
+ * controllers (H7) keep one queue per bank and run them concurrently.
+ *
+ * The application must call flash_async_isr() from its flash_isr() and
+ * enable the flash interrupt in the NVIC. The flash must be unlocked while
+ * jobs are pending. Code (including interrupt handlers) must not execute
+ * from, nor read, the bank being erased or programmed; on dual bank parts
+ * this lets the application keep running from the other bank.
+ */
+
+#ifndef FLASH_ASYNC_LANES
+/** Number of independently running job queues */
+#define FLASH_ASYNC_LANES	1
+#endif
+
+enum flash_job_type {
+	FLASH_JOB_ERASE,
+	FLASH_JOB_PROGRAM,
+};
+
+struct flash_job;
+
+/** Job completion callback, called from interrupt context.
+ * @param job The job that completed
+ * @param errors Error flags from FLASH_SR, 0 on success
+ */
+typedef void (*flash_job_cb)(struct flash_job *job, uint32_t errors);
+
+struct flash_job {
+	enum flash_job_type type;
+	/** Program: destination. Erase: any address in the bank to erase
+	 * (only used on parts with several bank controllers). */
+	uint32_t address;
+	/** Erase: sector or page number, as for the blocking erase call */
+	uint32_t sector;
+	/** Program: source data, must stay valid until completion */
+	const uint8_t *data;
+	/** Program: length in bytes */
+	uint32_t len;
+	flash_job_cb callback;
+	void *user;
+	/* Private to the driver. */
+	uint32_t done;
+	struct flash_job *next;
+};
+
+BEGIN_DECLS
+
+void flash_async_submit(struct flash_job *job);
+bool flash_async_busy(void);
+void flash_async_isr(void);
+
+END_DECLS
+
+/**@}*/
@@ -0,0 +1,101 @@
+/** @addtogroup flash_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/*
+ * EEPROM emulation: a log structured key/value store in two or more equally
+ * sized flash sectors (or groups of pages).
+ *
+ * Exactly one sector is active. Writes append a record to it, and a RAM index
+ * holding the address of the newest record of each key makes reads a single
+ * lookup. When the active sector is full its live records are copied to the
+ * next sector, which then becomes active; old sectors are erased later from
+ * flash_eeprom_gc(), so the slow erase normally happens in the background.
+ *
+ * The store only touches flash through the ops callbacks and plain memory
+ * reads, so it can be run on a host against a RAM array.
+ */
+
+/** Largest supported programming unit */
+#define FLASH_EEPROM_MAX_ALIGN	32
+
+/** Records with this length bit set are deletions */
+#define FLASH_EEPROM_DELETED	0x8000
+
+/** Keys are 0 ... nkeys - 1, 0xffff is reserved */
+#define FLASH_EEPROM_KEY_NONE	0xffff
+
+struct flash_eeprom_sector {
+	/** Address the sector is mapped at */
+	uintptr_t base;
+	/** Passed to the erase callback, e.g. the hardware sector number */
+	uint32_t id;
+};
+
+struct flash_eeprom_ops {
+	/** Erase one sector, return false on failure */
+	bool (*erase)(void *ctx, const struct flash_eeprom_sector *sector,
+		      uint32_t size);
+	/** Program len bytes (a multiple of align) at an align aligned,
+	 * erased address. data may be unaligned. Return false on failure. */
+	bool (*program)(void *ctx, uintptr_t address, const void *data,
+			size_t len);
+	void *ctx;
+};
+
+struct flash_eeprom {
+	/* Configuration, set up before flash_eeprom_mount(). */
+	const struct flash_eeprom_ops *ops;
+	const struct flash_eeprom_sector *sectors;
+	uint8_t nsectors;
+	/** Programming unit in bytes: a power of two, 4 ... 32 */
+	uint8_t align;
+	uint32_t sector_size;
+	/** RAM index with nkeys entries */
+	uintptr_t *index;
+	uint16_t nkeys;
+
+	/* State, private to the driver. */
+	uint8_t active;
+	uint32_t seq;
+	uintptr_t write_ptr;
+	uint32_t dirty;
+};
+
+BEGIN_DECLS
+
+bool flash_eeprom_format(struct flash_eeprom *ee);
+bool flash_eeprom_mount(struct flash_eeprom *ee);
+int flash_eeprom_read(struct flash_eeprom *ee, uint16_t key, void *buf,
+		      size_t size);
+bool flash_eeprom_write(struct flash_eeprom *ee, uint16_t key,
+			const void *data, uint16_t len);
+bool flash_eeprom_delete(struct flash_eeprom *ee, uint16_t key);
+bool flash_eeprom_gc(struct flash_eeprom *ee);
+uint32_t flash_eeprom_free(const struct flash_eeprom *ee);
+
+END_DECLS
+
+/**@}*/
@@ -41,6 +41,8 @@
 /**@{*/
 
 #include <libopencm3/stm32/common/flash_common_idcache.h>
+#include <libopencm3/stm32/common/flash_common_async.h>
+#include <libopencm3/stm32/common/flash_common_eeprom.h>
 
 /** @defgroup flash_registers Flash Registers
  * @ingroup flash_defines
@@ -155,9 +157,13 @@ void flash_program_double_word(uint32_t address, uint64_t data);
 void flash_program_word(uint32_t address, uint32_t data);
 void flash_program_half_word(uint32_t address, uint16_t data);
 void flash_program_byte(uint32_t address, uint8_t data);
+void flash_set_program_parallelism(uint32_t psize);
+void flash_set_supply_voltage(uint16_t millivolts, bool vpp);
 void flash_program(uint32_t address, const uint8_t *data, uint32_t len);
 void flash_program_option_bytes(uint32_t data);
 
+extern const struct flash_eeprom_ops flash_eeprom_ops;
+
 END_DECLS
 /**@}*/
 
@@ -0,0 +1,42 @@
+/** @addtogroup flash_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Fast (row) programming, shared by the G4 and L4 flash controllers. */
+
+#pragma once
+
+#include <libopencm3/stm32/flash.h>
+
+/**@{*/
+
+/** Size of a fast programming row: 32 double words */
+#define FLASH_ROW_SIZE			256
+
+/** FLASH_SR flags that report a failed program operation */
+#define FLASH_SR_PROGRAM_ERRORS	(FLASH_SR_FASTERR | FLASH_SR_MISERR | \
+				 FLASH_SR_PGSERR | FLASH_SR_SIZERR | \
+				 FLASH_SR_PGAERR | FLASH_SR_WRPERR | \
+				 FLASH_SR_PROGERR | FLASH_SR_OPERR)
+
+BEGIN_DECLS
+
+bool flash_program_row(uint32_t address, const uint32_t *data);
+
+END_DECLS
+/**@}*/
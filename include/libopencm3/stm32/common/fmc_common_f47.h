@@ -254,14 +254,32 @@ enum fmc_sdram_command { SDRAM_CLK_CONF, SDRAM_NORMAL, SDRAM_PALL,
 			 SDRAM_AUTO_REFRESH, SDRAM_LOAD_MODE,
 			 SDRAM_SELF_REFRESH, SDRAM_POWER_DOWN };
 
+/* Complete description of an SDRAM device for sdram_init() */
+struct sdram_config {
+	enum fmc_sdram_bank bank;	/* SDRAM_BANK1 or SDRAM_BANK2 */
+	uint8_t columns;		/* Column address bits, 8 .. 11 */
+	uint8_t rows;			/* Row address bits, 11 .. 13 */
+	uint8_t width;			/* Data bus width, 8, 16 or 32 */
+	uint8_t banks;			/* Internal banks, 2 or 4 */
+	uint8_t cas;			/* CAS latency in SDCLK cycles, 1 .. 3 */
+	uint8_t sdclk_div;		/* SDCLK = HCLK / sdclk_div, 2 or 3 */
+	bool read_burst;		/* Burst reads (RBURST) */
+	uint8_t read_pipe;		/* Read pipe delay in HCLK cycles, 0 .. 2 */
+	struct sdram_timing timing;	/* In SDCLK cycles */
+	uint8_t autorefresh;		/* Auto-refresh cycles at init, 1 .. 16 */
+	uint16_t refresh_ms;		/* Refresh period, usually 64 */
+};
+
 /* Send an array of timing parameters (indices above) to create SDTR register
  * value
  */
 BEGIN_DECLS
 
-uint32_t sdram_timing(struct sdram_timing *t);
+uint32_t sdram_timing(const struct sdram_timing *t);
 void sdram_command(enum fmc_sdram_bank bank, enum fmc_sdram_command cmd,
 			int autorefresh, int modereg);
+uint32_t sdram_refresh_count(const struct sdram_config *cfg);
+bool sdram_init(const struct sdram_config *cfg);
 
 END_DECLS
 
@@ -71,10 +71,13 @@ specific memorymap.h header before including this header file.*/
 
 BEGIN_DECLS
 
+#if !defined(LIBOPENCM3_INLINE)
+/* Otherwise defined inline by the family header, after the registers. */
 void gpio_set(uint32_t gpioport, uint16_t gpios);
 void gpio_clear(uint32_t gpioport, uint16_t gpios);
-uint16_t gpio_get(uint32_t gpioport, uint16_t gpios);
 void gpio_toggle(uint32_t gpioport, uint16_t gpios);
+#endif
+uint16_t gpio_get(uint32_t gpioport, uint16_t gpios);
 uint16_t gpio_port_read(uint32_t gpioport);
 void gpio_port_write(uint32_t gpioport, uint16_t data);
 void gpio_port_config_lock(uint32_t gpioport, uint16_t gpios);
@@ -0,0 +1,57 @@
+/** @addtogroup gpio_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* THIS FILE SHOULD NOT BE INCLUDED DIRECTLY, BUT ONLY VIA GPIO.H
+Pin tables, for every GPIO built from gpio_common_f0234.c. */
+
+/** @cond */
+#ifdef LIBOPENCM3_GPIO_H
+/** @endcond */
+#ifndef LIBOPENCM3_GPIO_COMMON_F0234_H
+#define LIBOPENCM3_GPIO_COMMON_F0234_H
+
+/**@{*/
+
+/** One entry of a pin table for @ref gpio_configure_pins */
+struct gpio_pin_config {
+	uint32_t port;		/**< @ref gpio_port_id */
+	uint16_t gpios;		/**< @ref gpio_pin_id, may be several pins */
+	uint8_t mode;		/**< @ref gpio_mode */
+	uint8_t pull_up_down;	/**< @ref gpio_pup */
+	uint8_t otype;		/**< @ref gpio_output_type */
+	uint8_t speed;		/**< @ref gpio_speed */
+	uint8_t af;		/**< @ref gpio_af_num */
+};
+
+BEGIN_DECLS
+
+void gpio_enable_port_clocks(const struct gpio_pin_config *pins,
+			     unsigned int npins);
+void gpio_configure_pins(const struct gpio_pin_config *pins,
+			 unsigned int npins);
+
+END_DECLS
+
+/**@}*/
+#endif
+/** @cond */
+#else
+#warning "gpio_common_f0234.h should not be included explicitly, only via gpio.h"
+#endif
+/** @endcond */
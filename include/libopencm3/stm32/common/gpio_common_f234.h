@@ -39,6 +39,7 @@ specific memorymap.h header before including this header file.*/
 /**@{*/
 
 #include <libopencm3/stm32/common/gpio_common_all.h>
+#include <libopencm3/stm32/common/gpio_common_f0234.h>
 
 /* GPIO port base addresses (for convenience) */
 /** @defgroup gpio_port_id GPIO Port IDs
@@ -284,6 +285,9 @@ void gpio_set_output_options(uint32_t gpioport, uint8_t otype, uint8_t speed,
 void gpio_set_af(uint32_t gpioport, uint8_t alt_func_num, uint16_t gpios);
 
 END_DECLS
+
+#include <libopencm3/stm32/common/gpio_common_inline.h>
+
 /**@}*/
 #endif
 /** @cond */
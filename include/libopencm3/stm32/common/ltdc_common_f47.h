@@ -522,6 +522,60 @@ static inline bool LTDC_SRCR_IS_RELOADING(void)
 			     LTDC_SRCR_RELOAD_IMR)) != 0;
 }
 
+/**
+ * double/triple buffered framebuffers
+ *
+ * A layer is given two or three framebuffers. The application draws into the
+ * back buffer and presents it; the new address is written to the shadow
+ * register and reloaded during the next vertical blanking (SRCR VBR), so the
+ * display never shows a half drawn frame. Drawing the next frame can start
+ * at once when a free buffer is left (triple buffering, or double buffering
+ * once the swap happened).
+ *
+ * The application must call ltdc_fb_isr() from its lcd_tft_isr() and enable
+ * that interrupt in the NVIC.
+ */
+
+#define LTDC_FB_MAX_BUFFERS	3
+#define LTDC_FB_NONE		0xff
+
+struct ltdc_fb_stats {
+	/** Vertical blanking periods seen */
+	uint32_t refreshes;
+	/** Presented buffers that reached the display */
+	uint32_t swaps;
+	/** Presented buffers replaced by a newer one before being shown */
+	uint32_t dropped;
+	/** Refresh periods between the last two swaps, and extremes */
+	uint16_t frame_last;
+	uint16_t frame_min;
+	uint16_t frame_max;
+};
+
+struct ltdc_fb {
+	uint8_t layer;
+	uint8_t nbuffers;
+	uint32_t buffers[LTDC_FB_MAX_BUFFERS];
+	struct ltdc_fb_stats stats;
+	/* Private to the driver. */
+	volatile uint8_t front;
+	volatile uint8_t pending;
+	uint8_t back;
+	uint32_t last_swap;
+};
+
+BEGIN_DECLS
+
+bool ltdc_fb_init(struct ltdc_fb *fb, uint8_t layer,
+		  const uint32_t *buffers, uint8_t nbuffers);
+uint32_t ltdc_fb_back(struct ltdc_fb *fb);
+bool ltdc_fb_present(struct ltdc_fb *fb);
+void ltdc_fb_wait_vsync(struct ltdc_fb *fb);
+void ltdc_fb_reset_stats(struct ltdc_fb *fb);
+void ltdc_fb_isr(void);
+
+END_DECLS
+
 /**
  * color conversion helper function
  * (simulate the ltdc color conversion)
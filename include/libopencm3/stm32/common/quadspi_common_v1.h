@@ -172,8 +172,35 @@
 #define QUADSPI_CCR_FMODE_APOLL   2
 #define QUADSPI_CCR_FMODE_MEMMAP  3
 
+/* ADSIZE/ABSIZE values */
+#define QUADSPI_CCR_SIZE_8BIT     0
+#define QUADSPI_CCR_SIZE_16BIT    1
+#define QUADSPI_CCR_SIZE_24BIT    2
+#define QUADSPI_CCR_SIZE_32BIT    3
+
 /**@}*/
 
+/** One QUADSPI command: which phases are sent, on how many lines, and with
+ * what content. A phase with mode QUADSPI_CCR_MODE_NONE is skipped.
+ */
+struct quadspi_command {
+	uint8_t instruction;
+	uint8_t instruction_mode;
+	uint8_t address_mode;
+	uint8_t address_size;
+	uint32_t address;
+	uint8_t alternate_mode;
+	uint8_t alternate_size;
+	uint32_t alternate;
+	/** Dummy cycles between the address/alternate and data phases */
+	uint8_t dummy_cycles;
+	uint8_t data_mode;
+	/** Double data rate for address, alternate and data phases */
+	bool ddr;
+	/** Send the instruction only once (memory mapped mode) */
+	bool sioo;
+};
+
 
 /**
  * @defgroup quadspi_file QuadSPI peripheral API
@@ -198,6 +225,40 @@ void quadspi_enable(uint32_t quadspi);
  */
 void quadspi_disable(uint32_t quadspi);
 
+void quadspi_set_prescaler(uint32_t quadspi, uint8_t prescaler);
+void quadspi_set_flash_size(uint32_t quadspi, uint8_t size_log2);
+void quadspi_set_cs_high_time(uint32_t quadspi, uint8_t cycles);
+void quadspi_set_clock_mode3(uint32_t quadspi, bool mode3);
+void quadspi_set_sample_shift(uint32_t quadspi, bool half_cycle);
+void quadspi_set_fifo_threshold(uint32_t quadspi, uint8_t threshold);
+void quadspi_abort(uint32_t quadspi);
+void quadspi_wait_while_busy(uint32_t quadspi);
+
+void quadspi_command(uint32_t quadspi, const struct quadspi_command *cmd);
+void quadspi_read(uint32_t quadspi, const struct quadspi_command *cmd,
+		  void *buf, uint32_t len);
+void quadspi_write(uint32_t quadspi, const struct quadspi_command *cmd,
+		   const void *buf, uint32_t len);
+
+void quadspi_start_auto_poll(uint32_t quadspi,
+			     const struct quadspi_command *cmd,
+			     uint32_t mask, uint32_t match, uint16_t interval,
+			     bool or_match);
+void quadspi_wait_status(uint32_t quadspi, const struct quadspi_command *cmd,
+			 uint32_t mask, uint32_t match);
+
+void quadspi_memory_mapped(uint32_t quadspi,
+			   const struct quadspi_command *cmd,
+			   uint16_t timeout);
+
+#ifdef QUADSPI_CR_DMAEN
+void quadspi_start_dma_read(uint32_t quadspi,
+			    const struct quadspi_command *cmd, uint32_t len);
+void quadspi_start_dma_write(uint32_t quadspi,
+			     const struct quadspi_command *cmd, uint32_t len);
+void quadspi_finish_dma(uint32_t quadspi);
+#endif
+
 END_DECLS
 
 /**@}*/
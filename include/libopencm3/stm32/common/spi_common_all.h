@@ -340,6 +340,78 @@ specific memorymap.h header before including this header file.*/
 /* I2SDIV[7:0]: I2S linear prescaler */
 /* 0 and 1 are forbidden values */
 
+/* --- Block transfers ---------------------------------------------------- */
+
+/** Frame sent by spi_transfer() and SPI bus transactions without tx data */
+#define SPI_TRANSFER_DUMMY		0xffff
+
+/*
+ * Queued SPI transactions.
+ *
+ * Transactions are queued on a bus with spi_bus_submit(), either one at a
+ * time or as a chain linked through next, and run from the SPI interrupt
+ * (one frame in flight) or, when a DMA controller is given, by a pair of DMA
+ * channels or streams at the full bus clock. Each transaction can drive a
+ * chip select pin low for its duration; with cs_hold the pin stays low into
+ * the next transaction, so a command and its data phase can come from
+ * different buffers.
+ *
+ * The SPI must be set up as master and enabled. The application calls
+ * spi_bus_isr() from the SPI interrupt, or spi_bus_dma_isr() from the
+ * receive DMA interrupt, and enables that interrupt in the NVIC. The DMA
+ * requests must be routed to the channels beforehand on parts with a DMAMUX
+ * or a channel selection register (except for the stream DMA controller,
+ * where rx_request/tx_request select the channel).
+ */
+
+struct spi_transaction;
+
+/** Transaction completion callback, called from interrupt context.
+ * @param t The transaction
+ * @param status 0 on success, -1 on an overrun, mode fault or DMA error
+ */
+typedef void (*spi_transaction_cb)(struct spi_transaction *t, int status);
+
+struct spi_transaction {
+	/** Frames to send, or NULL to send SPI_TRANSFER_DUMMY */
+	const void *tx;
+	/** Buffer for the received frames, or NULL to discard them */
+	void *rx;
+	/** Number of frames (bytes, or halfwords for frames over 8 bits), at
+	 * least 1 and, with DMA, at most 65535 */
+	uint32_t len;
+	/** Chip select pin driven low during the transaction, or port 0 */
+	uint32_t cs_port;
+	uint16_t cs_pins;
+	/** Keep the chip select low after the transaction */
+	bool cs_hold;
+	spi_transaction_cb callback;
+	void *user;
+	/** Next transaction of a chain, or NULL */
+	struct spi_transaction *next;
+};
+
+struct spi_bus {
+	uint32_t spi;
+	/** DMA controller, or 0 to transfer from the SPI interrupt */
+	uint32_t dma;
+	/** DMA stream (stream controllers) or channel used for each
+	 * direction */
+	uint8_t rx_stream;
+	uint8_t tx_stream;
+	/** DMA_SxCR_CHSEL_x for each direction on stream controllers */
+	uint32_t rx_request;
+	uint32_t tx_request;
+	/** Statistics */
+	volatile uint32_t errors;
+	/* Private to the driver. */
+	struct spi_transaction *head;
+	struct spi_transaction *tail;
+	uint32_t sent;
+	uint32_t received;
+	uint8_t frame;
+};
+
 /* --- Function prototypes ------------------------------------------------- */
 
 BEGIN_DECLS
@@ -348,8 +420,22 @@ void spi_enable(uint32_t spi);
 void spi_disable(uint32_t spi);
 uint16_t spi_clean_disable(uint32_t spi);
 void spi_write(uint32_t spi, uint16_t data);
+#if defined(LIBOPENCM3_INLINE)
+static inline void spi_send(uint32_t spi, uint16_t data)
+{
+	while (!(SPI_SR(spi) & SPI_SR_TXE));
+	SPI_DR(spi) = data;
+}
+
+static inline uint16_t spi_read(uint32_t spi)
+{
+	while (!(SPI_SR(spi) & SPI_SR_RXNE));
+	return SPI_DR(spi);
+}
+#else
 void spi_send(uint32_t spi, uint16_t data);
 uint16_t spi_read(uint32_t spi);
+#endif
 uint16_t spi_xfer(uint32_t spi, uint16_t data);
 void spi_set_bidirectional_mode(uint32_t spi);
 void spi_set_unidirectional_mode(uint32_t spi);
@@ -387,6 +473,12 @@ void spi_disable_tx_dma(uint32_t spi);
 void spi_enable_rx_dma(uint32_t spi);
 void spi_disable_rx_dma(uint32_t spi);
 void spi_set_standard_mode(uint32_t spi, uint8_t mode);
+int spi_transfer(uint32_t spi, const void *tx, void *rx, uint32_t len);
+
+int spi_bus_submit(struct spi_bus *bus, struct spi_transaction *t);
+bool spi_bus_busy(const struct spi_bus *bus);
+void spi_bus_isr(struct spi_bus *bus);
+void spi_bus_dma_isr(struct spi_bus *bus);
 
 END_DECLS
 
@@ -0,0 +1,85 @@
+/** @addtogroup timer_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/*
+ * Waveform streaming with timer DMA bursts.
+ *
+ * A table of register tuples (for example ARR, RCR, CCR1 ... CCR4) is written
+ * to the timer through its DMA burst register, one tuple per update event.
+ * With preload enabled the values take effect in the following period, so
+ * every period of the waveform can have its own timing without the CPU.
+ *
+ * The table is either played once, repeated (circular), or two tables are
+ * alternated in double buffer mode while the application refills the one
+ * not in use from the callback.
+ *
+ * The application calls timer_burst_isr() from the DMA stream interrupt and
+ * enables it in the NVIC. On parts with a DMAMUX (H7) the request is routed
+ * there and channel is left 0.
+ */
+
+struct timer_burst;
+
+/** Called from the DMA interrupt when a table (or, with a single circular
+ * table, half of it) has been sent and may be rewritten.
+ * @param burst The stream
+ * @param part Double buffer: table 0 or 1. Single table: 0 for the first
+ * half, 1 for the second half or the whole of a one shot table.
+ */
+typedef void (*timer_burst_cb)(struct timer_burst *burst, unsigned part);
+
+struct timer_burst {
+	uint32_t timer;
+	/** First register of each tuple, e.g. &TIM_ARR(TIM1) */
+	volatile uint32_t *first;
+	/** Registers per tuple, 1 ... TIM_DMA_BURST_MAX */
+	uint8_t regs;
+	/** DMA controller, stream and DMA_SxCR_CHSEL_x serving the timer's
+	 * update request */
+	uint32_t dma;
+	uint8_t stream;
+	uint32_t channel;
+	/** Tables; a second one selects double buffer mode */
+	const void *tables[2];
+	/** Tuples per table; tuples * regs must not exceed 65535 */
+	uint16_t tuples;
+	/** Table entries are 16 bit rather than 32 bit */
+	bool halfwords;
+	/** Repeat the table until stopped; double buffering always does */
+	bool circular;
+	timer_burst_cb callback;
+	void *user;
+};
+
+BEGIN_DECLS
+
+void timer_burst_start(struct timer_burst *burst);
+void timer_burst_stop(struct timer_burst *burst);
+bool timer_burst_busy(const struct timer_burst *burst);
+void timer_burst_isr(struct timer_burst *burst);
+
+END_DECLS
+
+/**@}*/
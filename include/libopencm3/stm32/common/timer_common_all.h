@@ -1046,10 +1046,19 @@ depending on the level of the complementary input. */
 /* --- TIMx_DCR values ----------------------------------------------------- */
 
 /* DBL[4:0]: DMA burst length */
-#define TIM_BDTR_DBL_MASK		(0x1F << 8)
+#define TIM_DCR_DBL_SHIFT		8
+#define TIM_DCR_DBL_MASK		(0x1F << 8)
 
 /* DBA[4:0]: DMA base address */
-#define TIM_BDTR_DBA_MASK		(0x1F << 0)
+#define TIM_DCR_DBA_SHIFT		0
+#define TIM_DCR_DBA_MASK		(0x1F << 0)
+
+/* Misnamed, kept for compatibility */
+#define TIM_BDTR_DBL_MASK		TIM_DCR_DBL_MASK
+#define TIM_BDTR_DBA_MASK		TIM_DCR_DBA_MASK
+
+/** Longest DMA burst, in registers */
+#define TIM_DMA_BURST_MAX		18
 
 /* --- TIMx_DMAR values ---------------------------------------------------- */
 
@@ -1157,7 +1166,15 @@ void timer_enable_irq(uint32_t timer_peripheral, uint32_t irq);
 void timer_disable_irq(uint32_t timer_peripheral, uint32_t irq);
 bool timer_interrupt_source(uint32_t timer_peripheral, uint32_t flag);
 bool timer_get_flag(uint32_t timer_peripheral, uint32_t flag);
+#if defined(LIBOPENCM3_INLINE)
+static inline void timer_clear_flag(uint32_t timer_peripheral, uint32_t flag)
+{
+	/* All defined bits are rc_w0 */
+	TIM_SR(timer_peripheral) = ~flag;
+}
+#else
 void timer_clear_flag(uint32_t timer_peripheral, uint32_t flag);
+#endif
 void timer_set_mode(uint32_t timer_peripheral, uint32_t clock_div,
 		    uint32_t alignment, uint32_t direction);
 void timer_set_clock_division(uint32_t timer_peripheral, uint32_t clock_div);
@@ -1228,6 +1245,9 @@ void timer_set_deadtime(uint32_t timer_peripheral, uint32_t deadtime);
 void timer_generate_event(uint32_t timer_peripheral, uint32_t event);
 uint32_t timer_get_counter(uint32_t timer_peripheral);
 void timer_set_counter(uint32_t timer_peripheral, uint32_t count);
+void timer_set_dma_burst(uint32_t timer_peripheral, volatile uint32_t *first,
+			 uint8_t length);
+uint32_t timer_get_dma_burst_address(uint32_t timer_peripheral);
 
 void timer_ic_set_filter(uint32_t timer, enum tim_ic_id ic,
 			 enum tim_ic_filter flt);
@@ -110,7 +110,10 @@ void usart_set_mode(uint32_t usart, uint32_t mode);
 void usart_set_flow_control(uint32_t usart, uint32_t flowcontrol);
 void usart_enable(uint32_t usart);
 void usart_disable(uint32_t usart);
+#if !defined(LIBOPENCM3_INLINE)
+/* Otherwise defined inline by the USART version header. */
 void usart_send(uint32_t usart, uint16_t data);
+#endif
 uint16_t usart_recv(uint32_t usart);
 void usart_wait_send_ready(uint32_t usart);
 void usart_wait_recv_ready(uint32_t usart);
@@ -299,6 +299,13 @@ specific memorymap.h header before including this header file.*/
 
 /* TODO */ /* Note to Uwe: what needs to be done here? */
 
+#if defined(LIBOPENCM3_INLINE)
+static inline void usart_send(uint32_t usart, uint16_t data)
+{
+	USART_DR(usart) = (data & USART_DR_MASK);
+}
+#endif
+
 #endif
 /** @cond */
 #else
@@ -646,4 +646,11 @@ void usart_disable_rx_timeout_interrupt(uint32_t usart);
 void usart_enable_diver_enable(uint32_t usart, bool invert);
 void usart_set_oversampling(uint32_t usart, uint32_t mode);
 
+#if defined(LIBOPENCM3_INLINE)
+static inline void usart_send(uint32_t usart, uint16_t data)
+{
+	USART_TDR(usart) = (data & USART_TDR_MASK);
+}
+#endif
+
 END_DECLS
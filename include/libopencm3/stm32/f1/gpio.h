@@ -978,6 +978,8 @@ void gpio_secondary_remap(uint32_t maps);
 
 END_DECLS
 
+#include <libopencm3/stm32/common/gpio_common_inline.h>
+
 #endif
 /**@}*/
 
@@ -32,6 +32,7 @@ LGPL License Terms @ref lgpl_license
 #define LIBOPENCM3_DAC_H
 
 #include <libopencm3/stm32/common/dac_common_v1.h>
+#include <libopencm3/stm32/common/dac_stream_common_f24.h>
 
 /**@{*/
 
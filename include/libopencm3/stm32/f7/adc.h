@@ -183,12 +183,6 @@ LGPL License Terms @ref lgpl_license
 #define ADC_CCR_ADCPRE_MASK		(0x3 << 16)
 #define ADC_CCR_ADCPRE_SHIFT		16
 
-BEGIN_DECLS
-
-void adc_set_multi_mode(uint32_t mode);
-void adc_enable_vbat_sensor(void);
-void adc_disable_vbat_sensor(void);
-
-END_DECLS
+#include <libopencm3/stm32/common/adc_common_f47.h>
 
 #endif
@@ -411,8 +411,6 @@
 #define FDCAN_RXF1A_R1AI_SHIFT			FDCAN_RXFIFO_AI_SHIFT
 #define FDCAN_RXF1A_R1AI_MASK			FDCAN_RXFIFO_AI_MASK
 
-#define FDCAN_TXBC_TFQM					(1 << 24)
-
 /** TFFL[2:0]: Tx FIFO free level */
 #define FDCAN_TXFQS_TFFL_SHIFT			0
 
@@ -725,6 +723,30 @@ struct fdcan_tx_buffer_element {
 #define FDCAN_FIFO_RXTS_MASK			0xFFFF
 
 
+/** One frame, as used by the batch transmit and receive functions. */
+struct fdcan_frame {
+	/** Standard (11 bit) or extended (29 bit) identifier */
+	uint32_t id;
+	bool ext;
+	bool rtr;
+	/** FDCAN frame format */
+	bool fdf;
+	/** Bitrate switching for the data phase */
+	bool brs;
+	/** Payload length in bytes, a valid CAN or FDCAN length */
+	uint8_t length;
+	/** Receive: index of the filter that matched */
+	uint8_t fmi;
+	/** Receive: timestamp */
+	uint16_t timestamp;
+	/** Payload, word aligned so that it moves to and from message RAM
+	 * a word at a time */
+	union {
+		uint8_t data8[64];
+		uint32_t data32[16];
+	} data;
+};
+
 /** @defgroup fdcan_error FDCAN error return values
  * @{
  */
@@ -790,6 +812,12 @@ int fdcan_receive(uint32_t canport, uint8_t fifo, bool release, uint32_t *id,
 		bool *ext, bool *rtr, uint8_t *fmi, uint8_t *length,
 		uint8_t *data, uint16_t *timestamp);
 
+int fdcan_transmit_batch(uint32_t canport, const struct fdcan_frame *frames,
+		unsigned count);
+
+int fdcan_receive_batch(uint32_t canport, uint8_t fifo_id,
+		struct fdcan_frame *frames, unsigned count);
+
 void fdcan_release_fifo(uint32_t canport, uint8_t fifo);
 
 bool fdcan_available_tx(uint32_t canport);
@@ -802,10 +830,13 @@ struct fdcan_extended_filter *fdcan_get_flesa_addr(uint32_t canport);
 struct fdcan_rx_fifo_element *fdcan_get_rxfifo_addr(uint32_t canport,
 		unsigned fifo_id, unsigned element_id);
 unsigned fdcan_get_fifo_element_size(uint32_t canport, unsigned fifo_id);
+unsigned fdcan_get_fifo_size(uint32_t canport, unsigned fifo_id);
 
 struct fdcan_tx_event_element *fdcan_get_txevt_addr(uint32_t canport);
 struct fdcan_tx_buffer_element *fdcan_get_txbuf_addr(uint32_t canport, unsigned element_id);
 unsigned fdcan_get_txbuf_element_size(uint32_t canport);
+unsigned fdcan_get_txfifo_start(uint32_t canport);
+unsigned fdcan_get_txfifo_size(uint32_t canport);
 void fdcan_set_fifo_locked_mode(uint32_t canport, bool locked);
 uint32_t fdcan_length_to_dlc(uint8_t length);
 uint8_t fdcan_dlc_to_length(uint32_t dlc);
@@ -228,7 +228,7 @@
 #define ADC_JSQR_JSQ2_LSB		15
 #define ADC_JSQR_JSQ1_LSB		9
 
-#define ADC_JSQR_JSQ_VAL(n, val)	((val) << (((n) - 1) * 6 + 8))
+#define ADC_JSQR_JSQ_VAL(n, val)	((val) << (((n) - 1) * 6 + ADC_JSQR_JSQ1_LSB))
 #define ADC_JSQR_JL_VAL(val)		(((val) - 1) << ADC_JSQR_JL_SHIFT)
 
 /* Bits 31:27 JSQ4[4:0]: 4th conversion in the injected sequence */
@@ -561,6 +561,37 @@
 #define ADC_CHANNEL_COUNT 		19
 #define ADC_CHANNEL_IS_FAST(x)		((x) <= 5)
 
+/** Maximum length of an injected sequence */
+#define ADC_JSQR_MAX_CHANNELS		4
+
+struct adc_injected_scan;
+
+/** Called from the ADC interrupt when an injected sequence has completed.
+ * @param scan The scan
+ * @param results One result per channel of the sequence, in order
+ */
+typedef void (*adc_injected_cb)(struct adc_injected_scan *scan,
+				const int32_t *results);
+
+/** Injected sequence converted on a trigger, with its results collected at
+ * the end of each sequence (JEOS). */
+struct adc_injected_scan {
+	uint32_t adc;
+	/** Sequence of 1 ... ADC_JSQR_MAX_CHANNELS channels */
+	uint8_t length;
+	uint8_t channels[ADC_JSQR_MAX_CHANNELS];
+	/** ADC12_JSQR_JEXTSEL_* or ADC345_JSQR_JEXTSEL_* */
+	uint32_t trigger;
+	/** ADC_JSQR_JEXTEN_*, other than ADC_JSQR_JEXTEN_DISABLED */
+	uint32_t polarity;
+	adc_injected_cb done;
+	void *user;
+	/** Results of the last sequence, signed when offsets are used */
+	int32_t results[ADC_JSQR_MAX_CHANNELS];
+	/** Statistics */
+	volatile uint32_t sequences;
+	volatile uint32_t overflows;
+};
 
 BEGIN_DECLS
 
@@ -605,6 +636,16 @@ void adc_enable_external_trigger_injected(uint32_t adc, uint32_t trigger,
 bool adc_awd(uint32_t adc);
 void adc_enable_deeppwd(uint32_t adc);
 void adc_disable_deeppwd(uint32_t adc);
+void adc_set_oversampling(uint32_t adc, uint32_t ratio, uint8_t shift,
+			  uint32_t mode);
+void adc_disable_oversampling(uint32_t adc);
+void adc_enable_bulb_sampling(uint32_t adc);
+void adc_disable_bulb_sampling(uint32_t adc);
+void adc_enable_sampling_trigger_mode(uint32_t adc);
+void adc_disable_sampling_trigger_mode(uint32_t adc);
+bool adc_injected_scan_start(struct adc_injected_scan *scan);
+void adc_injected_scan_stop(struct adc_injected_scan *scan);
+void adc_injected_scan_isr(struct adc_injected_scan *scan);
 
 END_DECLS
 
@@ -86,6 +86,8 @@ LGPL License Terms @ref lgpl_license
 #define FDCAN_RXFIFO_PI_MASK			0x3
 #define FDCAN_RXFIFO_AI_MASK			0x3
 
+#define FDCAN_TXBC_TFQM					(1 << 24)
+
 #define FDCAN_TXFQS_TFFL_MASK			0x7
 #define FDCAN_TXFQS_TFGI_MASK			0x3
 #define FDCAN_TXFQS_TFQPI_MASK			0x3
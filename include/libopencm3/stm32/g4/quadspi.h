@@ -8,8 +8,10 @@
 #pragma once
 
 #include <libopencm3/stm32/memorymap.h>
-#include <libopencm3/stm32/common/quadspi_common_v1.h>
 
+/* Needed by the common header to provide the DMA helpers */
 #define QUADSPI_CR_DMAEN    (1 << 2)
 
+#include <libopencm3/stm32/common/quadspi_common_v1.h>
+
 /**@}*/
\ No newline at end of file
@@ -135,10 +135,16 @@ LGPL License Terms @ref lgpl_license
 #define FDCAN_XIDFC_FLESA_MASK			FDCAN_FXSA_MASK
 #define FDCAN_XIDFC_FLESA_SHIFT			FDCAN_FXSA_SHIFT
 
+#define FDCAN_TXBC_TFQM					(1 << 30)
+
 /** TFQS[5:0]: Tx FIFO/Queue size */
 #define FDCAN_TXBC_TFQS_MASK			0x3F
 #define FDCAN_TXBC_TFQS_SHIFT			24
 
+/** NDTB[5:0]: Number of dedicated transmit buffers */
+#define FDCAN_TXBC_NDTB_MASK			0x3F
+#define FDCAN_TXBC_NDTB_SHIFT			16
+
 /** TBSA[7:0]: Transmit buffer start address */
 #define FDCAN_TXBC_TBSA_MASK			FDCAN_FXSA_MASK
 #define FDCAN_TXBC_TBSA_SHIFT			FDCAN_FXSA_SHIFT
@@ -241,8 +247,39 @@ LGPL License Terms @ref lgpl_license
 #define FDCAN_TXEVT_OFFSET(can_base) \
 	(FDCAN_TXEFC(can_base) & (FDCAN_TXEFC_EFSA_MASK << FDCAN_TXEFC_EFSA_SHIFT))
 
+/** Number of 32 bit words of message RAM, shared by all FDCAN blocks */
+#define FDCAN_RAM_WORDS					(CAN_MSG_SIZE / 4)
+
+/** Limits of the message RAM sections of one FDCAN block */
+#define FDCAN_RAM_STD_FILTERS_MAX		128
+#define FDCAN_RAM_EXT_FILTERS_MAX		64
+#define FDCAN_RAM_RX_FIFO_MAX			64
+#define FDCAN_RAM_TX_EVENTS_MAX			32
+#define FDCAN_RAM_TX_FIFO_MAX			32
+
+/** Element count asking fdcan_plan_ram() to use the space left over */
+#define FDCAN_RAM_AUTO					0xFF
+
+/** Message RAM allocation of one FDCAN block, see fdcan_plan_ram(). */
+struct fdcan_ram_config {
+	uint8_t std_filters;
+	uint8_t ext_filters;
+	/** Elements of Rx FIFO 0 and 1, or FDCAN_RAM_AUTO */
+	uint8_t rx_fifo[2];
+	uint8_t tx_events;
+	/** Elements of the Tx FIFO/queue, or FDCAN_RAM_AUTO */
+	uint8_t tx_fifo;
+	/** Payload bytes stored per Rx and per Tx element: 8, 12, 16, 20,
+	 * 24, 32, 48 or 64 */
+	uint8_t rx_data_size;
+	uint8_t tx_data_size;
+};
+
 BEGIN_DECLS
 
+int fdcan_plan_ram(struct fdcan_ram_config *cfg, unsigned words);
+int fdcan_init_ram(uint32_t canport, const struct fdcan_ram_config *cfg,
+		uint32_t offset);
 void fdcan_init_std_filter_ram(uint32_t canport, uint32_t flssa, uint8_t lss);
 void fdcan_init_ext_filter_ram(uint32_t canport, uint32_t flesa, uint8_t lse);
 void fdcan_init_fifo_ram(uint32_t canport, unsigned fifo_id, uint32_t fxsa, uint8_t fxs);
@@ -32,6 +32,11 @@
 #include <stddef.h>
 #include <libopencm3/stm32/common/flash_common_idcache.h>
 
+/* One flash job queue per bank controller */
+#define FLASH_ASYNC_LANES	2
+#include <libopencm3/stm32/common/flash_common_async.h>
+#include <libopencm3/stm32/common/flash_common_eeprom.h>
+
 #define FLASH_FPEC1_BASE (FLASH_MEM_INTERFACE_BASE + 0x000U)
 #define FLASH_FPEC2_BASE (FLASH_MEM_INTERFACE_BASE + 0x100U)
 
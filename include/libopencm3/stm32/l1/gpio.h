@@ -37,6 +37,7 @@ LGPL License Terms @ref lgpl_license
 #define LIBOPENCM3_GPIO_H
 
 #include <libopencm3/stm32/common/gpio_common_all.h>
+#include <libopencm3/stm32/common/gpio_common_f0234.h>
 
 /* --- Convenience macros -------------------------------------------------- */
 
@@ -258,6 +259,8 @@ void gpio_set_af(uint32_t gpioport, uint8_t alt_func_num, uint16_t gpios);
 
 END_DECLS
 
+#include <libopencm3/stm32/common/gpio_common_inline.h>
+
 #endif
 /**@}*/
 
@@ -44,6 +44,8 @@
 #include <libopencm3/stm32/common/flash_common_all.h>
 #include <libopencm3/stm32/common/flash_common_f.h>
 #include <libopencm3/stm32/common/flash_common_idcache.h>
+#include <libopencm3/stm32/common/flash_common_fast.h>
+#include <libopencm3/stm32/common/flash_common_eeprom.h>
 
 /* --- FLASH registers ----------------------------------------------------- */
 
@@ -41,6 +41,7 @@ LGPL License Terms @ref lgpl_license
 #define LIBOPENCM3_USB_AUDIO_H
 
 #include <stdint.h>
+#include <libopencm3/usb/usbd.h>
 
 /*
  * Definitions from the USB_AUDIO_ or usb_audio_ namespace come from:
@@ -229,6 +230,152 @@ struct usb_audio_format_type1_descriptor_1freq {
 	struct usb_audio_format_discrete_sampling_frequency freqs[1];
 } __attribute__((packed));
 
+/*
+ * Isochronous streaming support.
+ *
+ * A stream moves audio frames (one sample for every channel) between an
+ * isochronous endpoint and a ring buffer shared with the audio side of the
+ * application (I2S/SAI DMA, codec ISR, ...). OUT streams are fed from the
+ * endpoint callback, IN streams are sent from the SOF callback, so that
+ * exactly one packet goes out per (micro)frame.
+ *
+ * An asynchronous OUT stream also needs a feedback endpoint telling the host
+ * how many frames the device really consumes per (micro)frame, so the host
+ * can follow the device's own audio clock instead of drifting against it.
+ */
+
+/** Feedback value formats, USB 2.0 section 5.12.4.2 */
+enum usb_audio_feedback_format {
+	/** Full speed: 10.14 frames per frame, sent as 3 bytes */
+	USB_AUDIO_FEEDBACK_10_14,
+	/** High speed: 16.16 frames per microframe, sent as 4 bytes */
+	USB_AUDIO_FEEDBACK_16_16,
+};
+
+struct usb_audio_stream {
+	usbd_device *usbd_dev;
+	uint8_t ep;
+	/** Bytes per audio frame (channels * subframe size) */
+	uint8_t frame_size;
+	uint16_t max_packet;
+	/** (Micro)frames per second: 1000 at full speed, 8000 at high speed */
+	uint16_t interval_rate;
+	uint32_t rate;
+	uint32_t rate_accum;
+	/** Ring buffer, its size must be a power of two */
+	uint8_t *buf;
+	uint32_t buf_size;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	/** Bytes dropped because the ring was full */
+	uint32_t overruns;
+	/** Frames that went out short because the ring was empty */
+	uint32_t underruns;
+};
+
+struct usb_audio_feedback {
+	usbd_device *usbd_dev;
+	uint8_t ep;
+	enum usb_audio_feedback_format format;
+	/** Measurement period is 2^refresh (micro)frames, as in bRefresh */
+	uint8_t refresh;
+	uint16_t frames;
+	bool valid;
+	uint32_t last_count;
+	uint32_t nominal;
+	uint32_t value;
+};
+
+BEGIN_DECLS
+
+/**
+ * Initialise an isochronous audio stream.
+ * @param stream Stream to initialise
+ * @param usbd_dev the usb device handle returned from @ref usbd_init
+ * @param ep Streaming endpoint address, with direction bit
+ * @param max_packet wMaxPacketSize of the streaming endpoint
+ * @param rate Sampling frequency in Hz
+ * @param frame_size Bytes per audio frame (channels * subframe size)
+ * @param high_speed true if the device runs at high speed, one packet per microframe
+ * @param buf Ring buffer memory
+ * @param buf_size Size of @a buf in bytes, must be a power of two
+ */
+void usb_audio_stream_init(struct usb_audio_stream *stream, usbd_device *usbd_dev,
+			   uint8_t ep, uint16_t max_packet, uint32_t rate,
+			   uint8_t frame_size, bool high_speed,
+			   uint8_t *buf, uint32_t buf_size);
+
+/**
+ * Receive one packet of an OUT stream into the ring buffer.
+ * Call this from the endpoint callback of the streaming endpoint. The packet
+ * is staged on the stack, so this needs up to 1 KiB of stack.
+ * @param stream OUT stream
+ */
+void usb_audio_stream_rx(struct usb_audio_stream *stream);
+
+/**
+ * Send the next packet of an IN stream from the ring buffer.
+ * Call this from the SOF callback. The packet carries the nominal number of
+ * frames for this (micro)frame, plus or minus one frame to keep the ring
+ * half full, which is what an asynchronous IN endpoint is expected to do.
+ * Like @ref usb_audio_stream_rx this needs up to 1 KiB of stack.
+ * @param stream IN stream
+ */
+void usb_audio_stream_tx(struct usb_audio_stream *stream);
+
+/**
+ * Copy audio data into the ring buffer of an IN stream.
+ * @param stream IN stream
+ * @param data Data to copy
+ * @param len Number of bytes
+ * @return Number of bytes copied, less than @a len if the ring is full
+ */
+uint32_t usb_audio_stream_write(struct usb_audio_stream *stream, const void *data, uint32_t len);
+
+/**
+ * Copy audio data out of the ring buffer of an OUT stream.
+ * @param stream OUT stream
+ * @param data Destination buffer
+ * @param len Number of bytes
+ * @return Number of bytes copied, less than @a len if the ring ran dry
+ */
+uint32_t usb_audio_stream_read(struct usb_audio_stream *stream, void *data, uint32_t len);
+
+/**
+ * Get the number of bytes waiting in the ring buffer of a stream.
+ * @param stream Stream
+ */
+uint32_t usb_audio_stream_level(const struct usb_audio_stream *stream);
+
+/**
+ * Initialise an asynchronous feedback endpoint.
+ * @param fb Feedback state to initialise
+ * @param usbd_dev the usb device handle returned from @ref usbd_init
+ * @param ep Feedback endpoint address, with direction bit
+ * @param format Feedback value format, depending on the bus speed
+ * @param refresh Measurement period as 2^refresh (micro)frames, the
+ *                feedback endpoint's bRefresh (UAC1) or bInterval - 1 (UAC2).
+ *                Limited to 14 for 10.14 and 15 for 16.16 values.
+ * @param rate Nominal sampling frequency in Hz
+ */
+void usb_audio_feedback_init(struct usb_audio_feedback *fb, usbd_device *usbd_dev,
+			     uint8_t ep, enum usb_audio_feedback_format format,
+			     uint8_t refresh, uint32_t rate);
+
+/**
+ * Update and send the feedback value.
+ * Call this from the SOF callback registered with
+ * @ref usbd_register_sof_callback. Every 2^refresh (micro)frames the number
+ * of frames the audio side consumed is turned into a new feedback value.
+ * @param fb Feedback state
+ * @param count Free running count of audio frames consumed by the audio
+ *              side, e.g. a timer clocked from the I2S word select or the
+ *              DMA progress of the codec transfer
+ */
+void usb_audio_feedback_sof(struct usb_audio_feedback *fb, uint32_t count);
+
+END_DECLS
+
 #endif
 
 /**@}*/
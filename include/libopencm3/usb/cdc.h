@@ -39,6 +39,7 @@ LGPL License Terms @ref lgpl_license
 #define __CDC_H
 
 #include <stdint.h>
+#include <libopencm3/usb/usbd.h>
 
 /* Definitions of Communications Device Class from
  * "Universal Serial Bus Class Definitions for Communications Devices
@@ -158,6 +159,50 @@ struct usb_cdc_notification {
 	uint16_t wLength;
 } __attribute__((packed));
 
+/* Table 31: UART State Bitmap Values */
+#define USB_CDC_SERIAL_STATE_DCD		(1 << 0)
+#define USB_CDC_SERIAL_STATE_DSR		(1 << 1)
+#define USB_CDC_SERIAL_STATE_BREAK		(1 << 2)
+#define USB_CDC_SERIAL_STATE_RING		(1 << 3)
+#define USB_CDC_SERIAL_STATE_FRAMING		(1 << 4)
+#define USB_CDC_SERIAL_STATE_PARITY		(1 << 5)
+#define USB_CDC_SERIAL_STATE_OVERRUN		(1 << 6)
+
+/* Table 18: Control Signal Bitmap Values for SetControlLineState */
+#define USB_CDC_CONTROL_LINE_DTR		(1 << 0)
+#define USB_CDC_CONTROL_LINE_RTS		(1 << 1)
+
+/* Largest bulk packet handled by the CDC-ACM function */
+#define USB_CDCACM_MAX_PACKET			64
+
+typedef struct _usbd_cdcacm usbd_cdcacm;
+
+BEGIN_DECLS
+
+usbd_cdcacm *usb_cdcacm_init(usbd_device *usbd_dev, uint8_t comm_iface,
+			     uint8_t ep_notif, uint8_t ep_in, uint8_t ep_out,
+			     uint16_t ep_size,
+			     uint8_t *tx_buf, uint16_t tx_buf_size,
+			     uint8_t *rx_buf, uint16_t rx_buf_size);
+uint16_t usb_cdcacm_write(usbd_cdcacm *acm, const void *buf, uint16_t len);
+uint16_t usb_cdcacm_read(usbd_cdcacm *acm, void *buf, uint16_t len);
+uint16_t usb_cdcacm_tx_space(usbd_cdcacm *acm);
+uint16_t usb_cdcacm_rx_level(usbd_cdcacm *acm);
+void usb_cdcacm_flush(usbd_cdcacm *acm);
+void usb_cdcacm_set_tx_coalesce(usbd_cdcacm *acm, uint8_t frames);
+const struct usb_cdc_line_coding *usb_cdcacm_line_coding(usbd_cdcacm *acm);
+uint16_t usb_cdcacm_control_line_state(usbd_cdcacm *acm);
+void usb_cdcacm_register_line_coding_callback(usbd_cdcacm *acm,
+		void (*callback)(usbd_cdcacm *acm,
+				 const struct usb_cdc_line_coding *coding));
+void usb_cdcacm_register_control_line_callback(usbd_cdcacm *acm,
+		void (*callback)(usbd_cdcacm *acm, uint16_t state));
+void usb_cdcacm_register_rx_callback(usbd_cdcacm *acm,
+		void (*callback)(usbd_cdcacm *acm));
+bool usb_cdcacm_serial_state(usbd_cdcacm *acm, uint16_t state);
+
+END_DECLS
+
 #endif
 
 /**@}*/
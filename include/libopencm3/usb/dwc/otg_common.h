@@ -264,6 +264,9 @@
 #define OTG_DCFG_PFIVL		0x00001800U
 
 /* OTG device status register (OTG_DSTS) */
+#define OTG_DSTS_FNSOF_MASK	(0x3fffU << 8U)
+#define OTG_DSTS_FNSOF_SHIFT	8U
+#define OTG_DSTS_FNSOF_ODD	(1U << 8U)
 #define OTG_DSTS_SUSPSTS	(1U << 0U)
 
 /* OTG Device IN Endpoint Common Interrupt Mask Register (OTG_DIEPMSK) */
@@ -314,7 +317,10 @@
 #define OTG_DIEPCTL0_MPSIZ_8		(0x3U << 0U)
 
 /* OTG Device IN Endpoint X Control Register (OTG_DIEPCTLX) */
+#define OTG_DIEPCTLX_SODDFRM		(1U << 29U)
+#define OTG_DIEPCTLX_SEVNFRM		(1U << 28U)
 #define OTG_DIEPCTLX_EPTYP_SHIFT	18U
+#define OTG_DIEPCTLX_EONUM		(1U << 16U)
 #define OTG_DIEPCTLX_TXFNUM_SHIFT	22U
 #define OTG_DIEPCTLX_MPSIZ_MASK     (0x000007ffU)
 
@@ -341,6 +347,9 @@
 /* OTG Device OUT Endpoint X Control Register (OTG_DOEPCTLX) */
 #define OTG_DOEPCTLX_SD1PID			(1U << 29U)
 #define OTG_DOEPCTLX_SD0PID			(1U << 28U)
+#define OTG_DOEPCTLX_SODDFRM			(1U << 29U)
+#define OTG_DOEPCTLX_SEVNFRM			(1U << 28U)
+#define OTG_DOEPCTLX_EONUM			(1U << 16U)
 #define OTG_DIEPCTLX_EPTYP_SHIFT	18U
 #define OTG_DOEPCTLX_MPSIZ_MASK		(0x000007ffU)
 
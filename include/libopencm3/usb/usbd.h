@@ -242,6 +242,18 @@ extern uint8_t usbd_ep_stall_get(usbd_device *usbd_dev, uint8_t addr);
  */
 extern void usbd_ep_nak_set(usbd_device *usbd_dev, uint8_t addr, uint8_t nak);
 
+/** Get the endpoint FIFO memory left unused
+ *
+ * Drivers that plan their FIFO RAM (the DWC OTG cores) size the transmit
+ * FIFOs from the endpoint descriptors when a configuration is selected,
+ * preferring two packets of depth for bulk and isochronous IN endpoints.
+ * This reports what is left over after that plan and any endpoints set up
+ * outside of it.
+ * @param usbd_dev the usb device handle returned from @ref usbd_init
+ * @return Unused FIFO memory in bytes, 0 if the driver does not track it
+ */
+extern uint16_t usbd_fifo_mem_unused(usbd_device *usbd_dev);
+
 END_DECLS
 
 #endif
@@ -43,8 +43,11 @@
 */
 /**@{*/
 
+/* Always build the out of line versions of the inlinable accessors. */
+#undef LIBOPENCM3_INLINE
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/cm3/scb.h>
+#include <libopencm3/cm3/cortex.h>
 
 /*---------------------------------------------------------------------------*/
 /** @brief NVIC Enable Interrupt
@@ -180,6 +183,123 @@ void nvic_set_priority(uint8_t irqn, uint8_t priority)
 	}
 }
 
+/*---------------------------------------------------------------------------*/
+/** @brief NVIC Get Interrupt Priority
+ *
+ * Reads back the priority set with @ref nvic_set_priority. Unimplemented low
+ * order bits read as zero.
+ *
+ * @param[in] irqn Interrupt number @ref CM3_nvic_defines_irqs
+ * @return Interrupt priority (0 ... 255)
+ */
+uint8_t nvic_get_priority(uint8_t irqn)
+{
+	if (irqn >= NVIC_IRQ_COUNT) {
+		/* Cortex-M  system interrupts */
+#if defined(__ARM_ARCH_6M__)
+		irqn = (irqn & 0xF) - 4;
+		return SCB_SHPR32(irqn >> 2) >> ((irqn & 0x3) << 3);
+#else
+		return SCB_SHPR((irqn & 0xF) - 4);
+#endif
+	}
+	/* Device specific interrupts */
+#if defined(__ARM_ARCH_6M__)
+	return NVIC_IPR32(irqn >> 2) >> ((irqn & 0x3) << 3);
+#else
+	return NVIC_IPR(irqn);
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief NVIC Priority Ceiling Lock Initialise
+ *
+ * A priority ceiling lock protects data shared between thread code and a set
+ * of interrupt handlers. Entering the lock masks exactly the interrupts that
+ * can touch the data (those at or below the ceiling priority) while more
+ * urgent interrupts keep running. On ARMv6-M, which has no BASEPRI, entering
+ * the lock masks all interrupts.
+ *
+ * @param[in] lock Lock to initialise
+ * @param[in] ceiling Initial ceiling priority, encoded as for
+ * @ref nvic_set_priority. A ceiling of 0 masks nothing, as with BASEPRI: use it
+ * to start with no interrupts and add them with @ref nvic_ceiling_add_irq.
+ * (0xff is not empty, it still masks the lowest priority interrupts.)
+ */
+void nvic_ceiling_init(struct nvic_ceiling *lock, uint8_t ceiling)
+{
+	lock->ceiling = ceiling;
+	lock->primask = false;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief NVIC Priority Ceiling Lock Add Interrupt
+ *
+ * Raises the ceiling of the lock to cover an interrupt sharing the protected
+ * data. The priority is taken from the NVIC, so call this after
+ * @ref nvic_set_priority, and again if the priority is changed later. An
+ * interrupt at priority 0 makes the lock mask all interrupts with PRIMASK.
+ *
+ * @param[in] lock Lock to update
+ * @param[in] irqn Interrupt number @ref CM3_nvic_defines_irqs
+ */
+void nvic_ceiling_add_irq(struct nvic_ceiling *lock, uint8_t irqn)
+{
+	uint8_t prio = nvic_get_priority(irqn);
+
+	if (!prio) {
+		lock->primask = true;
+	} else if (!lock->ceiling || prio < lock->ceiling) {
+		lock->ceiling = prio;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief NVIC Priority Ceiling Lock Enter
+ *
+ * Masks all interrupts with a priority at or below the ceiling. Locks nest
+ * freely, an inner lock never lowers the mask set by an outer one. A ceiling
+ * of 0 masks nothing; a lock shared with a priority 0 interrupt masks all
+ * interrupts with PRIMASK.
+ *
+ * @param[in] lock Lock to enter
+ * @return State to be passed to @ref nvic_ceiling_exit
+ */
+uint32_t nvic_ceiling_enter(const struct nvic_ceiling *lock)
+{
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+	if (!lock->primask) {
+		/* BASEPRI_MAX ignores 0, leaving the mask as it is. */
+		return cm_raise_basepri(lock->ceiling);
+	}
+	/* Tag the saved PRIMASK so exit knows which mask to restore. */
+	return cm_mask_interrupts(1) | NVIC_CEILING_PRIMASK;
+#else
+	(void)lock;
+	return cm_mask_interrupts(1);
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief NVIC Priority Ceiling Lock Exit
+ *
+ * @param[in] lock Lock to leave
+ * @param[in] state Value returned by the matching @ref nvic_ceiling_enter
+ */
+void nvic_ceiling_exit(const struct nvic_ceiling *lock, uint32_t state)
+{
+	(void)lock;
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+	if (state & NVIC_CEILING_PRIMASK) {
+		cm_mask_interrupts(state & ~NVIC_CEILING_PRIMASK);
+		return;
+	}
+	cm_set_basepri(state);
+#else
+	cm_mask_interrupts(state);
+#endif
+}
+
 /* Those are defined only on CM3 or CM4 */
 #if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
 /*---------------------------------------------------------------------------*/
@@ -17,12 +17,20 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <libopencm3/cm3/sync.h>
+#if defined(__arm__)
+#include <libopencm3/cm3/cortex.h>
+#endif
 
 /* DMB is supported on CM0 */
 void __dmb()
 {
+#if defined(__arm__)
 	__asm__ volatile ("dmb");
+#else
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
 }
 
 /* Those are defined only on CM3 or CM4 */
@@ -77,3 +85,330 @@ void mutex_unlock(mutex_t *m)
 }
 
 #endif
+
+/*---------------------------------------------------------------------------*/
+/* Atomic read-modify-write helpers.
+ *
+ * ARMv7-M retries an LDREX/STREX pair until the store succeeds.  ARMv6-M has
+ * no exclusive monitor, so the read-modify-write is done with PRIMASK set;
+ * on a single core this is equivalent and only costs a few cycles of latency.
+ * Host builds use the GCC/Clang C11 atomic builtins.
+ */
+
+uint32_t sync_critical_enter(void)
+{
+#if defined(__arm__)
+	return cm_mask_interrupts(1);
+#else
+	return 0;
+#endif
+}
+
+void sync_critical_exit(uint32_t state)
+{
+#if defined(__arm__)
+	cm_mask_interrupts(state);
+#else
+	(void)state;
+#endif
+}
+
+bool sync_cas(volatile uint32_t *addr, uint32_t expected, uint32_t desired)
+{
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+	do {
+		if (__ldrex(addr) != expected) {
+			/* Drop the reservation. */
+			__asm__ volatile ("clrex");
+			return false;
+		}
+	} while (__strex(desired, addr));
+	__dmb();
+	return true;
+#elif defined(__arm__)
+	bool ok = false;
+	uint32_t state = sync_critical_enter();
+	if (*addr == expected) {
+		*addr = desired;
+		ok = true;
+	}
+	sync_critical_exit(state);
+	return ok;
+#else
+	return __atomic_compare_exchange_n(addr, &expected, desired, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#define SYNC_RMW(addr, op)						\
+	uint32_t old;							\
+	do {								\
+		old = __ldrex(addr);					\
+	} while (__strex(old op val, addr));				\
+	__dmb();							\
+	return old
+#elif defined(__arm__)
+#define SYNC_RMW(addr, op)						\
+	uint32_t state = sync_critical_enter();				\
+	uint32_t old = *(addr);						\
+	*(addr) = old op val;						\
+	sync_critical_exit(state);					\
+	return old
+#endif
+
+uint32_t sync_fetch_add(volatile uint32_t *addr, uint32_t val)
+{
+#if defined(__arm__)
+	SYNC_RMW(addr, +);
+#else
+	return __atomic_fetch_add(addr, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+uint32_t sync_fetch_or(volatile uint32_t *addr, uint32_t val)
+{
+#if defined(__arm__)
+	SYNC_RMW(addr, |);
+#else
+	return __atomic_fetch_or(addr, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+uint32_t sync_fetch_and(volatile uint32_t *addr, uint32_t val)
+{
+#if defined(__arm__)
+	SYNC_RMW(addr, &);
+#else
+	return __atomic_fetch_and(addr, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/* Atomic bit flags */
+
+void sync_flags_set(sync_flags_t *flags, uint32_t mask)
+{
+	sync_fetch_or(flags, mask);
+}
+
+void sync_flags_clear(sync_flags_t *flags, uint32_t mask)
+{
+	sync_fetch_and(flags, ~mask);
+}
+
+/* Returns which of the flags in mask were set, clearing them atomically. */
+uint32_t sync_flags_test_and_clear(sync_flags_t *flags, uint32_t mask)
+{
+	if (!(*flags & mask)) {
+		/* Cheap early out: nothing to consume. */
+		return 0;
+	}
+	return sync_fetch_and(flags, ~mask) & mask;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Single producer, single consumer ring.
+ *
+ * The producer only ever writes head and the consumer only ever writes tail,
+ * so plain loads and stores are sufficient.  The barriers order the data
+ * copy against the index update that publishes (or releases) it.
+ */
+
+static inline bool sync_is_pow2(uint32_t n)
+{
+	return n && !(n & (n - 1));
+}
+
+bool sync_ring_init(struct sync_ring *ring, void *buf, uint16_t elem_size,
+		    uint32_t count)
+{
+	if (!sync_is_pow2(count) || !elem_size) {
+		return false;
+	}
+	ring->buf = buf;
+	ring->elem_size = elem_size;
+	ring->mask = count - 1;
+	ring->head = 0;
+	ring->tail = 0;
+	return true;
+}
+
+/* Only safe while neither side is active. */
+void sync_ring_reset(struct sync_ring *ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	__dmb();
+}
+
+uint32_t sync_ring_level(const struct sync_ring *ring)
+{
+	return ring->head - ring->tail;
+}
+
+uint32_t sync_ring_space(const struct sync_ring *ring)
+{
+	return ring->mask + 1 - (ring->head - ring->tail);
+}
+
+bool sync_ring_put(struct sync_ring *ring, const void *elem)
+{
+	uint32_t head = ring->head;
+
+	if (head - ring->tail > ring->mask) {
+		return false;
+	}
+	memcpy(&ring->buf[(head & ring->mask) * ring->elem_size], elem,
+	       ring->elem_size);
+	__dmb();
+	ring->head = head + 1;
+	return true;
+}
+
+bool sync_ring_peek(const struct sync_ring *ring, void *elem)
+{
+	uint32_t tail = ring->tail;
+
+	if (ring->head == tail) {
+		return false;
+	}
+	__dmb();
+	memcpy(elem, &ring->buf[(tail & ring->mask) * ring->elem_size],
+	       ring->elem_size);
+	return true;
+}
+
+bool sync_ring_get(struct sync_ring *ring, void *elem)
+{
+	if (!sync_ring_peek(ring, elem)) {
+		return false;
+	}
+	__dmb();
+	ring->tail++;
+	return true;
+}
+
+/* Bulk copy of up to count elements; at most two memcpy()s per call. */
+uint32_t sync_ring_write(struct sync_ring *ring, const void *data,
+			 uint32_t count)
+{
+	const uint8_t *src = data;
+	uint32_t head = ring->head;
+	uint32_t size = ring->mask + 1;
+	uint32_t space = size - (head - ring->tail);
+	uint32_t idx = head & ring->mask;
+	uint32_t first;
+
+	if (count > space) {
+		count = space;
+	}
+	first = size - idx;
+	if (first > count) {
+		first = count;
+	}
+	memcpy(&ring->buf[idx * ring->elem_size], src,
+	       first * ring->elem_size);
+	memcpy(ring->buf, &src[first * ring->elem_size],
+	       (count - first) * ring->elem_size);
+	__dmb();
+	ring->head = head + count;
+	return count;
+}
+
+uint32_t sync_ring_read(struct sync_ring *ring, void *data, uint32_t count)
+{
+	uint8_t *dst = data;
+	uint32_t tail = ring->tail;
+	uint32_t level = ring->head - tail;
+	uint32_t size = ring->mask + 1;
+	uint32_t idx = tail & ring->mask;
+	uint32_t first;
+
+	if (count > level) {
+		count = level;
+	}
+	__dmb();
+	first = size - idx;
+	if (first > count) {
+		first = count;
+	}
+	memcpy(dst, &ring->buf[idx * ring->elem_size],
+	       first * ring->elem_size);
+	memcpy(&dst[first * ring->elem_size], ring->buf,
+	       (count - first) * ring->elem_size);
+	__dmb();
+	ring->tail = tail + count;
+	return count;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Multiple producer, single consumer queue.
+ *
+ * Slot i is free for position p when seq[i] == p, and holds data for
+ * position p when seq[i] == p + 1.  After consuming, the slot is handed to
+ * the producer that will wrap around onto it by setting seq[i] = p + count.
+ */
+
+bool sync_mpsc_init(struct sync_mpsc *q, void *buf, uint32_t *seq,
+		    uint16_t elem_size, uint32_t count)
+{
+	uint32_t i;
+
+	if (!sync_is_pow2(count) || !elem_size) {
+		return false;
+	}
+	q->buf = buf;
+	q->seq = seq;
+	q->elem_size = elem_size;
+	q->mask = count - 1;
+	q->head = 0;
+	q->tail = 0;
+	for (i = 0; i < count; i++) {
+		seq[i] = i;
+	}
+	__dmb();
+	return true;
+}
+
+bool sync_mpsc_put(struct sync_mpsc *q, const void *elem)
+{
+	uint32_t pos;
+	uint32_t idx;
+
+	do {
+		pos = q->head;
+		idx = pos & q->mask;
+		if ((int32_t)(q->seq[idx] - pos) < 0) {
+			/* Consumer has not released this slot yet: full. */
+			return false;
+		}
+	} while (!sync_cas(&q->head, pos, pos + 1));
+
+	memcpy(&q->buf[idx * q->elem_size], elem, q->elem_size);
+	__dmb();
+	q->seq[idx] = pos + 1;
+	return true;
+}
+
+bool sync_mpsc_get(struct sync_mpsc *q, void *elem)
+{
+	uint32_t pos = q->tail;
+	uint32_t idx = pos & q->mask;
+
+	if (q->seq[idx] != pos + 1) {
+		/* Empty, or the producer for this slot is still copying. */
+		return false;
+	}
+	__dmb();
+	memcpy(elem, &q->buf[idx * q->elem_size], q->elem_size);
+	__dmb();
+	q->seq[idx] = pos + q->mask + 1;
+	q->tail = pos + 1;
+	return true;
+}
+
+bool sync_mpsc_empty(const struct sync_mpsc *q)
+{
+	return q->seq[q->tail & q->mask] != q->tail + 1;
+}
@@ -31,6 +31,9 @@ typedef void (*funcp_t) (void);
 extern funcp_t __preinit_array_start, __preinit_array_end;
 extern funcp_t __init_array_start, __init_array_end;
 extern funcp_t __fini_array_start, __fini_array_end;
+/* Only there when the linker script has an xdram region. */
+extern unsigned _xdram __attribute__((weak));
+extern unsigned _exdram __attribute__((weak));
 
 int main(void);
 void blocking_handler(void);
@@ -81,6 +84,12 @@ void __attribute__((weak, used)) reset_handler(void)
 	/* might be provided by platform specific vector.c */
 	pre_main();
 
+	/* External memory can only be cleared once it is running. */
+	external_memory_setup();
+	for (dest = &_xdram; dest < &_exdram; dest++) {
+		*dest = 0;
+	}
+
 	/* Constructors. */
 	for (fp = &__preinit_array_start; fp < &__preinit_array_end; fp++) {
 		(*fp)();
@@ -99,6 +108,11 @@ void __attribute__((weak, used)) reset_handler(void)
 
 }
 
+void __attribute__((weak)) external_memory_setup(void)
+{
+	/* Do nothing. */
+}
+
 void blocking_handler(void)
 {
 	while (1);
@@ -35,6 +35,7 @@ LGPL License Terms @ref lgpl_license
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/can.h>
 #include <libopencm3/stm32/rcc.h>
 
@@ -571,3 +572,402 @@ uint32_t can_fifo_pending(uint32_t canport, uint8_t fifo)
 	}
 }
 
+
+/* --- Interrupt driven port ----------------------------------------------- */
+
+#define CAN_PORT_IRQS (CAN_IER_TMEIE | CAN_IER_FMPIE0 | CAN_IER_FOVIE0 | \
+		       CAN_IER_FMPIE1 | CAN_IER_FOVIE1 | CAN_IER_ERRIE | \
+		       CAN_IER_LECIE | CAN_IER_EPVIE | CAN_IER_BOFIE)
+
+static const uint32_t can_mbox_base[3] = {CAN_MBOX0, CAN_MBOX1, CAN_MBOX2};
+
+/* Arbitration key, the lower key wins on the bus. The 11 bit base identifier
+ * is compared first, then a standard frame beats an extended one with the
+ * same base (SRR and IDE are recessive), then a data frame beats a remote
+ * frame with the same identifier.
+ */
+static uint32_t can_frame_key(const struct can_frame *frame)
+{
+	uint32_t key;
+
+	if (frame->ext) {
+		key = ((frame->id & 0x1FFFFFFF) << 1) | 1;
+	} else {
+		key = (frame->id & 0x7FF) << 19;
+	}
+	return (key << 1) | (frame->rtr ? 1 : 0);
+}
+
+/* The queue is sorted with the best frame last, so taking it is O(1). A new
+ * frame goes below the frames with an equal key, a frame returned from an
+ * aborted mailbox goes above them, as it was queued before them.
+ */
+static void can_port_queue(struct can_port *port,
+			   const struct can_frame *frame, bool requeue)
+{
+	struct can_frame *queue = port->tx_queue;
+	uint32_t key = can_frame_key(frame);
+	uint16_t i = port->tx_count;
+
+	while (i > 0) {
+		uint32_t k = can_frame_key(&queue[i - 1]);
+
+		if (requeue ? k < key : k <= key) {
+			queue[i] = queue[i - 1];
+			i--;
+		} else {
+			break;
+		}
+	}
+	queue[i] = *frame;
+	port->tx_count++;
+}
+
+static void can_port_load(struct can_port *port, unsigned mb)
+{
+	uint32_t canport = port->canport;
+	uint32_t mailbox = can_mbox_base[mb];
+	const struct can_frame *frame = &port->tx_queue[--port->tx_count];
+	uint32_t tir;
+
+	port->mbox[mb] = *frame;
+	port->mbox_busy |= 1 << mb;
+
+	if (frame->ext) {
+		tir = (frame->id << CAN_TIxR_EXID_SHIFT) | CAN_TIxR_IDE;
+	} else {
+		tir = frame->id << CAN_TIxR_STID_SHIFT;
+	}
+	if (frame->rtr) {
+		tir |= CAN_TIxR_RTR;
+	}
+	CAN_TDTxR(canport, mailbox) = frame->len & CAN_TDTxR_DLC_MASK;
+	CAN_TDLxR(canport, mailbox) = frame->data.data32[0];
+	CAN_TDHxR(canport, mailbox) = frame->data.data32[1];
+	CAN_TIxR(canport, mailbox) = tir | CAN_TIxR_TXRQ;
+}
+
+/* Move queued frames to the mailboxes while they beat what is already there.
+ * Called with interrupts masked. */
+static void can_port_kick(struct can_port *port)
+{
+	while (port->tx_count) {
+		uint32_t key = can_frame_key(&port->tx_queue[port->tx_count - 1]);
+		uint32_t worst_key = 0;
+		int free_mb = -1;
+		int worst_mb = -1;
+
+		for (unsigned mb = 0; mb < 3; mb++) {
+			uint32_t k;
+
+			if (!(port->mbox_busy & (1 << mb))) {
+				if (free_mb < 0) {
+					free_mb = mb;
+				}
+				continue;
+			}
+			k = can_frame_key(&port->mbox[mb]);
+			if (k == key) {
+				/* Pending mailboxes with equal identifiers go
+				 * out lowest mailbox first, which may not be
+				 * the order they were queued in. */
+				return;
+			}
+			if (k >= worst_key) {
+				worst_key = k;
+				worst_mb = mb;
+			}
+		}
+
+		if (free_mb >= 0) {
+			can_port_load(port, free_mb);
+			continue;
+		}
+
+		/* All mailboxes busy: evict the lowest priority one if the
+		 * queue head beats it. Its frame comes back through the
+		 * transmit interrupt, so keep a queue slot for it. */
+		if (key < worst_key && !port->mbox_abort &&
+		    port->tx_count < port->tx_size) {
+			port->mbox_abort = 1 << worst_mb;
+			CAN_TSR(port->canport) = CAN_TSR_ABRQ0 << (8 * worst_mb);
+		}
+		return;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Set up an Interrupt Driven Port
+
+The CAN peripheral must have been initialised with @ref can_init, with the
+transmit FIFO priority (txfp) off so that pending mailboxes are sent in
+identifier order. The port then owns the transmit mailboxes and both receive
+FIFOs; can_transmit() and can_receive() must not be used on it.
+
+@param[out] port Port state.
+@param[in] canport Unsigned int32. CAN block register base @ref can_reg_base.
+@param[in] tx_queue Storage for the software transmit queue.
+@param[in] tx_size Number of frames in tx_queue.
+@param[in] rx_buf Storage for the receive queue.
+@param[in] rx_seq Sequence words for the receive queue, one per frame.
+@param[in] rx_size Number of frames in rx_buf, a power of two.
+@returns bool. false if a size is invalid.
+ */
+bool can_port_init(struct can_port *port, uint32_t canport,
+		   struct can_frame *tx_queue, uint16_t tx_size,
+		   struct can_frame *rx_buf, uint32_t *rx_seq, uint32_t rx_size)
+{
+	if (!tx_size || !sync_mpsc_init(&port->rx, rx_buf, rx_seq,
+					sizeof(struct can_frame), rx_size)) {
+		return false;
+	}
+	port->canport = canport;
+	port->tx_queue = tx_queue;
+	port->tx_size = tx_size;
+	port->tx_count = 0;
+	port->mbox_busy = 0;
+	port->mbox_abort = 0;
+	port->esr = 0;
+	port->stats = (struct can_port_stats){0};
+
+	CAN_IER(canport) |= CAN_PORT_IRQS;
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Stop an Interrupt Driven Port
+
+Disables the port interrupts, aborts the pending mailboxes and drops the
+transmit queue. Received frames stay readable.
+
+@param[in] port Port state.
+ */
+void can_port_stop(struct can_port *port)
+{
+	CAN_IER(port->canport) &= ~CAN_PORT_IRQS;
+	CAN_TSR(port->canport) = CAN_TSR_ABRQ0 | CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2;
+	port->tx_count = 0;
+	port->mbox_busy = 0;
+	port->mbox_abort = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue a Frame on a Port
+
+The frame is copied, so it may be reused on return. Safe to call from any
+context.
+
+@param[in] port Port state.
+@param[in] frame Frame to send, len at most 8.
+@returns int 0 on success, -1 if the transmit queue is full.
+ */
+int can_port_send(struct can_port *port, const struct can_frame *frame)
+{
+	int ret = -1;
+
+	CM_ATOMIC_BLOCK() {
+		/* One slot stays free for a frame in an aborting mailbox. */
+		if (port->tx_count + (port->mbox_abort ? 1 : 0) <
+		    port->tx_size) {
+			can_port_queue(port, frame, false);
+			can_port_kick(port);
+			ret = 0;
+		}
+	}
+	return ret;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Take a Received Frame from a Port
+
+Frames from both FIFOs come out in the order they were taken from the
+hardware. Only one context may read a port.
+
+@param[in] port Port state.
+@param[out] frame Received frame.
+@returns bool. false if no frame is waiting.
+ */
+bool can_port_receive(struct can_port *port, struct can_frame *frame)
+{
+	return sync_mpsc_get(&port->rx, frame);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Get the Number of Frames Not Yet Sent
+
+@param[in] port Port state.
+@returns Unsigned int16. Frames queued or waiting in a mailbox.
+ */
+uint16_t can_port_tx_pending(struct can_port *port)
+{
+	uint16_t pending = 0;
+
+	CM_ATOMIC_BLOCK() {
+		pending = port->tx_count;
+		for (unsigned mb = 0; mb < 3; mb++) {
+			if (port->mbox_busy & (1 << mb)) {
+				pending++;
+			}
+		}
+	}
+	return pending;
+}
+
+static void can_port_tx_done(struct can_port *port)
+{
+	uint32_t tsr = CAN_TSR(port->canport);
+
+	for (unsigned mb = 0; mb < 3; mb++) {
+		uint32_t shift = 8 * mb;
+		uint8_t bit = 1 << mb;
+
+		if (!(tsr & (CAN_TSR_RQCP0 << shift))) {
+			continue;
+		}
+		/* Writing RQCP also clears TXOK, ALST and TERR. */
+		CAN_TSR(port->canport) = CAN_TSR_RQCP0 << shift;
+		if (!(port->mbox_busy & bit)) {
+			continue;
+		}
+		port->mbox_busy &= ~bit;
+
+		if (tsr & (CAN_TSR_TXOK0 << shift)) {
+			/* Also the case if an abort came too late. */
+			port->stats.tx_frames++;
+		} else if (port->mbox_abort & bit) {
+			can_port_queue(port, &port->mbox[mb], true);
+			port->stats.tx_preempted++;
+		} else {
+			port->stats.tx_failed++;
+		}
+		port->mbox_abort &= ~bit;
+	}
+	can_port_kick(port);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Port Transmit Interrupt Handler
+
+Call from the CAN transmit interrupt vector (e.g. usb_hp_can_tx_isr() or
+can1_tx_isr()).
+
+@param[in] port Port state.
+ */
+void can_port_tx_isr(struct can_port *port)
+{
+	/* can_port_send() may be called from a higher priority interrupt. */
+	CM_ATOMIC_BLOCK() {
+		can_port_tx_done(port);
+	}
+}
+
+static void can_port_drain(struct can_port *port, uint32_t fifo_id,
+			   volatile uint32_t *rfr)
+{
+	uint32_t canport = port->canport;
+	uint32_t frames = 0;
+	uint32_t dropped = 0;
+	struct can_frame frame;
+
+	while (*rfr & CAN_RF0R_FMP0_MASK) {
+		uint32_t rir = CAN_RIxR(canport, fifo_id);
+		uint32_t rdtr = CAN_RDTxR(canport, fifo_id);
+
+		frame.ext = rir & CAN_RIxR_IDE;
+		if (frame.ext) {
+			frame.id = (rir >> CAN_RIxR_EXID_SHIFT) &
+				   CAN_RIxR_EXID_MASK;
+		} else {
+			frame.id = (rir >> CAN_RIxR_STID_SHIFT) &
+				   CAN_RIxR_STID_MASK;
+		}
+		frame.rtr = rir & CAN_RIxR_RTR;
+		frame.len = rdtr & CAN_RDTxR_DLC_MASK;
+		if (frame.len > 8) {
+			frame.len = 8;
+		}
+		frame.fmi = (rdtr & CAN_RDTxR_FMI_MASK) >> CAN_RDTxR_FMI_SHIFT;
+		frame.timestamp = (rdtr & CAN_RDTxR_TIME_MASK) >>
+				  CAN_RDTxR_TIME_SHIFT;
+		frame.data.data32[0] = CAN_RDLxR(canport, fifo_id);
+		frame.data.data32[1] = CAN_RDHxR(canport, fifo_id);
+
+		/* Release the mailbox and wait until the next frame (if any)
+		 * has moved up, so FMP is current on the next pass. */
+		*rfr = CAN_RF0R_RFOM0;
+		while (*rfr & CAN_RF0R_RFOM0);
+
+		frames++;
+		if (!sync_mpsc_put(&port->rx, &frame)) {
+			dropped++;
+		}
+	}
+
+	if (*rfr & CAN_RF0R_FOVR0) {
+		*rfr = CAN_RF0R_FOVR0 | CAN_RF0R_FULL0;
+		sync_fetch_add(&port->stats.rx_overruns, 1);
+	}
+	if (frames) {
+		sync_fetch_add(&port->stats.rx_frames, frames);
+	}
+	if (dropped) {
+		sync_fetch_add(&port->stats.rx_dropped, dropped);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Port FIFO 0 Interrupt Handler
+
+Call from the CAN FIFO 0 interrupt vector (e.g. usb_lp_can_rx0_isr() or
+can1_rx0_isr()). Empties the FIFO into the receive queue.
+
+@param[in] port Port state.
+ */
+void can_port_rx0_isr(struct can_port *port)
+{
+	can_port_drain(port, CAN_FIFO0, &CAN_RF0R(port->canport));
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Port FIFO 1 Interrupt Handler
+
+Call from the CAN FIFO 1 interrupt vector (e.g. can_rx1_isr() or
+can1_rx1_isr()). Empties the FIFO into the receive queue.
+
+@param[in] port Port state.
+ */
+void can_port_rx1_isr(struct can_port *port)
+{
+	/* RF1R has the same layout as RF0R. */
+	can_port_drain(port, CAN_FIFO1, &CAN_RF1R(port->canport));
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Port Status Change and Error Interrupt Handler
+
+Call from the CAN SCE interrupt vector. Updates the error statistics; a port
+that went bus off recovers on its own only if can_init() was called with
+abom set.
+
+@param[in] port Port state.
+ */
+void can_port_sce_isr(struct can_port *port)
+{
+	uint32_t canport = port->canport;
+	uint32_t esr = CAN_ESR(canport);
+	uint32_t raised = esr & ~port->esr;
+
+	if (esr & CAN_ESR_LEC_MASK) {
+		port->stats.bus_errors++;
+		/* Reset the code so the next error is seen as new. */
+		CAN_ESR(canport) = esr & ~CAN_ESR_LEC_MASK;
+	}
+	if (raised & CAN_ESR_EPVF) {
+		port->stats.error_passive++;
+	}
+	if (raised & CAN_ESR_BOFF) {
+		port->stats.bus_off++;
+	}
+	port->esr = esr & (CAN_ESR_EPVF | CAN_ESR_BOFF);
+	CAN_MSR(canport) = CAN_MSR_ERRI;
+}
@@ -0,0 +1,446 @@
+/** @addtogroup can_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/can.h>
+
+#define CAN_STD_ID_MASK		0x7FF
+#define CAN_EXT_ID_MASK		0x1FFFFFFF
+
+/* 32 bit filters use the CAN_TIxR layout: STID[10:0] EXID[17:0] IDE RTR 0 */
+#define CAN_F32_STID_SHIFT	21
+#define CAN_F32_EXID_SHIFT	3
+#define CAN_F32_IDE		(1 << 2)
+#define CAN_F32_RTR		(1 << 1)
+
+/* 16 bit filters: STID[10:0] RTR IDE EXID[17:15] */
+#define CAN_F16_STID_SHIFT	5
+#define CAN_F16_RTR		(1 << 4)
+#define CAN_F16_IDE		(1 << 3)
+
+/* Groups: one per FIFO and identifier format, as a bank serves only one. */
+#define CAN_FILTER_GROUP(ext, fifo)	(((ext) ? 2 : 0) | (fifo))
+
+static uint32_t can_filter_id_mask(bool ext)
+{
+	return ext ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK;
+}
+
+static bool can_filter_exact(const struct can_filter_block *b)
+{
+	return b->mask == can_filter_id_mask(b->ext);
+}
+
+/* Does block a accept every identifier block b accepts? */
+static bool can_filter_covers(const struct can_filter_block *a,
+			      const struct can_filter_block *b)
+{
+	return a->ext == b->ext && a->fifo == b->fifo &&
+	       (b->mask & a->mask) == a->mask &&
+	       ((b->id ^ a->id) & a->mask) == 0;
+}
+
+/* Add a block, dropping it if it is covered and dropping what it covers. */
+static bool can_filter_add(struct can_filter_block *work, uint32_t *n,
+			   uint32_t size, const struct can_filter_block *b)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < *n; i++) {
+		if (can_filter_covers(&work[i], b)) {
+			return true;
+		}
+	}
+	for (i = 0, j = 0; i < *n; i++) {
+		if (!can_filter_covers(b, &work[i])) {
+			work[j++] = work[i];
+		}
+	}
+	*n = j;
+	if (j == size) {
+		return false;
+	}
+	work[(*n)++] = *b;
+	return true;
+}
+
+/* Split a range into aligned power of two blocks. */
+static bool can_filter_split(const struct can_filter_rule *rule,
+			     struct can_filter_block *work, uint32_t *n,
+			     uint32_t size)
+{
+	uint32_t id_mask = can_filter_id_mask(rule->ext);
+	uint32_t first = rule->id;
+	struct can_filter_block b = {
+		.ext = rule->ext,
+		.fifo = rule->fifo,
+	};
+
+	if (first > rule->last || rule->last > id_mask || rule->fifo > 1) {
+		return false;
+	}
+	while (true) {
+		uint32_t len = first ? (first & -first) : id_mask + 1;
+
+		while (len - 1 > rule->last - first) {
+			len >>= 1;
+		}
+		b.id = first;
+		b.mask = id_mask & ~(len - 1);
+		if (!can_filter_add(work, n, size, &b)) {
+			return false;
+		}
+		if (len - 1 == rule->last - first) {
+			return true;
+		}
+		first += len;
+	}
+}
+
+/*
+ * Banks needed for the blocks of every group. Standard groups may move up
+ * to three single identifiers from a partly used list bank to a partly used
+ * mask bank; convert returns how many, per group.
+ */
+static uint32_t can_filter_count(const struct can_filter_block *work,
+				 uint32_t n, uint32_t convert[4])
+{
+	uint32_t list[4] = {0};
+	uint32_t mask[4] = {0};
+	uint32_t total = 0;
+	uint32_t i;
+	unsigned g;
+
+	for (i = 0; i < n; i++) {
+		g = CAN_FILTER_GROUP(work[i].ext, work[i].fifo);
+		if (can_filter_exact(&work[i])) {
+			list[g]++;
+		} else {
+			mask[g]++;
+		}
+	}
+
+	for (g = 0; g < 4; g++) {
+		convert[g] = 0;
+		if (g & 2) {
+			total += (list[g] + 1) / 2 + mask[g];
+			continue;
+		}
+
+		uint32_t best = (list[g] + 3) / 4 + (mask[g] + 1) / 2;
+		for (uint32_t k = 1; k <= list[g] && k < 4; k++) {
+			uint32_t banks = (list[g] - k + 3) / 4 +
+					 (mask[g] + k + 1) / 2;
+			if (banks < best) {
+				best = banks;
+				convert[g] = k;
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+/* Replace the two blocks of a group that are closest (whose merged block
+ * lets through the fewest extra identifiers) by their merged block. */
+static bool can_filter_merge(struct can_filter_block *work, uint32_t *n,
+			     uint32_t size)
+{
+	uint32_t best_i = 0, best_j = 0;
+	int best_bits = 33;
+	struct can_filter_block merged;
+
+	for (uint32_t i = 0; i < *n; i++) {
+		for (uint32_t j = i + 1; j < *n; j++) {
+			uint32_t m;
+			int bits;
+
+			if (work[i].ext != work[j].ext ||
+			    work[i].fifo != work[j].fifo) {
+				continue;
+			}
+			m = work[i].mask & work[j].mask &
+			    ~(work[i].id ^ work[j].id);
+			bits = __builtin_popcount(can_filter_id_mask(work[i].ext)
+						  & ~m);
+			if (bits < best_bits) {
+				best_bits = bits;
+				best_i = i;
+				best_j = j;
+			}
+		}
+	}
+	if (best_bits == 33) {
+		return false;
+	}
+
+	merged = work[best_i];
+	merged.mask &= work[best_j].mask & ~(work[best_i].id ^ work[best_j].id);
+	merged.id &= merged.mask;
+	work[best_j] = work[--*n];
+	work[best_i] = work[--*n];
+	return can_filter_add(work, n, size, &merged);
+}
+
+struct can_filter_out {
+	struct can_filter_bank *banks;
+	uint32_t nbanks;
+	uint32_t slot[4];
+	unsigned used;
+};
+
+/* Write out a bank, filling unused slots with copies of the first. */
+static void can_filter_flush(struct can_filter_out *out, unsigned per_bank,
+			     bool scale_32bit, bool list, uint8_t fifo)
+{
+	struct can_filter_bank *bank = &out->banks[out->nbanks++];
+	uint32_t v[4];
+
+	for (unsigned k = 0; k < per_bank; k++) {
+		v[k] = out->slot[k < out->used ? k : 0];
+	}
+	if (per_bank == 4) {
+		bank->fr1 = (v[1] << 16) | v[0];
+		bank->fr2 = (v[3] << 16) | v[2];
+	} else {
+		bank->fr1 = v[0];
+		bank->fr2 = v[1];
+	}
+	bank->scale_32bit = scale_32bit;
+	bank->id_list_mode = list;
+	bank->fifo = fifo;
+	out->used = 0;
+}
+
+static void can_filter_push(struct can_filter_out *out, uint32_t value,
+			    unsigned per_bank, bool scale_32bit, bool list,
+			    uint8_t fifo)
+{
+	out->slot[out->used++] = value;
+	if (out->used == per_bank) {
+		can_filter_flush(out, per_bank, scale_32bit, list, fifo);
+	}
+}
+
+static void can_filter_emit(struct can_filter_out *out,
+			    const struct can_filter_block *work, uint32_t n,
+			    bool ext, uint8_t fifo, uint32_t convert)
+{
+	unsigned per_bank = ext ? 2 : 4;
+	uint32_t skipped = 0;
+	uint32_t i;
+
+	/* List banks, except for the identifiers moved to mask banks. */
+	for (i = 0; i < n; i++) {
+		const struct can_filter_block *b = &work[i];
+
+		if (b->ext != ext || b->fifo != fifo || !can_filter_exact(b)) {
+			continue;
+		}
+		if (skipped < convert) {
+			skipped++;
+			continue;
+		}
+		can_filter_push(out, ext ?
+				(b->id << CAN_F32_EXID_SHIFT) | CAN_F32_IDE :
+				b->id << CAN_F16_STID_SHIFT,
+				per_bank, ext, true, fifo);
+	}
+	if (out->used) {
+		can_filter_flush(out, per_bank, ext, true, fifo);
+	}
+
+	/* Mask banks. */
+	per_bank = 2;
+	skipped = 0;
+	for (i = 0; i < n; i++) {
+		const struct can_filter_block *b = &work[i];
+
+		if (b->ext != ext || b->fifo != fifo) {
+			continue;
+		}
+		if (can_filter_exact(b) && skipped++ >= convert) {
+			continue;
+		}
+		if (ext) {
+			can_filter_push(out, (b->id << CAN_F32_EXID_SHIFT) |
+					CAN_F32_IDE, per_bank, true, false,
+					fifo);
+			can_filter_push(out, (b->mask << CAN_F32_EXID_SHIFT) |
+					CAN_F32_IDE | CAN_F32_RTR, per_bank,
+					true, false, fifo);
+		} else {
+			can_filter_push(out, (((b->mask << CAN_F16_STID_SHIFT) |
+					CAN_F16_RTR | CAN_F16_IDE) << 16) |
+					(b->id << CAN_F16_STID_SHIFT),
+					per_bank, false, false, fifo);
+		}
+	}
+	if (out->used) {
+		can_filter_flush(out, per_bank, ext, false, fifo);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Compile Acceptance Filters
+
+@param[in] rules Identifiers and ranges to accept.
+@param[in] nrules Number of rules.
+@param[out] work Scratch space for the compiler. A range can split into up to
+twice as many blocks as its identifier has bits, so a few times nrules blocks
+is usually plenty.
+@param[in] work_size Number of blocks in work.
+@param[out] banks Filter bank settings, in the order to program them.
+@param[in] max_banks Number of banks available.
+@returns int Number of banks used, -1 if a rule is invalid, work is too small
+or max_banks is below the number of distinct FIFO and identifier format
+combinations in the rules.
+ */
+int can_filter_compile(const struct can_filter_rule *rules, uint32_t nrules,
+		       struct can_filter_block *work, uint32_t work_size,
+		       struct can_filter_bank *banks, uint32_t max_banks)
+{
+	struct can_filter_out out = {
+		.banks = banks,
+	};
+	uint32_t convert[4];
+	uint32_t n = 0;
+	uint32_t i;
+
+	for (i = 0; i < nrules; i++) {
+		if (!can_filter_split(&rules[i], work, &n, work_size)) {
+			return -1;
+		}
+	}
+
+	while (can_filter_count(work, n, convert) > max_banks) {
+		if (!can_filter_merge(work, &n, work_size)) {
+			return -1;
+		}
+	}
+
+	for (i = 0; i < 4; i++) {
+		can_filter_emit(&out, work, n, i & 2, i & 1, convert[i]);
+	}
+	return out.nbanks;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Program Filter Banks
+
+Writes a set of banks from @ref can_filter_compile in one filter
+initialisation cycle, with one update of each of the mode, scale and FIFO
+assignment registers. Banks outside first ... first + nbanks - 1 are left
+as they are.
+
+@param[in] first Unsigned int32. Number of the first bank to use.
+@param[in] banks Bank settings.
+@param[in] nbanks Unsigned int32. Number of banks.
+ */
+void can_filter_program(uint32_t first, const struct can_filter_bank *banks,
+			uint32_t nbanks)
+{
+	uint32_t select = 0, scale = 0, list = 0, fifo1 = 0;
+	uint32_t i;
+
+	for (i = 0; i < nbanks; i++) {
+		uint32_t bit = 1 << (first + i);
+
+		select |= bit;
+		if (banks[i].scale_32bit) {
+			scale |= bit;
+		}
+		if (banks[i].id_list_mode) {
+			list |= bit;
+		}
+		if (banks[i].fifo) {
+			fifo1 |= bit;
+		}
+	}
+
+	CAN_FMR(CAN1) |= CAN_FMR_FINIT;
+	CAN_FA1R(CAN1) &= ~select;
+
+	CAN_FS1R(CAN1) = (CAN_FS1R(CAN1) & ~select) | scale;
+	CAN_FM1R(CAN1) = (CAN_FM1R(CAN1) & ~select) | list;
+	CAN_FFA1R(CAN1) = (CAN_FFA1R(CAN1) & ~select) | fifo1;
+	for (i = 0; i < nbanks; i++) {
+		CAN_FiR1(CAN1, first + i) = banks[i].fr1;
+		CAN_FiR2(CAN1, first + i) = banks[i].fr2;
+	}
+
+	CAN_FA1R(CAN1) |= select;
+	CAN_FMR(CAN1) &= ~CAN_FMR_FINIT;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Check a Data Frame against Filter Banks
+
+Applies the banks the way the filter hardware would, without touching it.
+
+@param[in] banks Bank settings.
+@param[in] nbanks Unsigned int32. Number of banks.
+@param[in] id Unsigned int32. Message ID.
+@param[in] ext bool. Extended message ID?
+@param[out] fifo FIFO of the first matching bank. Use NULL to ignore.
+@returns bool. true if a bank accepts the frame.
+ */
+bool can_filter_match(const struct can_filter_bank *banks, uint32_t nbanks,
+		      uint32_t id, bool ext, uint8_t *fifo)
+{
+	uint32_t w32, w16;
+
+	if (ext) {
+		w32 = (id << CAN_F32_EXID_SHIFT) | CAN_F32_IDE;
+		w16 = ((id >> 18) << CAN_F16_STID_SHIFT) | CAN_F16_IDE |
+		      ((id >> 15) & 0x7);
+	} else {
+		w32 = id << CAN_F32_STID_SHIFT;
+		w16 = id << CAN_F16_STID_SHIFT;
+	}
+
+	for (uint32_t i = 0; i < nbanks; i++) {
+		const struct can_filter_bank *b = &banks[i];
+		bool hit;
+
+		if (b->scale_32bit && b->id_list_mode) {
+			hit = w32 == b->fr1 || w32 == b->fr2;
+		} else if (b->scale_32bit) {
+			hit = ((w32 ^ b->fr1) & b->fr2) == 0;
+		} else if (b->id_list_mode) {
+			hit = w16 == (b->fr1 & 0xFFFF) || w16 == b->fr1 >> 16 ||
+			      w16 == (b->fr2 & 0xFFFF) || w16 == b->fr2 >> 16;
+		} else {
+			hit = ((w16 ^ b->fr1) & (b->fr1 >> 16) & 0xFFFF) == 0 ||
+			      ((w16 ^ b->fr2) & (b->fr2 >> 16) & 0xFFFF) == 0;
+		}
+		if (hit) {
+			if (fifo) {
+				*fifo = b->fifo;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+/**@}*/
@@ -27,7 +27,9 @@ LGPL License Terms @ref lgpl_license
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stddef.h>
 #include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/dma.h>
 
 /**@{*/
 
@@ -121,4 +123,223 @@ void adc_disable_vbat_sensor(void)
 	ADC_CCR &= ~ADC_CCR_VBATE;
 }
 
+static struct adc_stream *adc_stream_active;
+
+/* ADCs taking part in the multi mode, as 1 << (n - 1) */
+static unsigned adc_stream_adcs(const struct adc_stream *stream)
+{
+	if ((stream->multi_mode & ADC_CCR_MULTI_MASK) >=
+	    ADC_CCR_MULTI_TRIPLE_REG_SIMUL_AND_INJECTED_SIMUL) {
+		return 0x7;
+	}
+	return 0x3;
+}
+
+static void adc_stream_dma_stop(struct adc_stream *stream)
+{
+	dma_disable_stream(stream->dma, stream->stream);
+	while (DMA_SCR(stream->dma, stream->stream) & DMA_SxCR_EN);
+	/* Disabling the stream sets the transfer complete flag. */
+	dma_clear_interrupt_flags(stream->dma, stream->stream, DMA_ISR_FLAGS);
+}
+
+static void adc_stream_dma_start(struct adc_stream *stream)
+{
+	dma_set_memory_address(stream->dma, stream->stream,
+			       (uint32_t)stream->buffer);
+	dma_set_number_of_data(stream->dma, stream->stream, stream->transfers);
+	dma_enable_stream(stream->dma, stream->stream);
+}
+
+/* Clearing and setting the common DMA mode rearms the DMA requests after an
+ * overrun or a DMA restart. */
+static void adc_stream_arm(struct adc_stream *stream)
+{
+	unsigned adcs = adc_stream_adcs(stream);
+
+	ADC_CCR &= ~ADC_CCR_DMA_MASK;
+	ADC_SR(ADC1) &= ~ADC_SR_OVR;
+	ADC_SR(ADC2) &= ~ADC_SR_OVR;
+#if defined(ADC3_BASE)
+	if (adcs & 0x4) {
+		ADC_SR(ADC3) &= ~ADC_SR_OVR;
+	}
+#else
+	(void)adcs;
+#endif
+	ADC_CCR |= stream->dma_mode & ADC_CCR_DMA_MASK;
+
+	/* Software triggered: the master starts all converters. */
+	if (!(ADC_CR2(ADC1) & ADC_CR2_EXTEN_MASK)) {
+		ADC_CR2(ADC1) |= ADC_CR2_SWSTART;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Start Multi ADC Streaming
+
+Sets the multi ADC mode, the common DMA mode and the sampling delay, starts the
+DMA stream in circular mode with half and full transfer interrupts, enables
+the overrun interrupt of every ADC taking part and, when ADC1 has no external
+trigger, starts the conversions.
+
+The ADCs must be configured and powered on before, and must not be converting.
+
+@param[in] stream Stream setup
+@returns false if the setup is invalid.
+*/
+bool adc_stream_start(struct adc_stream *stream)
+{
+	uint32_t dma = stream->dma;
+	uint8_t s = stream->stream;
+	unsigned adcs = adc_stream_adcs(stream);
+	bool words = (stream->dma_mode & ADC_CCR_DMA_MASK) ==
+		     ADC_CCR_DMA_MODE_2;
+
+	if ((stream->multi_mode & ADC_CCR_MULTI_MASK) ==
+	    ADC_CCR_MULTI_INDEPENDENT ||
+	    (stream->dma_mode & ADC_CCR_DMA_MASK) == ADC_CCR_DMA_DISABLE ||
+	    stream->transfers < 2 || stream->transfers > 0xfffe ||
+	    (stream->transfers & 1)) {
+		return false;
+	}
+#if !defined(ADC3_BASE)
+	if (adcs & 0x4) {
+		return false;
+	}
+#endif
+	adc_stream_active = stream;
+
+	dma_stream_reset(dma, s);
+	dma_channel_select(dma, s, stream->channel);
+	dma_set_transfer_mode(dma, s, DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	dma_set_peripheral_size(dma, s, words ? DMA_SxCR_PSIZE_32BIT :
+						DMA_SxCR_PSIZE_16BIT);
+	dma_set_memory_size(dma, s, words ? DMA_SxCR_MSIZE_32BIT :
+					    DMA_SxCR_MSIZE_16BIT);
+	dma_enable_memory_increment_mode(dma, s);
+	dma_enable_circular_mode(dma, s);
+	dma_set_priority(dma, s, DMA_SxCR_PL_VERY_HIGH);
+	/* The FIFO absorbs bus latency at full rate. */
+	dma_enable_fifo_mode(dma, s);
+	dma_set_fifo_threshold(dma, s, DMA_SxFCR_FTH_2_4_FULL);
+	dma_set_peripheral_address(dma, s, (uint32_t)&ADC_CDR);
+	dma_enable_half_transfer_interrupt(dma, s);
+	dma_enable_transfer_complete_interrupt(dma, s);
+	dma_enable_transfer_error_interrupt(dma, s);
+	adc_stream_dma_start(stream);
+
+	ADC_CCR = (ADC_CCR & ~(ADC_CCR_MULTI_MASK | ADC_CCR_DMA_MASK |
+			       ADC_CCR_DELAY_MASK)) |
+		  (stream->multi_mode & ADC_CCR_MULTI_MASK) |
+		  (stream->delay & ADC_CCR_DELAY_MASK) | ADC_CCR_DDS;
+
+	ADC_CR1(ADC1) |= ADC_CR1_OVRIE;
+	ADC_CR1(ADC2) |= ADC_CR1_OVRIE;
+#if defined(ADC3_BASE)
+	if (adcs & 0x4) {
+		ADC_CR1(ADC3) |= ADC_CR1_OVRIE;
+	}
+#endif
+	adc_stream_arm(stream);
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Stop Multi ADC Streaming
+
+The ADCs are left powered on and in multi ADC mode; conversions in continuous
+mode carry on without being transferred.
+
+@param[in] stream Stream setup
+*/
+void adc_stream_stop(struct adc_stream *stream)
+{
+	ADC_CCR &= ~(ADC_CCR_DMA_MASK | ADC_CCR_DDS);
+	ADC_CR1(ADC1) &= ~ADC_CR1_OVRIE;
+	ADC_CR1(ADC2) &= ~ADC_CR1_OVRIE;
+#if defined(ADC3_BASE)
+	ADC_CR1(ADC3) &= ~ADC_CR1_OVRIE;
+#endif
+	adc_stream_dma_stop(stream);
+	adc_stream_active = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Stream DMA Interrupt Handler
+*/
+void adc_stream_dma_isr(void)
+{
+	struct adc_stream *stream = adc_stream_active;
+	uint32_t half;
+	bool ht, tc;
+
+	if (!stream) {
+		return;
+	}
+	if (dma_get_interrupt_flag(stream->dma, stream->stream, DMA_TEIF)) {
+		/* The stream has been disabled by the hardware. */
+		adc_stream_dma_stop(stream);
+		stream->errors++;
+		if (stream->event) {
+			stream->event(stream, ADC_STREAM_DMA_ERROR);
+		}
+		adc_stream_dma_start(stream);
+		adc_stream_arm(stream);
+		return;
+	}
+
+	ht = dma_get_interrupt_flag(stream->dma, stream->stream, DMA_HTIF);
+	tc = dma_get_interrupt_flag(stream->dma, stream->stream, DMA_TCIF);
+	dma_clear_interrupt_flags(stream->dma, stream->stream,
+				  (ht ? DMA_HTIF : 0) | (tc ? DMA_TCIF : 0));
+	if (ht && tc) {
+		stream->late++;
+		if (stream->event) {
+			stream->event(stream, ADC_STREAM_LATE);
+		}
+	}
+
+	half = stream->transfers / 2;
+	if (ht) {
+		stream->blocks++;
+		if (stream->half) {
+			stream->half(stream, stream->buffer, half);
+		}
+	}
+	if (tc) {
+		uint32_t size = ((stream->dma_mode & ADC_CCR_DMA_MASK) ==
+				 ADC_CCR_DMA_MODE_2) ? 4 : 2;
+
+		stream->blocks++;
+		if (stream->half) {
+			stream->half(stream,
+				     (uint8_t *)stream->buffer + half * size,
+				     half);
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Stream Overrun Interrupt Handler
+
+Restarts the stream after an overrun. The buffer is refilled from its start.
+*/
+void adc_stream_adc_isr(void)
+{
+	struct adc_stream *stream = adc_stream_active;
+
+	if (!stream || !(ADC_CSR & (ADC_CSR_OVR1 | ADC_CSR_OVR2 |
+				    ADC_CSR_OVR3))) {
+		return;
+	}
+	adc_stream_dma_stop(stream);
+	stream->overruns++;
+	if (stream->event) {
+		stream->event(stream, ADC_STREAM_OVERRUN);
+	}
+	adc_stream_dma_start(stream);
+	adc_stream_arm(stream);
+}
+
 /**@}*/
\ No newline at end of file
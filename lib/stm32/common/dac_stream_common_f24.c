@@ -0,0 +1,201 @@
+/** @addtogroup dac_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/stm32/dac.h>
+#include <libopencm3/stm32/dma.h>
+
+/* Data holding register and transfer size (0: byte, 1: halfword, 2: word)
+ * for the stream's channel(s) and alignment. */
+static uint32_t dac_stream_target(const struct dac_stream *stream,
+				  unsigned *size)
+{
+	uint32_t dac = stream->dac;
+
+	switch (stream->channel) {
+	case DAC_CHANNEL1:
+		*size = stream->align == DAC_ALIGN_RIGHT8 ? 0 : 1;
+		switch (stream->align) {
+		case DAC_ALIGN_RIGHT8:
+			return (uint32_t)&DAC_DHR8R1(dac);
+		case DAC_ALIGN_LEFT12:
+			return (uint32_t)&DAC_DHR12L1(dac);
+		default:
+			return (uint32_t)&DAC_DHR12R1(dac);
+		}
+	case DAC_CHANNEL2:
+		*size = stream->align == DAC_ALIGN_RIGHT8 ? 0 : 1;
+		switch (stream->align) {
+		case DAC_ALIGN_RIGHT8:
+			return (uint32_t)&DAC_DHR8R2(dac);
+		case DAC_ALIGN_LEFT12:
+			return (uint32_t)&DAC_DHR12L2(dac);
+		default:
+			return (uint32_t)&DAC_DHR12R2(dac);
+		}
+	default:
+		*size = stream->align == DAC_ALIGN_RIGHT8 ? 1 : 2;
+		switch (stream->align) {
+		case DAC_ALIGN_RIGHT8:
+			return (uint32_t)&DAC_DHR8RD(dac);
+		case DAC_ALIGN_LEFT12:
+			return (uint32_t)&DAC_DHR12LD(dac);
+		default:
+			return (uint32_t)&DAC_DHR12RD(dac);
+		}
+	}
+}
+
+/* The channel whose DMA request paces the stream. */
+static int dac_stream_request_channel(const struct dac_stream *stream)
+{
+	return stream->channel == DAC_CHANNEL2 ? DAC_CHANNEL2 : DAC_CHANNEL1;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DAC Start streaming Samples
+ *
+ * Sets up the trigger, the DMA stream and the DAC DMA request, and enables the
+ * channel(s). The first sample is output at the first trigger after the timer
+ * has been started. The DAC and DMA controller clocks must be enabled.
+ *
+ * @param[in] stream Stream description, must stay valid until stopped
+ */
+void dac_stream_start(struct dac_stream *stream)
+{
+	uint32_t dma = stream->dma;
+	uint8_t s = stream->stream;
+	int request = dac_stream_request_channel(stream);
+	unsigned size;
+	uint32_t target = dac_stream_target(stream, &size);
+	static const uint32_t psize[] = {
+		DMA_SxCR_PSIZE_8BIT, DMA_SxCR_PSIZE_16BIT, DMA_SxCR_PSIZE_32BIT
+	};
+	static const uint32_t msize[] = {
+		DMA_SxCR_MSIZE_8BIT, DMA_SxCR_MSIZE_16BIT, DMA_SxCR_MSIZE_32BIT
+	};
+
+	dac_dma_disable(stream->dac, DAC_CHANNEL_BOTH);
+	dma_stream_reset(dma, s);
+	dma_channel_select(dma, s, stream->dma_channel);
+	dma_set_transfer_mode(dma, s, DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
+	dma_set_peripheral_size(dma, s, psize[size]);
+	dma_set_memory_size(dma, s, msize[size]);
+	dma_enable_memory_increment_mode(dma, s);
+	dma_set_priority(dma, s, DMA_SxCR_PL_HIGH);
+	dma_set_peripheral_address(dma, s, target);
+	dma_set_memory_address(dma, s, (uint32_t)stream->buffers[0]);
+	dma_set_number_of_data(dma, s, stream->samples);
+	if (stream->buffers[1]) {
+		dma_set_memory_address_1(dma, s, (uint32_t)stream->buffers[1]);
+		dma_enable_double_buffer_mode(dma, s);
+	} else {
+		dma_enable_circular_mode(dma, s);
+		dma_enable_half_transfer_interrupt(dma, s);
+	}
+	dma_enable_transfer_complete_interrupt(dma, s);
+	dma_enable_transfer_error_interrupt(dma, s);
+	dma_enable_stream(dma, s);
+
+	dac_set_trigger_source(stream->dac, stream->trigger);
+	dac_trigger_enable(stream->dac, stream->channel);
+	DAC_SR(stream->dac) = DAC_SR_DMAUDR1 | DAC_SR_DMAUDR2;
+	DAC_CR(stream->dac) |= request == DAC_CHANNEL1 ? DAC_CR_DMAUDRIE1 :
+							 DAC_CR_DMAUDRIE2;
+	dac_dma_enable(stream->dac, request);
+	dac_enable(stream->dac, stream->channel);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DAC Stop streaming Samples
+ *
+ * The channels stay enabled and hold the last sample.
+ *
+ * @param[in] stream Stream description
+ */
+void dac_stream_stop(struct dac_stream *stream)
+{
+	dac_dma_disable(stream->dac, DAC_CHANNEL_BOTH);
+	DAC_CR(stream->dac) &= ~(DAC_CR_DMAUDRIE1 | DAC_CR_DMAUDRIE2);
+	dma_disable_stream(stream->dma, stream->stream);
+	while (DMA_SCR(stream->dma, stream->stream) & DMA_SxCR_EN);
+	dma_clear_interrupt_flags(stream->dma, stream->stream, DMA_ISR_FLAGS);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DAC DMA Stream Interrupt Handler for Streaming
+ *
+ * @param[in] stream Stream description
+ */
+void dac_stream_isr(struct dac_stream *stream)
+{
+	uint32_t dma = stream->dma;
+	uint8_t s = stream->stream;
+
+	if (dma_get_interrupt_flag(dma, s, DMA_TEIF)) {
+		/* The stream has been disabled by the hardware. */
+		dma_clear_interrupt_flags(dma, s, DMA_TEIF);
+		dac_dma_disable(stream->dac, DAC_CHANNEL_BOTH);
+	}
+	if (dma_get_interrupt_flag(dma, s, DMA_HTIF)) {
+		dma_clear_interrupt_flags(dma, s, DMA_HTIF);
+		if (stream->refill) {
+			stream->refill(stream, 0);
+		}
+	}
+	if (dma_get_interrupt_flag(dma, s, DMA_TCIF)) {
+		unsigned part = 1;
+
+		dma_clear_interrupt_flags(dma, s, DMA_TCIF);
+		if (stream->buffers[1]) {
+			/* The stream already moved on to the other buffer. */
+			part = dma_get_target(dma, s) ^ 1;
+		}
+		if (stream->refill) {
+			stream->refill(stream, part);
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DAC Underrun Interrupt Handler for Streaming
+ *
+ * A trigger that arrives before the DMA delivered the previous sample stops
+ * the DAC requests. The stream is restarted from the start of its buffer(s).
+ *
+ * @param[in] stream Stream description
+ */
+void dac_stream_underrun_isr(struct dac_stream *stream)
+{
+	uint32_t flags = DAC_SR(stream->dac) & (DAC_SR_DMAUDR1 | DAC_SR_DMAUDR2);
+
+	if (!flags) {
+		return;
+	}
+	DAC_SR(stream->dac) = flags;
+	stream->underruns++;
+	dac_stream_stop(stream);
+	dac_stream_start(stream);
+}
+
+/**@}*/
@@ -13,6 +13,275 @@
 
 /**@{*/
 
+#include <stddef.h>
 #include <libopencm3/stm32/dcmi.h>
+#include <libopencm3/stm32/dma.h>
+
+/* Bits of DCMI_CR set by dcmi_set_config() */
+#define DCMI_CR_CONFIG	(DCMI_CR_EDM1 | DCMI_CR_EDM0 | DCMI_CR_FCRC1 | \
+			 DCMI_CR_FCRC0 | DCMI_CR_VSPOL | DCMI_CR_HSPOL | \
+			 DCMI_CR_PCKPOL | DCMI_CR_ESS)
+
+#define DCMI_IER_ALL	(DCMI_IER_LINE | DCMI_IER_VSYNC | DCMI_IER_ERR | \
+			 DCMI_IER_OVR | DCMI_IER_FRAME)
+
+static struct dcmi_capture *dcmi_cap;
+
+/*---------------------------------------------------------------------------*/
+/** @brief DCMI Set the Interface Configuration
+ *
+ * @param[in] flags Bitwise OR of DCMI_CR_EDMx (data width), DCMI_CR_FCRCx
+ * (frame rate), DCMI_CR_VSPOL, DCMI_CR_HSPOL, DCMI_CR_PCKPOL and DCMI_CR_ESS
+ * (embedded synchronisation)
+ */
+void dcmi_set_config(uint32_t flags)
+{
+	DCMI_CR = (DCMI_CR & ~DCMI_CR_CONFIG) | (flags & DCMI_CR_CONFIG);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DCMI Set the Crop Window
+ *
+ * @param[in] x Pixel clocks to skip at the start of each line
+ * @param[in] y Lines to skip at the start of each frame
+ * @param[in] count Pixel clocks to capture per line
+ * @param[in] lines Lines to capture
+ */
+void dcmi_set_crop_window(uint16_t x, uint16_t y, uint16_t count,
+			  uint16_t lines)
+{
+	DCMI_CWSTRT = ((uint32_t)(y & DCMI_CWSTRT_VST_MASK) <<
+		       DCMI_CWSTRT_VST_SHIFT) |
+		      ((x & DCMI_CWSTRT_HOFFCNT_MASK) <<
+		       DCMI_CWSTRT_HOFFCNT_SHIFT);
+	DCMI_CWSIZE = ((uint32_t)((lines - 1) & DCMI_CWSIZE_VLINE_MASK) <<
+		       DCMI_CWSIZE_VLINE_SHIFT) |
+		      (((count - 1) & DCMI_CWSIZE_CAPCNT_MASK) <<
+		       DCMI_CWSIZE_CAPCNT_SHIFT);
+}
+
+void dcmi_enable_crop(void)
+{
+	DCMI_CR |= DCMI_CR_CROP;
+}
+
+void dcmi_disable_crop(void)
+{
+	DCMI_CR &= ~DCMI_CR_CROP;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DCMI Enable JPEG Mode
+ *
+ * Frames have a variable length and no line structure; HSYNC acts as a data
+ * valid signal.
+ */
+void dcmi_enable_jpeg(void)
+{
+	DCMI_CR |= DCMI_CR_JPEG;
+}
+
+void dcmi_disable_jpeg(void)
+{
+	DCMI_CR &= ~DCMI_CR_JPEG;
+}
+
+void dcmi_enable(void)
+{
+	DCMI_CR |= DCMI_CR_EN;
+}
+
+void dcmi_disable(void)
+{
+	DCMI_CR &= ~DCMI_CR_EN;
+}
+
+void dcmi_enable_interrupts(uint32_t interrupts)
+{
+	DCMI_IER |= interrupts;
+}
+
+void dcmi_disable_interrupts(uint32_t interrupts)
+{
+	DCMI_IER &= ~interrupts;
+}
+
+uint32_t dcmi_get_interrupt_flags(void)
+{
+	return DCMI_RIS;
+}
+
+void dcmi_clear_interrupt_flags(uint32_t flags)
+{
+	DCMI_ICR = flags;
+}
+
+/*---------------------------------------------------------------------------*/
+static void dcmi_dma_stop(struct dcmi_capture *cap)
+{
+	dma_disable_stream(cap->dma, cap->stream);
+	while (DMA_SCR(cap->dma, cap->stream) & DMA_SxCR_EN);
+	/* Disabling the stream sets the transfer complete flag. */
+	dma_clear_interrupt_flags(cap->dma, cap->stream, DMA_ISR_FLAGS);
+}
+
+static void dcmi_frame_done(struct dcmi_capture *cap, uint8_t target,
+			    uint32_t len)
+{
+	cap->frames++;
+	if (!cap->continuous) {
+		dcmi_capture_stop(cap);
+	}
+	if (cap->frame) {
+		cap->frame(cap, cap->buffers[target], len);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DCMI Start Capturing
+ *
+ * The interface must be configured (@ref dcmi_set_config, crop window, JPEG
+ * mode) and the DMA controller clock enabled. Capture starts with the next
+ * frame.
+ *
+ * @param[in] cap Capture setup, must stay valid until stopped
+ * @param[in] continuous Capture every frame rather than a single one
+ * @returns false if continuous capture was asked for with one buffer
+ */
+bool dcmi_capture_start(struct dcmi_capture *cap, bool continuous)
+{
+	uint32_t dma = cap->dma;
+	uint8_t stream = cap->stream;
+
+	if (continuous && !cap->buffers[1]) {
+		return false;
+	}
+	cap->continuous = continuous;
+	cap->jpeg = DCMI_CR & DCMI_CR_JPEG;
+	dcmi_cap = cap;
+
+	dma_stream_reset(dma, stream);
+	dma_channel_select(dma, stream, cap->channel);
+	dma_set_transfer_mode(dma, stream, DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	dma_set_peripheral_size(dma, stream, DMA_SxCR_PSIZE_32BIT);
+	dma_set_memory_size(dma, stream, DMA_SxCR_MSIZE_32BIT);
+	dma_enable_memory_increment_mode(dma, stream);
+	dma_set_priority(dma, stream, DMA_SxCR_PL_HIGH);
+	dma_enable_fifo_mode(dma, stream);
+	dma_set_fifo_threshold(dma, stream, DMA_SxFCR_FTH_4_4_FULL);
+	dma_set_peripheral_address(dma, stream, (uint32_t)&DCMI_DR);
+	dma_set_memory_address(dma, stream, (uint32_t)cap->buffers[0]);
+	dma_set_number_of_data(dma, stream, cap->words);
+	if (continuous) {
+		dma_set_memory_address_1(dma, stream,
+					 (uint32_t)cap->buffers[1]);
+		dma_enable_double_buffer_mode(dma, stream);
+	}
+	dma_enable_transfer_complete_interrupt(dma, stream);
+	dma_enable_transfer_error_interrupt(dma, stream);
+	dma_enable_stream(dma, stream);
+
+	DCMI_ICR = DCMI_IER_ALL;
+	DCMI_IER = DCMI_IER_ERR | DCMI_IER_OVR |
+		   (cap->jpeg ? DCMI_IER_FRAME : 0) |
+		   (cap->events & (DCMI_IER_LINE | DCMI_IER_VSYNC));
+	if (continuous) {
+		DCMI_CR &= ~DCMI_CR_CM;
+	} else {
+		DCMI_CR |= DCMI_CR_CM;
+	}
+	DCMI_CR |= DCMI_CR_EN;
+	DCMI_CR |= DCMI_CR_CAPTURE;
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DCMI Stop Capturing
+ *
+ * @param[in] cap Capture setup
+ */
+void dcmi_capture_stop(struct dcmi_capture *cap)
+{
+	DCMI_CR &= ~DCMI_CR_CAPTURE;
+	DCMI_IER = 0;
+	dcmi_dma_stop(cap);
+	dma_disable_double_buffer_mode(cap->dma, cap->stream);
+	dcmi_cap = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DCMI Interrupt Handler for Captures
+ */
+void dcmi_capture_isr(void)
+{
+	struct dcmi_capture *cap = dcmi_cap;
+	uint32_t flags = DCMI_MIS;
+
+	DCMI_ICR = flags;
+	if (!cap) {
+		return;
+	}
+
+	if (flags & (DCMI_MIS_ERR | DCMI_MIS_OVR)) {
+		cap->errors++;
+	}
+	if (cap->event && (flags & ~DCMI_MIS_FRAME)) {
+		cap->event(cap, flags & ~DCMI_MIS_FRAME);
+	}
+
+	if ((flags & DCMI_MIS_FRAME) && cap->jpeg) {
+		uint8_t target = cap->continuous ?
+				 dma_get_target(cap->dma, cap->stream) : 0;
+		uint32_t len;
+
+		/* Restart the stream at the start of the other buffer. */
+		dcmi_dma_stop(cap);
+		len = (uint32_t)(cap->words -
+				 dma_get_number_of_data(cap->dma, cap->stream)) * 4;
+		if (cap->continuous) {
+			dma_set_number_of_data(cap->dma, cap->stream,
+					       cap->words);
+			dma_set_initial_target(cap->dma, cap->stream,
+					       target ^ 1);
+			dma_enable_stream(cap->dma, cap->stream);
+		}
+		dcmi_frame_done(cap, target, len);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DCMI DMA Stream Interrupt Handler for Captures
+ */
+void dcmi_capture_dma_isr(void)
+{
+	struct dcmi_capture *cap = dcmi_cap;
+
+	if (!cap) {
+		return;
+	}
+	if (dma_get_interrupt_flag(cap->dma, cap->stream, DMA_TEIF)) {
+		dma_clear_interrupt_flags(cap->dma, cap->stream, DMA_TEIF);
+		cap->errors++;
+		if (cap->event) {
+			cap->event(cap, DCMI_RIS_OVR);
+		}
+	}
+	if (dma_get_interrupt_flag(cap->dma, cap->stream, DMA_TCIF)) {
+		dma_clear_interrupt_flags(cap->dma, cap->stream, DMA_TCIF);
+		if (cap->jpeg) {
+			/* The frame did not fit in the buffer. */
+			cap->errors++;
+			if (cap->event) {
+				cap->event(cap, DCMI_RIS_OVR);
+			}
+		} else {
+			/* In double buffer mode the stream already moved on. */
+			uint8_t target = cap->continuous ?
+				dma_get_target(cap->dma, cap->stream) ^ 1 : 0;
+
+			dcmi_frame_done(cap, target, (uint32_t)cap->words * 4);
+		}
+	}
+}
 
 /**@}*/
\ No newline at end of file
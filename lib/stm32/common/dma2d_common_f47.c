@@ -26,8 +26,285 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/common/dma2d_common_f47.h>
 
 /**@{*/
 
+#define DMA2D_ISR_ERRORS	(DMA2D_ISR_CEIF | DMA2D_ISR_CAEIF | DMA2D_ISR_TEIF)
+
+static struct dma2d_op *dma2d_head;
+static struct dma2d_op *dma2d_tail;
+
+static uint32_t dma2d_pfccr(const struct dma2d_layer *layer)
+{
+	uint32_t reg = ((uint32_t)layer->alpha << DMA2D_xPFCCR_ALPHA_SHIFT) |
+		((uint32_t)(layer->alpha_mode & DMA2D_xPFCCR_AM_MASK) <<
+		 DMA2D_xPFCCR_AM_SHIFT) |
+		(layer->format & DMA2D_xPFCCR_CM_MASK);
+
+	if (layer->clut) {
+		reg |= ((uint32_t)(layer->clut_size - 1) << DMA2D_xPFCCR_CS_SHIFT);
+		if (layer->clut_rgb888) {
+			reg |= DMA2D_xPFCCR_CCM_RGB888;
+		}
+	}
+	return reg;
+}
+
+/* Program one input layer. A CLUT is loaded by the DMA2D itself; wait for
+ * that (at most 256 words) before the main transfer can be set up. */
+static void dma2d_setup_layer(const struct dma2d_layer *layer,
+			      volatile uint32_t *mar, volatile uint32_t *lor,
+			      volatile uint32_t *pfccr, volatile uint32_t *colr,
+			      volatile uint32_t *cmar)
+{
+	*mar = layer->addr;
+	*lor = layer->offset & DMA2D_FGOR_LO_MASK;
+	*colr = layer->color;
+	*pfccr = dma2d_pfccr(layer);
+	if (layer->clut) {
+		*cmar = (uint32_t)layer->clut;
+		*pfccr |= DMA2D_xPFCCR_START;
+		while (*pfccr & DMA2D_xPFCCR_START);
+		DMA2D_IFCR = DMA2D_IFCR_CCTCIF;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Set up an Operation
+ *
+ * Programs all registers for op, loading CLUTs if given, without starting
+ * the transfer. The DMA2D must be idle.
+ *
+ * @param[in] op Operation to set up
+ */
+void dma2d_setup(const struct dma2d_op *op)
+{
+	DMA2D_CR = (DMA2D_CR & ~(DMA2D_CR_MODE_MASK << DMA2D_CR_MODE_SHIFT)) |
+		   ((uint32_t)op->mode << DMA2D_CR_MODE_SHIFT);
+
+	if (op->mode != DMA2D_CR_MODE_R2M) {
+		dma2d_setup_layer(&op->fg, &DMA2D_FGMAR, &DMA2D_FGOR,
+				  &DMA2D_FGPFCCR, &DMA2D_FGCOLR, &DMA2D_FGCMAR);
+	}
+	if (op->mode == DMA2D_CR_MODE_M2MWB) {
+		dma2d_setup_layer(&op->bg, &DMA2D_BGMAR, &DMA2D_BGOR,
+				  &DMA2D_BGPFCCR, &DMA2D_BGCOLR, &DMA2D_BGCMAR);
+	}
+
+	DMA2D_OPFCCR = op->out_format & DMA2D_OPFCCR_CM_MASK;
+	DMA2D_OCOLR = op->color;
+	DMA2D_OMAR = op->out;
+	DMA2D_OOR = op->out_offset & DMA2D_OOR_LO_MASK;
+	DMA2D_NLR = ((uint32_t)(op->width & DMA2D_NLR_PL_MASK) <<
+		     DMA2D_NLR_PL_SHIFT) | op->height;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Start the Transfer set up by @ref dma2d_setup
+ */
+void dma2d_start(void)
+{
+	DMA2D_IFCR = DMA2D_IFCR_CTCIF | DMA2D_IFCR_CTEIF | DMA2D_IFCR_CCEIF |
+		     DMA2D_IFCR_CCAEIF;
+	DMA2D_CR |= DMA2D_CR_START;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Check whether a Transfer is running
+ */
+bool dma2d_busy(void)
+{
+	return DMA2D_CR & DMA2D_CR_START;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Wait for the running Transfer
+ *
+ * @returns true if the transfer completed without error
+ */
+bool dma2d_wait(void)
+{
+	while (dma2d_busy());
+	return !(DMA2D_ISR & DMA2D_ISR_ERRORS);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Abort the running Transfer
+ */
+void dma2d_abort(void)
+{
+	DMA2D_CR |= DMA2D_CR_ABORT;
+	while (DMA2D_CR & DMA2D_CR_START);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Run an Operation and wait for it
+ *
+ * @param[in] op Operation
+ * @returns true if the transfer completed without error
+ */
+bool dma2d_run(const struct dma2d_op *op)
+{
+	while (dma2d_busy());
+	dma2d_setup(op);
+	dma2d_start();
+	return dma2d_wait();
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Fill a Rectangle with a Color
+ *
+ * @param[in] out Address of the top left pixel
+ * @param[in] out_offset Pixels between the end of a line and the next one
+ * @param[in] out_format DMA2D_OPFCCR_CM_*
+ * @param[in] width Rectangle width in pixels
+ * @param[in] height Rectangle height in lines
+ * @param[in] color Color, in the output format
+ */
+void dma2d_fill(uint32_t out, uint16_t out_offset, uint8_t out_format,
+		uint16_t width, uint16_t height, uint32_t color)
+{
+	struct dma2d_op op = {
+		.mode = DMA2D_CR_MODE_R2M,
+		.out = out, .out_offset = out_offset, .out_format = out_format,
+		.color = color, .width = width, .height = height,
+	};
+	dma2d_run(&op);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Copy a Rectangle, converting the Pixel Format if needed
+ *
+ * @param[in] src Source layer
+ * @param[in] out Address of the top left destination pixel
+ * @param[in] out_offset Pixels between the end of a line and the next one
+ * @param[in] out_format DMA2D_OPFCCR_CM_*
+ * @param[in] width Rectangle width in pixels
+ * @param[in] height Rectangle height in lines
+ */
+void dma2d_copy(const struct dma2d_layer *src, uint32_t out,
+		uint16_t out_offset, uint8_t out_format,
+		uint16_t width, uint16_t height)
+{
+	struct dma2d_op op = {
+		.fg = *src,
+		.out = out, .out_offset = out_offset, .out_format = out_format,
+		.width = width, .height = height,
+	};
+
+	/* Plain copies are only valid without conversion or alpha change. */
+	op.mode = (src->format == out_format && !src->alpha_mode) ?
+		  DMA2D_CR_MODE_M2M : DMA2D_CR_MODE_M2MWPFC;
+	dma2d_run(&op);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Blend a Foreground over a Background
+ *
+ * @param[in] fg Foreground layer
+ * @param[in] bg Background layer, may be the same memory as the output
+ * @param[in] out Address of the top left destination pixel
+ * @param[in] out_offset Pixels between the end of a line and the next one
+ * @param[in] out_format DMA2D_OPFCCR_CM_*
+ * @param[in] width Rectangle width in pixels
+ * @param[in] height Rectangle height in lines
+ */
+void dma2d_blend(const struct dma2d_layer *fg, const struct dma2d_layer *bg,
+		 uint32_t out, uint16_t out_offset, uint8_t out_format,
+		 uint16_t width, uint16_t height)
+{
+	struct dma2d_op op = {
+		.mode = DMA2D_CR_MODE_M2MWB,
+		.fg = *fg, .bg = *bg,
+		.out = out, .out_offset = out_offset, .out_format = out_format,
+		.width = width, .height = height,
+	};
+	dma2d_run(&op);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Queued operations. Each one is started from the transfer complete
+ * interrupt of the previous, so a frame's worth of blits runs without the
+ * CPU. Called with interrupts masked. */
+static void dma2d_queue_start(void)
+{
+	if (!dma2d_head) {
+		DMA2D_CR &= ~(DMA2D_CR_TCIE | DMA2D_CR_TEIE | DMA2D_CR_CEIE |
+			      DMA2D_CR_CAEIE);
+		return;
+	}
+	dma2d_setup(dma2d_head);
+	DMA2D_CR |= DMA2D_CR_TCIE | DMA2D_CR_TEIE | DMA2D_CR_CEIE |
+		    DMA2D_CR_CAEIE;
+	dma2d_start();
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Queue an Operation
+ *
+ * The operation is started as soon as the ones queued before it have
+ * completed; its callback is then called from
+ * @ref dma2d_queue_irq_handler. op must stay valid until then. The DMA2D
+ * interrupt must be enabled in the NVIC and the application's dma2d_isr()
+ * must call dma2d_queue_irq_handler().
+ *
+ * @param[in] op Operation
+ */
+void dma2d_submit(struct dma2d_op *op)
+{
+	op->next = NULL;
+	CM_ATOMIC_BLOCK() {
+		if (dma2d_tail) {
+			dma2d_tail->next = op;
+			dma2d_tail = op;
+		} else {
+			dma2d_head = op;
+			dma2d_tail = op;
+			dma2d_queue_start();
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Check whether queued Operations remain
+ */
+bool dma2d_queue_empty(void)
+{
+	return dma2d_head == NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Interrupt Handler for queued Operations
+ *
+ * Call this from the application's dma2d_isr().
+ */
+void dma2d_queue_irq_handler(void)
+{
+	uint32_t isr = DMA2D_ISR;
+	struct dma2d_op *op;
+
+	if (!(isr & (DMA2D_ISR_TCIF | DMA2D_ISR_ERRORS))) {
+		return;
+	}
+	DMA2D_IFCR = DMA2D_IFCR_CTCIF | DMA2D_IFCR_CTEIF | DMA2D_IFCR_CCEIF |
+		     DMA2D_IFCR_CCAEIF;
+
+	CM_ATOMIC_BLOCK() {
+		op = dma2d_head;
+		if (op) {
+			dma2d_head = op->next;
+			if (!dma2d_head) {
+				dma2d_tail = NULL;
+			}
+			dma2d_queue_start();
+		}
+	}
+	if (op && op->callback) {
+		op->callback(op, isr & DMA2D_ISR_ERRORS);
+	}
+}
+
 /**@}*/
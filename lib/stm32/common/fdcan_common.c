@@ -20,6 +20,7 @@
 #include <libopencm3/stm32/fdcan.h>
 #include <libopencm3/stm32/rcc.h>
 #include <stddef.h>
+#include <string.h>
 
 
 /* --- FD-CAN internal functions -------------------------------------------- */
@@ -75,8 +76,9 @@ int fdcan_cccr_init_cfg(uint32_t canport, bool set, uint32_t timeout)
 
 /** Return ID of next free Tx buffer.
  *
- * Examines transmit buffer allocation in message RAM
- * and returns ID of buffer, which is free.
+ * Returns the Tx FIFO/queue put index, which names the element the next frame
+ * has to be written to, in FIFO as well as in queue mode and whatever the size
+ * of the Tx FIFO/queue is.
  *
  * @param [in] canport FDCAN block base address. See @ref fdcan_block.
  * @returns Non-negative number ID of Tx buffer which is free,
@@ -84,15 +86,104 @@ int fdcan_cccr_init_cfg(uint32_t canport, bool set, uint32_t timeout)
  */
 static int fdcan_get_free_txbuf(uint32_t canport)
 {
-	if ((FDCAN_TXBRP(canport) & FDCAN_TXBRP_TRP0) == 0) {
-		return 0;
-	} else if ((FDCAN_TXBRP(canport) & FDCAN_TXBRP_TRP1) == 0) {
-		return 1;
-	} else if ((FDCAN_TXBRP(canport) & FDCAN_TXBRP_TRP2) == 0) {
-		return 2;
+	uint32_t txfqs = FDCAN_TXFQS(canport);
+
+	if (txfqs & FDCAN_TXFQS_TFQF) {
+		return FDCAN_E_BUSY;
+	}
+
+	return (txfqs >> FDCAN_TXFQS_TFQPI_SHIFT) & FDCAN_TXFQS_TFQPI_MASK;
+}
+
+/** Copy frame payload into message RAM.
+ *
+ * Message RAM must be written in 32bit quantities. The source buffer may be
+ * unaligned and only length bytes of it are read.
+ *
+ * @param [out] dst Payload area of Tx buffer element
+ * @param [in] src Payload data
+ * @param [in] length Payload length in bytes
+ */
+static void fdcan_copy_to_ram(uint32_t *dst, const uint8_t *src, unsigned length)
+{
+	uint32_t word;
+	unsigned q;
+
+	for (q = 0; q + 4 <= length; q += 4) {
+		memcpy(&word, &src[q], 4);
+		dst[q / 4] = word;
+	}
+
+	if (q < length) {
+		word = 0;
+		memcpy(&word, &src[q], length - q);
+		dst[q / 4] = word;
+	}
+}
+
+/** Copy frame payload out of message RAM.
+ *
+ * Counterpart of @ref fdcan_copy_to_ram. Exactly length bytes are written
+ * to a possibly unaligned destination buffer.
+ *
+ * @param [out] dst Buffer for payload data
+ * @param [in] src Payload area of Rx FIFO element
+ * @param [in] length Payload length in bytes
+ */
+static void fdcan_copy_from_ram(uint8_t *dst, const uint32_t *src, unsigned length)
+{
+	uint32_t word;
+	unsigned q;
+
+	for (q = 0; q + 4 <= length; q += 4) {
+		word = src[q / 4];
+		memcpy(&dst[q], &word, 4);
+	}
+
+	if (q < length) {
+		word = src[q / 4];
+		memcpy(&dst[q], &word, length - q);
+	}
+}
+
+/** Write header of Tx buffer element.
+ *
+ * @param [out] tx_buffer Tx buffer element in message RAM
+ * @param [in] id Message ID
+ * @param [in] ext Extended message ID
+ * @param [in] rtr Request transmit
+ * @param [in] fdcan_fmt Use FDCAN format
+ * @param [in] btr_switch Switch bitrate for data portion of frame
+ * @param [in] dlc DLC value, as returned by @ref fdcan_length_to_dlc
+ */
+static void fdcan_set_txbuf_header(struct fdcan_tx_buffer_element *tx_buffer,
+		uint32_t id, bool ext, bool rtr, bool fdcan_fmt, bool btr_switch,
+		uint32_t dlc)
+{
+	uint32_t identifier_flags, flags = 0;
+
+	if (ext) {
+		identifier_flags = FDCAN_FIFO_XTD
+			| ((id & FDCAN_FIFO_EID_MASK) << FDCAN_FIFO_EID_SHIFT);
+	} else {
+		identifier_flags =
+			(id & FDCAN_FIFO_SID_MASK) << FDCAN_FIFO_SID_SHIFT;
+	}
+
+	if (rtr) {
+		identifier_flags |= FDCAN_FIFO_RTR;
+	}
+
+	if (fdcan_fmt) {
+		flags |= FDCAN_FIFO_FDF;
 	}
 
-	return FDCAN_E_BUSY;
+	if (btr_switch) {
+		flags |= FDCAN_FIFO_BRS;
+	}
+
+	tx_buffer->identifier_flags = identifier_flags;
+	tx_buffer->evt_fmt_dlc_res = (dlc << FDCAN_FIFO_DLC_SHIFT) | flags;
 }
 
 /** Returns fill state and next available get index from receive FIFO.
@@ -471,6 +562,10 @@ void fdcan_set_ext_filter(uint32_t canport, uint32_t nr,
 }
 
 /** Transmit Message using FDCAN
+ *
+ * The frame is written to the element named by the Tx FIFO/queue put index,
+ * so all elements of the Tx FIFO/queue are used, in FIFO as well as in queue
+ * mode.
  *
  * @param [in] canport CAN block register base. See @ref fdcan_block.
  * @param [in] id Message ID
@@ -480,14 +575,23 @@ void fdcan_set_ext_filter(uint32_t canport, uint32_t nr,
  * @param [in] btr_switch Switch bitrate for data portion of frame
  * @param [in] length Message payload length. Must be valid CAN or FDCAN frame length
  * @param [in] data Message payload data
- * @returns int 0, 1 or 2 on success and depending on which outgoing mailbox got
- * selected. Otherwise returns error code. For error codes, see @ref fdcan_error.
+ * @returns int Index of the Tx buffer element used on success. Otherwise returns
+ * error code. For error codes, see @ref fdcan_error.
  */
 int fdcan_transmit(uint32_t canport, uint32_t id, bool ext, bool rtr,
 			bool fdcan_fmt, bool btr_switch, uint8_t length, const uint8_t *data)
 {
 	int mailbox;
-	uint32_t dlc, flags = 0;
+	uint32_t dlc;
+
+	/* Early check: if FDCAN message lentgh is > 8, it must be
+	 * a multiple of 4 *and* fdcan format must be enabled.
+	 */
+	dlc = fdcan_length_to_dlc(length);
+
+	if (dlc == 0xFF) {
+		return FDCAN_E_INVALID;
+	}
 
 	mailbox = fdcan_get_free_txbuf(canport);
 
@@ -497,45 +601,101 @@ int fdcan_transmit(uint32_t canport, uint32_t id, bool ext, bool rtr,
 
 	struct fdcan_tx_buffer_element *tx_buffer = fdcan_get_txbuf_addr(canport, mailbox);
 
-	/* Early check: if FDCAN message lentgh is > 8, it must be
-	 * a multiple of 4 *and* fdcan format must be enabled.
-	 */
-	dlc = fdcan_length_to_dlc(length);
+	fdcan_set_txbuf_header(tx_buffer, id, ext, rtr, fdcan_fmt, btr_switch, dlc);
+	fdcan_copy_to_ram(tx_buffer->data, data, length);
 
-	if (dlc == 0xFF) {
-		return FDCAN_E_INVALID;
-	}
+	/* TXBAR bits are set only, writing zeros has no effect. */
+	FDCAN_TXBAR(canport) = 1 << mailbox;
 
-	if (ext) {
-		tx_buffer->identifier_flags = FDCAN_FIFO_XTD
-			| ((id & FDCAN_FIFO_EID_MASK) << FDCAN_FIFO_EID_SHIFT);
+	return mailbox;
+}
+
+/** Transmit several messages using FDCAN
+ *
+ * Fills as many free Tx FIFO/queue elements as there are frames, then
+ * requests transmission of all of them with a single TXBAR write. The free
+ * state is read from the hardware only once. In FIFO mode elements are
+ * filled starting at the put index, in queue mode any element without
+ * pending request is used.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] frames Frames to send
+ * @param [in] count Number of frames
+ * @returns Number of frames queued, which is less than count if the Tx
+ * FIFO/queue filled up, or FDCAN_E_INVALID if the first frame not queued
+ * has an invalid length, or one longer than the Tx element payload size, and
+ * no frame was queued. Queueing stops at such a frame.
+ */
+int fdcan_transmit_batch(uint32_t canport, const struct fdcan_frame *frames,
+		unsigned count)
+{
+	unsigned start = fdcan_get_txfifo_start(canport);
+	unsigned size = fdcan_get_txfifo_size(canport);
+	bool queue_mode = (FDCAN_TXBC(canport) & FDCAN_TXBC_TFQM) != 0;
+	/* Payload an element holds, after its two header words. */
+	unsigned max_length = fdcan_get_txbuf_element_size(canport) - 8;
+	uint32_t txfqs = FDCAN_TXFQS(canport);
+	uint32_t free = 0, request = 0;
+	unsigned index, free_level = 0, sent = 0;
+	bool invalid = false;
+
+	index = (txfqs >> FDCAN_TXFQS_TFQPI_SHIFT) & FDCAN_TXFQS_TFQPI_MASK;
+
+	if (queue_mode) {
+		free = (size >= 32 ? 0xFFFFFFFF : (1u << size) - 1) << start;
+		free &= ~FDCAN_TXBRP(canport);
 	} else {
-		tx_buffer->identifier_flags =
-			(id & FDCAN_FIFO_SID_MASK) << FDCAN_FIFO_SID_SHIFT;
+		free_level = (txfqs >> FDCAN_TXFQS_TFFL_SHIFT) & FDCAN_TXFQS_TFFL_MASK;
 	}
 
-	if (rtr) {
-		tx_buffer->identifier_flags |= FDCAN_FIFO_RTR;
-	}
+	while (sent < count) {
+		const struct fdcan_frame *frame = &frames[sent];
+		uint32_t dlc = fdcan_length_to_dlc(frame->length);
 
-	if (fdcan_fmt) {
-		flags |= FDCAN_FIFO_FDF;
-	}
+		if (dlc == 0xFF || frame->length > max_length) {
+			invalid = true;
+			break;
+		}
 
-	if (btr_switch) {
-		flags |= FDCAN_FIFO_BRS;
-	}
+		if (queue_mode) {
+			if (!free) {
+				break;
+			}
+			index = __builtin_ctz(free);
+			free &= free - 1;
+		} else if (free_level == 0) {
+			break;
+		}
+
+		struct fdcan_tx_buffer_element *tx_buffer =
+			fdcan_get_txbuf_addr(canport, index);
+
+		fdcan_set_txbuf_header(tx_buffer, frame->id, frame->ext, frame->rtr,
+				frame->fdf, frame->brs, dlc);
+		for (unsigned q = 0; q < (frame->length + 3u) / 4; q++) {
+			tx_buffer->data[q] = frame->data.data32[q];
+		}
 
-	tx_buffer->evt_fmt_dlc_res =
-		(dlc << FDCAN_FIFO_DLC_SHIFT) | flags;
+		request |= 1 << index;
+		sent++;
 
-	for (int q = 0; q < length; q += 4) {
-		tx_buffer->data[q / 4] = *((uint32_t *) &data[q]);
+		if (!queue_mode) {
+			free_level--;
+			if (++index == start + size) {
+				index = start;
+			}
+		}
 	}
 
-	FDCAN_TXBAR(canport) |= 1 << mailbox;
+	if (request) {
+		FDCAN_TXBAR(canport) = request;
+	}
 
-	return mailbox;
+	if (sent == 0 && invalid) {
+		return FDCAN_E_INVALID;
+	}
+
+	return sent;
 }
 
 /** Receive Message from FDCAN FIFO
@@ -604,9 +764,7 @@ int fdcan_receive(uint32_t canport, uint8_t fifo_id, bool release, uint32_t *id,
 		*rtr = ((fifo->identifier_flags & FDCAN_FIFO_RTR) == FDCAN_FIFO_RTR);
 	}
 
-	for (unsigned int q = 0; q < len; q += 4) {
-		*((uint32_t *) &data[q]) = fifo->data[q / 4];
-	}
+	fdcan_copy_from_ram(data, fifo->data, len);
 
 	if (release) {
 		FDCAN_RXFIA(canport, fifo_id) = get_index << FDCAN_RXFIFO_AI_SHIFT;
@@ -615,6 +773,77 @@ int fdcan_receive(uint32_t canport, uint8_t fifo_id, bool release, uint32_t *id,
 	return FDCAN_E_OK;
 }
 
+/** Receive several messages from FDCAN FIFO
+ *
+ * Copies up to count frames out of the receive FIFO, then releases all of
+ * them with a single acknowledge. FIFO state is read from the hardware only
+ * once.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block
+ * @param [in] fifo_id FIFO id.
+ * @param [out] frames Buffer for received frames
+ * @param [in] count Number of frames the buffer can hold
+ * @returns Number of frames received, 0 if FIFO was empty. Frame lengths are
+ * truncated to the data field size of the FIFO elements.
+ */
+int fdcan_receive_batch(uint32_t canport, uint8_t fifo_id,
+		struct fdcan_frame *frames, unsigned count)
+{
+	unsigned pending_frames, get_index, last_index = 0, n;
+	unsigned size = fdcan_get_fifo_size(canport, fifo_id);
+	unsigned element_size = fdcan_get_fifo_element_size(canport, fifo_id);
+	uintptr_t base = (uintptr_t) fdcan_get_rxfifo_addr(canport, fifo_id, 0);
+
+	fdcan_get_fill_rxfifo(canport, fifo_id, &get_index, &pending_frames);
+
+	for (n = 0; n < count && n < pending_frames; n++) {
+		const struct fdcan_rx_fifo_element *fifo =
+			(const struct fdcan_rx_fifo_element *)
+			(base + get_index * element_size);
+		struct fdcan_frame *frame = &frames[n];
+		uint32_t identifier_flags = fifo->identifier_flags;
+		uint32_t filt_fmt_dlc_ts = fifo->filt_fmt_dlc_ts;
+
+		frame->ext = (identifier_flags & FDCAN_FIFO_XTD) != 0;
+		if (frame->ext) {
+			frame->id = (identifier_flags >> FDCAN_FIFO_EID_SHIFT)
+				& FDCAN_FIFO_EID_MASK;
+		} else {
+			frame->id = (identifier_flags >> FDCAN_FIFO_SID_SHIFT)
+				& FDCAN_FIFO_SID_MASK;
+		}
+		frame->rtr = (identifier_flags & FDCAN_FIFO_RTR) != 0;
+		frame->fdf = (filt_fmt_dlc_ts & FDCAN_FIFO_FDF) != 0;
+		frame->brs = (filt_fmt_dlc_ts & FDCAN_FIFO_BRS) != 0;
+		frame->length = fdcan_dlc_to_length((filt_fmt_dlc_ts >> FDCAN_FIFO_DLC_SHIFT)
+				& FDCAN_FIFO_DLC_MASK);
+		frame->fmi = (filt_fmt_dlc_ts >> FDCAN_FIFO_MM_SHIFT) & FDCAN_FIFO_MM_MASK;
+		frame->timestamp = (filt_fmt_dlc_ts >> FDCAN_FIFO_RXTS_SHIFT)
+			& FDCAN_FIFO_RXTS_MASK;
+
+		/* Elements configured smaller than the frame keep only the
+		 * start of its payload. */
+		if (frame->length > element_size - 8) {
+			frame->length = element_size - 8;
+		}
+		for (unsigned q = 0; q < (frame->length + 3u) / 4; q++) {
+			frame->data.data32[q] = fifo->data[q];
+		}
+
+		last_index = get_index;
+		if (++get_index == size) {
+			get_index = 0;
+		}
+	}
+
+	if (n) {
+		/* Acknowledging an element releases all older ones too. */
+		FDCAN_RXFIA(canport, fifo_id) = last_index << FDCAN_RXFIFO_AI_SHIFT;
+	}
+
+	return n;
+}
+
 /** Release receive oldest FIFO entry.
  *
  * This function will mask oldest entry in FIFO as released making
@@ -0,0 +1,40 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This is a "private" header file for the asynchronous flash job queue.
+ * The queue logic is shared; the family specific code provides:
+ *  _flash_async_lane()  which queue (bank controller) a job runs on,
+ *  _flash_async_step()  start the next hardware operation of a job, with the
+ *                       end of operation and error interrupts enabled,
+ *                       returning nonzero error flags if it could not,
+ *  _flash_async_idle()  put the controller back to rest once a queue drains,
+ * and calls _flash_async_complete() from flash_async_isr() when an operation
+ * finishes.
+ */
+
+#ifndef FLASH_ASYNC_PRIVATE_H
+#define FLASH_ASYNC_PRIVATE_H
+
+#include <libopencm3/stm32/flash.h>
+
+unsigned _flash_async_lane(const struct flash_job *job);
+uint32_t _flash_async_step(unsigned lane, struct flash_job *job);
+void _flash_async_idle(unsigned lane);
+void _flash_async_complete(unsigned lane, uint32_t errors);
+
+#endif
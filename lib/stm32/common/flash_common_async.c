@@ -0,0 +1,137 @@
+/** @addtogroup flash_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/flash.h>
+#include "flash_async_private.h"
+
+static struct {
+	struct flash_job *head;
+	struct flash_job *tail;
+	/* Set while flash_async_run() walks the queue, so that a job submitted
+	 * from a completion callback is only queued, not started twice. */
+	bool running;
+} flash_queue[FLASH_ASYNC_LANES];
+
+static uint32_t flash_job_steps(const struct flash_job *job)
+{
+	return job->type == FLASH_JOB_ERASE ? 1 : job->len;
+}
+
+static void flash_job_finish(unsigned lane, uint32_t errors)
+{
+	struct flash_job *job = flash_queue[lane].head;
+
+	flash_queue[lane].head = job->next;
+	if (!job->next) {
+		flash_queue[lane].tail = NULL;
+	}
+	if (job->callback) {
+		job->callback(job, errors);
+	}
+}
+
+/* Advance the queue until an operation is in flight or the queue is empty.
+ * Called with interrupts masked. */
+static void flash_async_run(unsigned lane)
+{
+	struct flash_job *job;
+
+	if (flash_queue[lane].running) {
+		return;
+	}
+	flash_queue[lane].running = true;
+
+	while ((job = flash_queue[lane].head)) {
+		uint32_t errors = 0;
+
+		if (job->done < flash_job_steps(job)) {
+			errors = _flash_async_step(lane, job);
+			if (!errors) {
+				break;
+			}
+		}
+		flash_job_finish(lane, errors);
+	}
+	if (!job) {
+		_flash_async_idle(lane);
+	}
+	flash_queue[lane].running = false;
+}
+
+/** @brief Queue a Flash Job
+ *
+ * The job is started immediately if its queue is idle. The job structure
+ * (and its data) must not be touched until the callback has been called.
+ * @param[in] job Job to queue
+ */
+void flash_async_submit(struct flash_job *job)
+{
+	unsigned lane = _flash_async_lane(job);
+
+	job->done = 0;
+	job->next = NULL;
+
+	CM_ATOMIC_BLOCK() {
+		if (flash_queue[lane].tail) {
+			flash_queue[lane].tail->next = job;
+			flash_queue[lane].tail = job;
+		} else {
+			flash_queue[lane].head = job;
+			flash_queue[lane].tail = job;
+			flash_async_run(lane);
+		}
+	}
+}
+
+/** @brief Check for pending Flash Jobs
+ * @returns true if any job is queued or running.
+ */
+bool flash_async_busy(void)
+{
+	for (unsigned lane = 0; lane < FLASH_ASYNC_LANES; lane++) {
+		if (flash_queue[lane].head) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Called by the family flash_async_isr() when an operation has ended. */
+void _flash_async_complete(unsigned lane, uint32_t errors)
+{
+	CM_ATOMIC_BLOCK() {
+		if (!flash_queue[lane].head) {
+			/* Spurious: nothing was running on this lane. */
+			_flash_async_idle(lane);
+		} else {
+			if (errors) {
+				flash_job_finish(lane, errors);
+			}
+			flash_async_run(lane);
+		}
+	}
+}
+
+/**@}*/
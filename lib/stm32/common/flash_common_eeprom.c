@@ -0,0 +1,430 @@
+/** @addtogroup flash_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <string.h>
+#include <libopencm3/stm32/common/flash_common_eeprom.h>
+
+/*
+ * On flash layout. Every header occupies max(8, align) bytes so that it is
+ * programmed as whole units of its own.
+ *
+ * sector: | magic | seq | records ... | erased |
+ * record: | key (16) | len (16) | crc32 (32) | data, padded to align |
+ *
+ * A sector becomes valid when its header is written, which is the last step
+ * of moving the live records into it. The valid sector with the highest
+ * sequence number is the active one. A record whose CRC does not match ends
+ * the log (a write torn by reset); the rest of that sector is then not used.
+ */
+
+#define FLASH_EEPROM_MAGIC	0x45455031U	/* "EEP1" */
+
+struct flash_eeprom_rec {
+	uint16_t key;
+	uint16_t len;
+	uint32_t crc;
+};
+
+static uint32_t ee_crc32(uint32_t crc, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len--) {
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xedb88320U & -(crc & 1));
+		}
+	}
+	return crc;
+}
+
+static uint32_t ee_hdr_size(const struct flash_eeprom *ee)
+{
+	return ee->align > 8 ? ee->align : 8;
+}
+
+static uint32_t ee_rec_size(const struct flash_eeprom *ee, uint16_t len)
+{
+	len &= ~FLASH_EEPROM_DELETED;
+	return ee_hdr_size(ee) + ((len + ee->align - 1) & ~(ee->align - 1U));
+}
+
+static uintptr_t ee_base(const struct flash_eeprom *ee, uint8_t sector)
+{
+	return ee->sectors[sector].base;
+}
+
+static uintptr_t ee_end(const struct flash_eeprom *ee, uint8_t sector)
+{
+	return ee->sectors[sector].base + ee->sector_size;
+}
+
+static bool ee_erased(uintptr_t addr, uintptr_t end)
+{
+	for (; addr < end; addr += 4) {
+		if (*(const volatile uint32_t *)addr != 0xffffffffU) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool ee_erase(struct flash_eeprom *ee, uint8_t sector)
+{
+	if (!ee->ops->erase(ee->ops->ctx, &ee->sectors[sector],
+			    ee->sector_size)) {
+		return false;
+	}
+	ee->dirty &= ~(1U << sector);
+	return true;
+}
+
+static bool ee_rec_valid(const struct flash_eeprom *ee,
+			 const struct flash_eeprom_rec *rec, uintptr_t addr)
+{
+	uint32_t crc = ee_crc32(0xffffffffU, rec, 4);
+
+	crc = ee_crc32(crc, (const void *)(addr + ee_hdr_size(ee)),
+		       rec->len & ~FLASH_EEPROM_DELETED);
+	return ~crc == rec->crc;
+}
+
+/* Header: seq goes first and the magic last when they are separate units,
+ * so a torn header never looks valid. */
+static bool ee_write_sector_hdr(struct flash_eeprom *ee, uint8_t sector,
+				uint32_t seq)
+{
+	uint8_t unit[FLASH_EEPROM_MAX_ALIGN];
+	uint32_t magic = FLASH_EEPROM_MAGIC;
+	uintptr_t base = ee_base(ee, sector);
+	uint32_t size = ee_hdr_size(ee);
+
+	memset(unit, 0xff, sizeof(unit));
+	memcpy(&unit[4], &seq, 4);
+	if (ee->align <= 4) {
+		if (!ee->ops->program(ee->ops->ctx, base + 4, &unit[4], 4)) {
+			return false;
+		}
+		return ee->ops->program(ee->ops->ctx, base, &magic, 4);
+	}
+	memcpy(unit, &magic, 4);
+	return ee->ops->program(ee->ops->ctx, base, unit, size);
+}
+
+static bool ee_write_rec(struct flash_eeprom *ee, uintptr_t addr,
+			 uint16_t key, uint16_t lenf, const uint8_t *data)
+{
+	uint8_t unit[FLASH_EEPROM_MAX_ALIGN];
+	struct flash_eeprom_rec rec = { .key = key, .len = lenf };
+	uint16_t len = lenf & ~FLASH_EEPROM_DELETED;
+	uint32_t hdr = ee_hdr_size(ee);
+	uint32_t body = len & ~(ee->align - 1U);
+
+	rec.crc = ~ee_crc32(ee_crc32(0xffffffffU, &rec, 4), data, len);
+
+	memset(unit, 0xff, sizeof(unit));
+	memcpy(unit, &rec, sizeof(rec));
+	if (!ee->ops->program(ee->ops->ctx, addr, unit, hdr)) {
+		return false;
+	}
+	addr += hdr;
+	if (body && !ee->ops->program(ee->ops->ctx, addr, data, body)) {
+		return false;
+	}
+	if (len > body) {
+		memset(unit, 0xff, sizeof(unit));
+		memcpy(unit, data + body, len - body);
+		return ee->ops->program(ee->ops->ctx, addr + body, unit,
+					ee->align);
+	}
+	return true;
+}
+
+/* Rebuild the index from the active sector and find the end of the log. */
+static void ee_scan(struct flash_eeprom *ee)
+{
+	uintptr_t addr = ee_base(ee, ee->active) + ee_hdr_size(ee);
+	uintptr_t end = ee_end(ee, ee->active);
+	struct flash_eeprom_rec rec;
+
+	memset(ee->index, 0, ee->nkeys * sizeof(*ee->index));
+
+	while (addr + ee_hdr_size(ee) <= end) {
+		memcpy(&rec, (const void *)addr, sizeof(rec));
+		if (rec.key == FLASH_EEPROM_KEY_NONE && rec.len == 0xffff) {
+			break;
+		}
+		if (addr + ee_rec_size(ee, rec.len) > end ||
+		    !ee_rec_valid(ee, &rec, addr)) {
+			break;
+		}
+		/* Keys beyond our index belong to a larger configuration. */
+		if (rec.key < ee->nkeys) {
+			ee->index[rec.key] =
+				(rec.len & FLASH_EEPROM_DELETED) ? 0 : addr;
+		}
+		addr += ee_rec_size(ee, rec.len);
+	}
+
+	/* Anything but erased flash after the log is a torn write: do not
+	 * append there, the next write will move to a fresh sector. */
+	ee->write_ptr = ee_erased(addr, end) ? addr : end;
+}
+
+/* Move the live records to the next sector, leaving room for need bytes. */
+static bool ee_compact(struct flash_eeprom *ee, uint32_t need)
+{
+	uint8_t target = (ee->active + 1) % ee->nsectors;
+	uintptr_t wp = ee_base(ee, target) + ee_hdr_size(ee);
+	uint32_t total = need;
+	struct flash_eeprom_rec rec;
+
+	for (uint16_t key = 0; key < ee->nkeys; key++) {
+		if (ee->index[key]) {
+			memcpy(&rec, (const void *)ee->index[key], sizeof(rec));
+			total += ee_rec_size(ee, rec.len);
+		}
+	}
+	if (wp + total > ee_end(ee, target)) {
+		return false;
+	}
+
+	if ((ee->dirty & (1U << target)) && !ee_erase(ee, target)) {
+		return false;
+	}
+
+	for (uint16_t key = 0; key < ee->nkeys; key++) {
+		uint32_t size;
+
+		if (!ee->index[key]) {
+			continue;
+		}
+		memcpy(&rec, (const void *)ee->index[key], sizeof(rec));
+		size = ee_rec_size(ee, rec.len);
+		if (!ee->ops->program(ee->ops->ctx, wp,
+				      (const void *)ee->index[key], size)) {
+			goto fail;
+		}
+		ee->index[key] = wp;
+		wp += size;
+	}
+
+	if (!ee_write_sector_hdr(ee, target, ee->seq + 1)) {
+		goto fail;
+	}
+
+	ee->dirty |= 1U << ee->active;
+	ee->active = target;
+	ee->seq++;
+	ee->write_ptr = wp;
+	return true;
+
+fail:
+	/* The old sector is still the valid one; the index may point into the
+	 * target, so rebuild it. */
+	ee->dirty |= 1U << target;
+	ee_scan(ee);
+	return false;
+}
+
+/** @brief Format the EEPROM Store
+ *
+ * Erases all sectors and starts an empty store in the first one.
+ * @param[in] ee Store, with the configuration fields filled in
+ * @returns true on success
+ */
+bool flash_eeprom_format(struct flash_eeprom *ee)
+{
+	ee->dirty = 0;
+	for (uint8_t i = 0; i < ee->nsectors; i++) {
+		if (!ee_erase(ee, i)) {
+			return false;
+		}
+	}
+	ee->active = 0;
+	ee->seq = 1;
+	ee->write_ptr = ee_base(ee, 0) + ee_hdr_size(ee);
+	memset(ee->index, 0, ee->nkeys * sizeof(*ee->index));
+	return ee_write_sector_hdr(ee, 0, ee->seq);
+}
+
+/** @brief Mount the EEPROM Store
+ *
+ * Finds the active sector and builds the RAM index from it. If no valid
+ * sector is found the store is formatted. Sectors that need erasing are
+ * remembered for @ref flash_eeprom_gc.
+ * @param[in] ee Store, with the configuration fields filled in
+ * @returns true on success
+ */
+bool flash_eeprom_mount(struct flash_eeprom *ee)
+{
+	bool found = false;
+
+	if (ee->nsectors < 2 || ee->nsectors > 32 || ee->align < 4 ||
+	    ee->align > FLASH_EEPROM_MAX_ALIGN ||
+	    (ee->align & (ee->align - 1))) {
+		return false;
+	}
+
+	for (uint8_t i = 0; i < ee->nsectors; i++) {
+		uint32_t magic = *(const volatile uint32_t *)ee_base(ee, i);
+		uint32_t seq = *(const volatile uint32_t *)(ee_base(ee, i) + 4);
+
+		if (magic != FLASH_EEPROM_MAGIC) {
+			continue;
+		}
+		if (!found || (int32_t)(seq - ee->seq) > 0) {
+			ee->active = i;
+			ee->seq = seq;
+			found = true;
+		}
+	}
+	if (!found) {
+		return flash_eeprom_format(ee);
+	}
+
+	ee->dirty = 0;
+	for (uint8_t i = 0; i < ee->nsectors; i++) {
+		if (i != ee->active && !ee_erased(ee_base(ee, i), ee_end(ee, i))) {
+			ee->dirty |= 1U << i;
+		}
+	}
+	ee_scan(ee);
+	return true;
+}
+
+/** @brief Read a Value
+ *
+ * @param[in] ee Mounted store
+ * @param[in] key Key to look up
+ * @param[out] buf Destination, up to size bytes are copied
+ * @param[in] size Size of buf
+ * @returns Length of the stored value, or -1 if the key is not set
+ */
+int flash_eeprom_read(struct flash_eeprom *ee, uint16_t key, void *buf,
+		      size_t size)
+{
+	struct flash_eeprom_rec rec;
+
+	if (key >= ee->nkeys || !ee->index[key]) {
+		return -1;
+	}
+	memcpy(&rec, (const void *)ee->index[key], sizeof(rec));
+	memcpy(buf, (const void *)(ee->index[key] + ee_hdr_size(ee)),
+	       rec.len < size ? rec.len : size);
+	return rec.len;
+}
+
+static bool ee_append(struct flash_eeprom *ee, uint16_t key, uint16_t lenf,
+		      const void *data)
+{
+	uint32_t size = ee_rec_size(ee, lenf);
+
+	if (ee->write_ptr + size > ee_end(ee, ee->active) &&
+	    !ee_compact(ee, size)) {
+		return false;
+	}
+	if (!ee_write_rec(ee, ee->write_ptr, key, lenf, data)) {
+		/* Do not append after a failed write. */
+		ee->write_ptr = ee_end(ee, ee->active);
+		return false;
+	}
+	ee->index[key] = (lenf & FLASH_EEPROM_DELETED) ? 0 : ee->write_ptr;
+	ee->write_ptr += size;
+	return true;
+}
+
+/** @brief Write a Value
+ *
+ * Appends a record, moving the store to the next sector first if the active
+ * one is full (which may erase that sector if @ref flash_eeprom_gc has not
+ * done so yet). Writing the value already stored is a no-op.
+ * @param[in] ee Mounted store
+ * @param[in] key Key to set, below nkeys
+ * @param[in] data Value
+ * @param[in] len Length of the value, below 32768
+ * @returns true on success
+ */
+bool flash_eeprom_write(struct flash_eeprom *ee, uint16_t key,
+			const void *data, uint16_t len)
+{
+	if (key >= ee->nkeys || (len & FLASH_EEPROM_DELETED)) {
+		return false;
+	}
+	if (ee->index[key]) {
+		struct flash_eeprom_rec rec;
+
+		memcpy(&rec, (const void *)ee->index[key], sizeof(rec));
+		if (rec.len == len &&
+		    !memcmp((const void *)(ee->index[key] + ee_hdr_size(ee)),
+			    data, len)) {
+			return true;
+		}
+	}
+	return ee_append(ee, key, len, data);
+}
+
+/** @brief Delete a Value
+ * @param[in] ee Mounted store
+ * @param[in] key Key to clear
+ * @returns true on success
+ */
+bool flash_eeprom_delete(struct flash_eeprom *ee, uint16_t key)
+{
+	if (key >= ee->nkeys) {
+		return false;
+	}
+	if (!ee->index[key]) {
+		return true;
+	}
+	return ee_append(ee, key, FLASH_EEPROM_DELETED, NULL);
+}
+
+/** @brief Background Garbage Collection
+ *
+ * Erases one sector no longer in use, so that moving to it later does not
+ * have to. Call this when the application can afford the erase time.
+ * @param[in] ee Mounted store
+ * @returns true if more sectors are waiting to be erased
+ */
+bool flash_eeprom_gc(struct flash_eeprom *ee)
+{
+	uint32_t pending = ee->dirty & ~(1U << ee->active);
+
+	if (!pending) {
+		return false;
+	}
+	ee_erase(ee, __builtin_ctz(pending));
+	return (ee->dirty & ~(1U << ee->active)) != 0;
+}
+
+/** @brief Free Space in the Active Sector
+ * @param[in] ee Mounted store
+ * @returns Bytes left before the next move to a new sector
+ */
+uint32_t flash_eeprom_free(const struct flash_eeprom *ee)
+{
+	return ee_end(ee, ee->active) - ee->write_ptr;
+}
+
+/**@}*/
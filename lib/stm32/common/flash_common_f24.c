@@ -24,7 +24,22 @@
 
 /**@{*/
 
+#include <string.h>
 #include <libopencm3/stm32/flash.h>
+#include "flash_async_private.h"
+
+/* Widest parallelism flash_program() may use, see
+ * flash_set_program_parallelism(). x8 is valid over the whole supply range.
+ */
+static uint32_t flash_psize_max = FLASH_CR_PROGRAM_X8;
+
+#if defined(FLASH_SR_PGSERR)
+#define FLASH_SR_PROGRAM_ERRORS	(FLASH_SR_PGSERR | FLASH_SR_PGPERR | \
+				 FLASH_SR_PGAERR | FLASH_SR_WRPERR)
+#else
+#define FLASH_SR_PROGRAM_ERRORS	(FLASH_SR_PGPERR | FLASH_SR_PGAERR | \
+				 FLASH_SR_WRPERR)
+#endif
 
 /*---------------------------------------------------------------------------*/
 /** @brief Set the Program Parallelism Size
@@ -37,8 +52,54 @@ programming manual for more information.
 
 static inline void flash_set_program_size(uint32_t psize)
 {
-	FLASH_CR &= ~(FLASH_CR_PROGRAM_MASK << FLASH_CR_PROGRAM_SHIFT);
-	FLASH_CR |= psize << FLASH_CR_PROGRAM_SHIFT;
+	uint32_t reg = FLASH_CR;
+
+	/* Leave the register alone when the width is already right. */
+	if (((reg >> FLASH_CR_PROGRAM_SHIFT) & FLASH_CR_PROGRAM_MASK) == psize) {
+		return;
+	}
+	reg &= ~(FLASH_CR_PROGRAM_MASK << FLASH_CR_PROGRAM_SHIFT);
+	FLASH_CR = reg | (psize << FLASH_CR_PROGRAM_SHIFT);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the Parallelism used by flash_program
+
+Selects the widest programming word width @ref flash_program may use. The
+permitted width depends on the supply voltage:
+@li 1.8V - 2.1V: x8
+@li 2.1V - 2.7V: x16
+@li 2.7V - 3.6V: x32
+@li 2.7V - 3.6V with external VPP: x64
+
+The default is x8, which is valid over the whole supply range.
+@param[in] psize The programming word width one of: @ref flash_cr_program_width
+*/
+
+void flash_set_program_parallelism(uint32_t psize)
+{
+	flash_psize_max = psize & FLASH_CR_PROGRAM_MASK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the Parallelism used by flash_program from the Supply Voltage
+
+Convenience wrapper around @ref flash_set_program_parallelism choosing the
+widest width allowed at the given supply voltage.
+@param[in] millivolts Minimum VDD the device is operated at
+@param[in] vpp true if an external programming voltage is applied to VPP
+*/
+
+void flash_set_supply_voltage(uint16_t millivolts, bool vpp)
+{
+	uint32_t psize = FLASH_CR_PROGRAM_X8;
+
+	if (millivolts >= 2700) {
+		psize = vpp ? FLASH_CR_PROGRAM_X64 : FLASH_CR_PROGRAM_X32;
+	} else if (millivolts >= 2100) {
+		psize = FLASH_CR_PROGRAM_X16;
+	}
+	flash_set_program_parallelism(psize);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -197,20 +258,82 @@ This programs an arbitrary length data block to FLASH memory.
 The program error flag should be checked separately for the event that memory
 was not properly erased.
 
+The bulk of the block is written with the parallelism selected by
+@ref flash_set_program_parallelism; bytes before the first and after the last
+suitably aligned word are written one at a time. The PG bit and the
+parallelism are only changed where needed rather than for every write.
+Programming stops at the first error reported in FLASH_SR.
+
 @param[in] address Starting address in Flash.
 @param[in] data Pointer to start of data block.
 @param[in] len Length of data block.
 */
 
+/* Start one program operation at address, using the widest parallelism
+ * allowed for its alignment and the remaining length. PG must be set.
+ * Returns the number of bytes written.
+ */
+static uint32_t flash_program_unit(uint32_t address, const uint8_t *data,
+				   uint32_t len)
+{
+	uint32_t step = 1U << flash_psize_max;
+
+	if ((address & (step - 1)) || len < step) {
+		/* Unaligned head or short tail. */
+		flash_set_program_size(FLASH_CR_PROGRAM_X8);
+		MMIO8(address) = *data;
+		return 1;
+	}
+
+	flash_set_program_size(flash_psize_max);
+	/* The source may be unaligned; let the compiler pick. */
+	switch (flash_psize_max) {
+	case FLASH_CR_PROGRAM_X64: {
+		uint64_t v;
+		memcpy(&v, data, sizeof(v));
+		MMIO64(address) = v;
+		break;
+	}
+	case FLASH_CR_PROGRAM_X32: {
+		uint32_t v;
+		memcpy(&v, data, sizeof(v));
+		MMIO32(address) = v;
+		break;
+	}
+	case FLASH_CR_PROGRAM_X16: {
+		uint16_t v;
+		memcpy(&v, data, sizeof(v));
+		MMIO16(address) = v;
+		break;
+	}
+	default:
+		MMIO8(address) = *data;
+		break;
+	}
+	return step;
+}
+
 void flash_program(uint32_t address, const uint8_t *data, uint32_t len)
 {
-	/* TODO: Use dword and word size program operations where possible for
-	 * turbo speed.
-	 */
-	uint32_t i;
-	for (i = 0; i < len; i++) {
-		flash_program_byte(address+i, data[i]);
+	uint32_t end = address + len;
+
+	flash_wait_for_last_operation();
+	/* Drop stale errors so they do not end this block early. */
+	FLASH_SR = FLASH_SR_PROGRAM_ERRORS;
+	FLASH_CR |= FLASH_CR_PG;
+
+	while (address < end) {
+		uint32_t step = flash_program_unit(address, data, end - address);
+
+		flash_wait_for_last_operation();
+		if (FLASH_SR & FLASH_SR_PROGRAM_ERRORS) {
+			break;
+		}
+		address += step;
+		data += step;
 	}
+
+	FLASH_CR &= ~FLASH_CR_PG;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -226,9 +349,8 @@ See the reference manual or the FLASH programming manual for details.
 @param program_size: 0 (8-bit), 1 (16-bit), 2 (32-bit), 3 (64-bit)
 */
 
-void flash_erase_sector(uint8_t sector, uint32_t program_size)
+static void flash_erase_sector_start(uint8_t sector, uint32_t program_size)
 {
-	flash_wait_for_last_operation();
 	flash_set_program_size(program_size);
 
 	/* Sector numbering is not contiguous internally! */
@@ -240,6 +362,12 @@ void flash_erase_sector(uint8_t sector, uint32_t program_size)
 	FLASH_CR |= (sector & FLASH_CR_SNB_MASK) << FLASH_CR_SNB_SHIFT;
 	FLASH_CR |= FLASH_CR_SER;
 	FLASH_CR |= FLASH_CR_STRT;
+}
+
+void flash_erase_sector(uint8_t sector, uint32_t program_size)
+{
+	flash_wait_for_last_operation();
+	flash_erase_sector_start(sector, program_size);
 
 	flash_wait_for_last_operation();
 	FLASH_CR &= ~FLASH_CR_SER;
@@ -288,4 +416,95 @@ void flash_program_option_bytes(uint32_t data)
 	FLASH_OPTCR |= FLASH_OPTCR_OPTSTRT;  /* Enable option byte prog. */
 	flash_wait_for_last_operation();
 }
+/*---------------------------------------------------------------------------*/
+/* Interrupt driven jobs, see flash_common_async.c. There is one controller,
+ * so a single queue; erases use the parallelism set for flash_program().
+ */
+
+unsigned _flash_async_lane(const struct flash_job *job)
+{
+	(void)job;
+	return 0;
+}
+
+uint32_t _flash_async_step(unsigned lane, struct flash_job *job)
+{
+	uint32_t errors;
+
+	(void)lane;
+	FLASH_SR = FLASH_SR_PROGRAM_ERRORS | FLASH_SR_OPERR | FLASH_SR_EOP;
+	FLASH_CR &= ~(FLASH_CR_SER | FLASH_CR_PG);
+	FLASH_CR |= FLASH_CR_EOPIE | FLASH_CR_ERRIE;
+
+	if (job->type == FLASH_JOB_ERASE) {
+		flash_erase_sector_start(job->sector, flash_psize_max);
+		job->done = 1;
+	} else {
+		FLASH_CR |= FLASH_CR_PG;
+		job->done += flash_program_unit(job->address + job->done,
+						job->data + job->done,
+						job->len - job->done);
+	}
+
+	/* Sequence, alignment and protection errors are flagged right away
+	 * and raise no interrupt, so report them here. */
+	errors = FLASH_SR & FLASH_SR_PROGRAM_ERRORS;
+	FLASH_SR = errors;
+	return errors;
+}
+
+void _flash_async_idle(unsigned lane)
+{
+	(void)lane;
+	FLASH_CR &= ~(FLASH_CR_EOPIE | FLASH_CR_ERRIE | FLASH_CR_PG |
+		      FLASH_CR_SER | (FLASH_CR_SNB_MASK << FLASH_CR_SNB_SHIFT));
+}
+
+/*---------------------------------------------------------------------------*/
+/* EEPROM emulation backend, see flash_common_eeprom.c. The flash must be
+ * unlocked while the store is written; erases use the parallelism set for
+ * flash_program().
+ */
+
+static bool flash_eeprom_erase(void *ctx, const struct flash_eeprom_sector *sector,
+			       uint32_t size)
+{
+	(void)ctx;
+	(void)size;
+	FLASH_SR = FLASH_SR_PROGRAM_ERRORS | FLASH_SR_OPERR;
+	flash_erase_sector(sector->id, flash_psize_max);
+	return !(FLASH_SR & (FLASH_SR_PROGRAM_ERRORS | FLASH_SR_OPERR));
+}
+
+static bool flash_eeprom_program(void *ctx, uintptr_t address,
+				 const void *data, size_t len)
+{
+	(void)ctx;
+	flash_program(address, data, len);
+	return !(FLASH_SR & FLASH_SR_PROGRAM_ERRORS);
+}
+
+/** EEPROM emulation backend using the sectors' hardware numbers as ids */
+const struct flash_eeprom_ops flash_eeprom_ops = {
+	.erase = flash_eeprom_erase,
+	.program = flash_eeprom_program,
+};
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Job Interrupt Handler
+
+Call this from flash_isr() when using @ref flash_async_submit.
+*/
+
+void flash_async_isr(void)
+{
+	uint32_t sr = FLASH_SR;
+	uint32_t errors = sr & (FLASH_SR_PROGRAM_ERRORS | FLASH_SR_OPERR);
+
+	if (!(sr & FLASH_SR_EOP) && !errors) {
+		return;
+	}
+	FLASH_SR = errors | FLASH_SR_EOP;
+	_flash_async_complete(0, errors);
+}
 /**@}*/
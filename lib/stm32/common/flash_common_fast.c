@@ -0,0 +1,127 @@
+/** @addtogroup flash_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/flash.h>
+
+/* Fast programming must not read flash while the row is being written, so
+ * this runs from RAM with interrupts masked and may not call into flash.
+ * Being in RAM, more than 64MB away from flash, it must be a long_call.
+ */
+__attribute__ ((long_call, noinline, section (".ramtext")))
+static void flash_fast_program_row(uint32_t address, const uint32_t *src)
+{
+	volatile uint32_t *dst = (volatile uint32_t *)address;
+	uint32_t primask = cm_mask_interrupts(1);
+
+	FLASH_CR |= FLASH_CR_FSTPG;
+	for (int i = 0; i < FLASH_ROW_SIZE / 4; i++) {
+		*dst++ = *src++;
+	}
+	while ((FLASH_SR & FLASH_SR_BSY) == FLASH_SR_BSY);
+	FLASH_CR &= ~FLASH_CR_FSTPG;
+
+	cm_mask_interrupts(primask);
+}
+
+/* A row can be fast programmed if both ends are suitably aligned, the source
+ * is not itself in flash, and the whole row is still erased.
+ */
+static bool flash_row_programmable(uint32_t address, const void *data)
+{
+	uint32_t src = (uint32_t)data;
+
+	if ((address & (FLASH_ROW_SIZE - 1)) || (src & 3)) {
+		return false;
+	}
+	if (src >= FLASH_BASE && src < FLASH_BASE + 0x08000000U) {
+		return false;
+	}
+	for (uint32_t i = 0; i < FLASH_ROW_SIZE; i += 4) {
+		if (MMIO32(address + i) != 0xffffffff) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/** @brief Program a Row of FLASH in Fast Programming mode
+ *
+ * Writes FLASH_ROW_SIZE bytes (32 double words) in a single fast programming
+ * operation. The destination must be row aligned and erased, and the source
+ * must be word aligned and located in RAM. HCLK must be at least 8MHz.
+ * Interrupts are masked while the row is written.
+ *
+ * @param[in] address Row aligned starting address in Flash.
+ * @param[in] data Pointer to FLASH_ROW_SIZE bytes of data in RAM.
+ * @returns true if the row was programmed without error, false if the row
+ * was not eligible (nothing was written) or an error flag was raised.
+ */
+bool flash_program_row(uint32_t address, const uint32_t *data)
+{
+	if (!flash_row_programmable(address, data)) {
+		return false;
+	}
+
+	flash_wait_for_last_operation();
+	FLASH_SR = FLASH_SR_PROGRAM_ERRORS;
+	flash_fast_program_row(address, data);
+
+	return (FLASH_SR & FLASH_SR_PROGRAM_ERRORS) == 0;
+}
+
+/** @brief Program a Data Block to FLASH
+ * This programs an arbitrary length data block to FLASH memory.
+ *
+ * Whole rows are written with fast programming where possible; any partial
+ * or ineligible row falls back to double word programming. Stale error
+ * flags are cleared first, and programming stops at the first error, with
+ * the FLASH_SR error flags left set for the caller to inspect.
+ * @param[in] address Starting address in Flash.
+ * @param[in] data Pointer to start of data block.
+ * @param[in] len Length of data block in bytes (multiple of 8).
+ */
+void flash_program(uint32_t address, uint8_t *data, uint32_t len)
+{
+	uint32_t i = 0;
+
+	flash_wait_for_last_operation();
+	FLASH_SR = FLASH_SR_PROGRAM_ERRORS;
+
+	while (i < len) {
+		if (len - i >= FLASH_ROW_SIZE &&
+		    flash_row_programmable(address + i, data + i)) {
+			flash_fast_program_row(address + i,
+					       (const uint32_t *)(data + i));
+			i += FLASH_ROW_SIZE;
+		} else {
+			flash_program_double_word(address+i,
+						  *(uint64_t*)(data + i));
+			i += 8;
+		}
+		if (FLASH_SR & FLASH_SR_PROGRAM_ERRORS) {
+			return;
+		}
+	}
+}
+/**@}*/
@@ -28,6 +28,7 @@ STM32F7xx series of ARM Cortex Microcontrollers by ST Microelectronics.
 
 #include <stdint.h>
 #include <libopencm3/stm32/fsmc.h>
+#include <libopencm3/stm32/rcc.h>
 
 /**@{*/
 
@@ -40,7 +41,7 @@ STM32F7xx series of ARM Cortex Microcontrollers by ST Microelectronics.
  * by subtracting 1.
  */
 uint32_t
-sdram_timing(struct sdram_timing *t) {
+sdram_timing(const struct sdram_timing *t) {
 	uint32_t result;
 
 	result = 0;
@@ -108,4 +109,105 @@ sdram_command(enum fmc_sdram_bank bank,
 	FMC_SDCMR = tmp_reg;
 }
 
+/* The FMC kernel clock; on H7 this is HCLK3 unless FMCSEL changed it. */
+static uint32_t sdram_hclk(void)
+{
+#if defined(STM32H7)
+	return rcc_get_bus_clk_freq(RCC_HCLK3);
+#else
+	return rcc_ahb_frequency;
+#endif
+}
+
+/* Busy wait for at least us microseconds; the loop takes more than one
+ * cycle per turn. */
+static void sdram_delay_us(uint32_t us)
+{
+	volatile uint32_t n = (sdram_hclk() / 1000000) * us;
+
+	while (n--);
+}
+
+/*
+ * Refresh timer count for the current HCLK: the refresh period divided by
+ * the number of rows, in SDCLK cycles, less the 20 cycle safety margin the
+ * reference manual asks for.
+ */
+uint32_t
+sdram_refresh_count(const struct sdram_config *cfg) {
+	uint32_t sdclk_khz = sdram_hclk() / cfg->sdclk_div / 1000;
+	uint32_t count = sdclk_khz * cfg->refresh_ms / (1U << cfg->rows);
+
+	return count > 20 ? count - 20 : 0;
+}
+
+/*
+ * Bring up an SDRAM: program the controller from cfg, then run the JEDEC
+ * init sequence (clock enable, 100us wait, precharge all, auto-refresh,
+ * mode register load) and start the refresh timer. The FMC clock and pins
+ * must be set up, and rcc_ahb_frequency must be the final HCLK (on H7 the
+ * FMC kernel clock is taken as HCLK3).
+ *
+ * Returns false if the configuration cannot be programmed.
+ */
+bool
+sdram_init(const struct sdram_config *cfg) {
+	uint32_t sdcr, sdtr, count, mode;
+	int bank = (cfg->bank == SDRAM_BANK2) ? 1 : 0;
+
+	if (cfg->bank == SDRAM_BOTH_BANKS ||
+	    cfg->columns < 8 || cfg->columns > 11 ||
+	    cfg->rows < 11 || cfg->rows > 13 ||
+	    cfg->cas < 1 || cfg->cas > 3 ||
+	    cfg->sdclk_div < 2 || cfg->sdclk_div > 3 ||
+	    cfg->read_pipe > 2 ||
+	    cfg->autorefresh < 1 || cfg->autorefresh > 16) {
+		return false;
+	}
+
+	count = sdram_refresh_count(cfg);
+	/* The count must exceed 41 and fit in 13 bits. */
+	if (count <= 41 || count > 0x1fff) {
+		return false;
+	}
+
+	sdcr = ((uint32_t)(cfg->columns - 8) << FMC_SDCR_NC_SHIFT) |
+	       ((uint32_t)(cfg->rows - 11) << FMC_SDCR_NR_SHIFT) |
+	       (cfg->width == 32 ? FMC_SDCR_MWID_32b :
+		cfg->width == 16 ? FMC_SDCR_MWID_16b : FMC_SDCR_MWID_8b) |
+	       (cfg->banks == 4 ? FMC_SDCR_NB4 : FMC_SDCR_NB2) |
+	       ((uint32_t)cfg->cas << FMC_SDCR_CAS_SHIFT) |
+	       ((uint32_t)cfg->sdclk_div << FMC_SDCR_SDCLK_SHIFT) |
+	       (cfg->read_burst ? FMC_SDCR_RBURST : 0) |
+	       ((uint32_t)cfg->read_pipe << FMC_SDCR_RPIPE_SHIFT);
+	sdtr = sdram_timing(&cfg->timing);
+
+	if (bank) {
+		FMC_SDCR1 = (FMC_SDCR1 & ~FMC_SDCR_DNC_MASK) |
+			    (sdcr & FMC_SDCR_DNC_MASK);
+		FMC_SDTR1 = (FMC_SDTR1 & ~FMC_SDTR_DNC_MASK) |
+			    (sdtr & FMC_SDTR_DNC_MASK);
+		FMC_SDCR2 = sdcr & ~FMC_SDCR_DNC_MASK;
+		FMC_SDTR2 = sdtr & ~FMC_SDTR_DNC_MASK;
+	} else {
+		FMC_SDCR1 = sdcr;
+		FMC_SDTR1 = sdtr;
+	}
+
+	sdram_command(cfg->bank, SDRAM_CLK_CONF, 0, 0);
+	sdram_delay_us(100);
+	sdram_command(cfg->bank, SDRAM_PALL, 0, 0);
+	sdram_command(cfg->bank, SDRAM_AUTO_REFRESH, cfg->autorefresh - 1, 0);
+
+	mode = SDRAM_MODE_BURST_LENGTH_1 | SDRAM_MODE_BURST_TYPE_SEQUENTIAL |
+	       ((uint32_t)cfg->cas << 4) | SDRAM_MODE_OPERATING_MODE_STANDARD |
+	       SDRAM_MODE_WRITEBURST_MODE_SINGLE;
+	sdram_command(cfg->bank, SDRAM_LOAD_MODE, 0, mode);
+
+	while (FMC_SDSR & FMC_SDSR_BUSY);
+	FMC_SDRTR = (FMC_SDRTR & ~FMC_SDRTR_COUNT_MASK) |
+		    (count << FMC_SDRTR_COUNT_SHIFT);
+	return true;
+}
+
 /**@}*/
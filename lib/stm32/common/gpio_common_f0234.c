@@ -71,6 +71,7 @@ Example 2: Digital input on port C12 with pullup
 /**@{*/
 
 #include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
 
 /*---------------------------------------------------------------------------*/
 /** @brief Set GPIO Pin Mode
@@ -202,5 +203,132 @@ void gpio_set_af(uint32_t gpioport, uint8_t alt_func_num, uint16_t gpios)
 	GPIO_AFRL(gpioport) = afrl;
 	GPIO_AFRH(gpioport) = afrh;
 }
+
+/* Ports are 0x400 apart, starting at GPIOA. */
+#define GPIO_PORT_INDEX(port)	(((port) - GPIOA) / 0x400)
+
+/*---------------------------------------------------------------------------*/
+/** @brief Enable the Clocks of all Ports used by a Pin Table
+
+All GPIO clock enable bits are in one RCC register, so this is a single
+read-modify-write however many ports the table uses.
+
+@param[in] pins Pin table
+@param[in] npins Number of entries
+*/
+void gpio_enable_port_clocks(const struct gpio_pin_config *pins,
+			     unsigned int npins)
+{
+	uint32_t mask = 0;
+
+	for (unsigned int i = 0; i < npins; i++) {
+		uint32_t clken = RCC_GPIOA + GPIO_PORT_INDEX(pins[i].port);
+#if defined(STM32F3)
+		/* GPIOH is enabled below GPIOA. */
+		if (pins[i].port == GPIOH) {
+			clken = RCC_GPIOH;
+		}
+#endif
+		mask |= 1 << (clken & 0x1f);
+	}
+	MMIO32(RCC_BASE + (RCC_GPIOA >> 5)) |= mask;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Configure all Pins of a Pin Table
+
+The table is merged per port, so each configuration register of a port is
+read and written once, however many entries refer to it. Pin settings are
+applied as by @ref gpio_set_output_options, @ref gpio_set_af and @ref
+gpio_mode_setup; the mode is written last, so a pin only switches to output
+or alternate function mode with its final options in place. Later entries
+override earlier ones for the same pin.
+
+@param[in] pins Pin table
+@param[in] npins Number of entries
+
+Example:
+@code
+	static const struct gpio_pin_config board_pins[] = {
+		{ GPIOA, GPIO9 | GPIO10, GPIO_MODE_AF, GPIO_PUPD_NONE,
+		  GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_AF7 },
+		{ GPIOD, GPIO12, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
+		  GPIO_OTYPE_PP, GPIO_OSPEED_2MHZ, 0 },
+	};
+
+	gpio_enable_port_clocks(board_pins, 2);
+	gpio_configure_pins(board_pins, 2);
+@endcode
+*/
+void gpio_configure_pins(const struct gpio_pin_config *pins,
+			 unsigned int npins)
+{
+	uint32_t ports = 0;
+
+	for (unsigned int i = 0; i < npins; i++) {
+		ports |= 1 << GPIO_PORT_INDEX(pins[i].port);
+	}
+
+	while (ports) {
+		unsigned int index = __builtin_ctz(ports);
+		uint32_t gpioport = GPIOA + index * 0x400;
+		uint32_t moder_m = 0, moder = 0, pupd_m = 0, pupd = 0;
+		uint32_t ospeed_m = 0, ospeed = 0, afrl_m = 0, afrl = 0;
+		uint32_t afrh_m = 0, afrh = 0;
+		uint16_t otype_m = 0, otype = 0;
+
+		ports &= ~(1 << index);
+
+		for (unsigned int i = 0; i < npins; i++) {
+			const struct gpio_pin_config *p = &pins[i];
+
+			if (p->port != gpioport) {
+				continue;
+			}
+			for (unsigned int n = 0; n < 16; n++) {
+				if (!(p->gpios & (1 << n))) {
+					continue;
+				}
+				moder_m |= GPIO_MODE_MASK(n);
+				moder = (moder & ~GPIO_MODE_MASK(n)) |
+					GPIO_MODE(n, p->mode);
+				pupd_m |= GPIO_PUPD_MASK(n);
+				pupd = (pupd & ~GPIO_PUPD_MASK(n)) |
+				       GPIO_PUPD(n, p->pull_up_down);
+				ospeed_m |= GPIO_OSPEED_MASK(n);
+				ospeed = (ospeed & ~GPIO_OSPEED_MASK(n)) |
+					 GPIO_OSPEED(n, p->speed);
+				otype_m |= 1 << n;
+				otype = (otype & ~(1 << n)) |
+					((p->otype & 1) << n);
+				if (n < 8) {
+					afrl_m |= GPIO_AFR_MASK(n);
+					afrl = (afrl & ~GPIO_AFR_MASK(n)) |
+					       GPIO_AFR(n, p->af);
+				} else {
+					afrh_m |= GPIO_AFR_MASK(n - 8);
+					afrh = (afrh & ~GPIO_AFR_MASK(n - 8)) |
+					       GPIO_AFR(n - 8, p->af);
+				}
+			}
+		}
+
+		GPIO_OTYPER(gpioport) = (GPIO_OTYPER(gpioport) & ~otype_m) |
+					otype;
+		GPIO_OSPEEDR(gpioport) = (GPIO_OSPEEDR(gpioport) & ~ospeed_m) |
+					 ospeed;
+		if (afrl_m) {
+			GPIO_AFRL(gpioport) = (GPIO_AFRL(gpioport) & ~afrl_m) |
+					      afrl;
+		}
+		if (afrh_m) {
+			GPIO_AFRH(gpioport) = (GPIO_AFRH(gpioport) & ~afrh_m) |
+					      afrh;
+		}
+		GPIO_PUPDR(gpioport) = (GPIO_PUPDR(gpioport) & ~pupd_m) | pupd;
+		GPIO_MODER(gpioport) = (GPIO_MODER(gpioport) & ~moder_m) |
+				       moder;
+	}
+}
 /**@}*/
 
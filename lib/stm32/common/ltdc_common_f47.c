@@ -36,8 +36,13 @@
 
 /**@{*/
 
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/common/ltdc_common_f47.h>
 
+/* Framebuffer managers, indexed by layer number - 1. */
+static struct ltdc_fb *ltdc_fbs[2];
+
 void ltdc_set_tft_sync_timings(uint16_t sync_width,    uint16_t sync_height,
 			       uint16_t h_back_porch,  uint16_t v_back_porch,
 			       uint16_t active_width,  uint16_t active_height,
@@ -88,5 +93,190 @@ void ltdc_setup_windowing(uint8_t layer_number, uint16_t h_back_porch,
 		(v_back_porch + v_sync) << LTDC_LxWVPCR_WVSTPOS_SHIFT;
 }
 
-/**@}*/
+/*---------------------------------------------------------------------------*/
+/* The pending buffer has been loaded into the active registers: account for
+ * the swap. Called with interrupts masked. */
+static void ltdc_fb_retire(struct ltdc_fb *fb)
+{
+	uint32_t frame = fb->stats.refreshes - fb->last_swap;
+
+	if (frame > 0xffff) {
+		frame = 0xffff;
+	}
+	fb->front = fb->pending;
+	fb->pending = LTDC_FB_NONE;
+	fb->last_swap = fb->stats.refreshes;
+	fb->stats.swaps++;
+	fb->stats.frame_last = frame;
+	if (frame < fb->stats.frame_min) {
+		fb->stats.frame_min = frame;
+	}
+	if (frame > fb->stats.frame_max) {
+		fb->stats.frame_max = frame;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Set up a buffered Framebuffer for a Layer
+ *
+ * The layer must be configured (size, pixel format, line length) already.
+ * buffers[0] is shown immediately; the line interrupt is moved to the first
+ * line of vertical blanking, where it counts refresh periods.
+ *
+ * @param[out] fb Framebuffer manager, must stay valid
+ * @param[in] layer @ref ltdc_layer_num
+ * @param[in] buffers Framebuffer addresses
+ * @param[in] nbuffers Number of buffers, 2 ... LTDC_FB_MAX_BUFFERS
+ * @returns false if layer is not LTDC_LAYER_1 or LTDC_LAYER_2 or there are
+ * no buffers; nothing is set up then.
+ */
+bool ltdc_fb_init(struct ltdc_fb *fb, uint8_t layer,
+		  const uint32_t *buffers, uint8_t nbuffers)
+{
+	if (layer != LTDC_LAYER_1 && layer != LTDC_LAYER_2) {
+		return false;
+	}
+	if (nbuffers == 0) {
+		return false;
+	}
+	if (nbuffers > LTDC_FB_MAX_BUFFERS) {
+		nbuffers = LTDC_FB_MAX_BUFFERS;
+	}
+	fb->layer = layer;
+	fb->nbuffers = nbuffers;
+	for (uint8_t i = 0; i < nbuffers; i++) {
+		fb->buffers[i] = buffers[i];
+	}
+	fb->front = 0;
+	fb->pending = LTDC_FB_NONE;
+	fb->back = nbuffers > 1 ? 1 : LTDC_FB_NONE;
+	ltdc_fb_reset_stats(fb);
+
+	CM_ATOMIC_BLOCK() {
+		ltdc_fbs[layer - 1] = fb;
+		LTDC_LxCFBAR(layer) = buffers[0];
+		LTDC_SRCR = LTDC_SRCR_IMR;
+		while (LTDC_SRCR & LTDC_SRCR_IMR);
 
+		/* AAH is the last active line, counting from 0. */
+		LTDC_LIPCR = ((LTDC_AWCR >> LTDC_AWCR_AAH_SHIFT) &
+			      LTDC_AWCR_AAH_MASK) + 1;
+		LTDC_ICR = LTDC_ICR_CLIF | LTDC_ICR_CRRIF;
+		LTDC_IER |= LTDC_IER_LIE | LTDC_IER_RRIE;
+	}
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Get the Back Buffer
+ *
+ * The returned buffer is neither displayed nor waiting to be, and stays the
+ * back buffer until presented.
+ *
+ * @param[in] fb Framebuffer manager
+ * @returns Buffer address, or 0 if all buffers are in use (double buffering
+ * with a swap pending); wait with @ref ltdc_fb_wait_vsync then.
+ */
+uint32_t ltdc_fb_back(struct ltdc_fb *fb)
+{
+	CM_ATOMIC_BLOCK() {
+		for (uint8_t i = 0; fb->back == LTDC_FB_NONE &&
+		     i < fb->nbuffers; i++) {
+			if (i != fb->front && i != fb->pending) {
+				fb->back = i;
+			}
+		}
+	}
+	return fb->back == LTDC_FB_NONE ? 0 : fb->buffers[fb->back];
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Present the Back Buffer
+ *
+ * The back buffer is shown from the next refresh on. A buffer presented
+ * earlier but not shown yet is dropped in favour of this one and becomes
+ * free again.
+ *
+ * @param[in] fb Framebuffer manager
+ * @returns false if there was no back buffer
+ */
+bool ltdc_fb_present(struct ltdc_fb *fb)
+{
+	bool ok = false;
+
+	CM_ATOMIC_BLOCK() {
+		if (fb->back != LTDC_FB_NONE &&
+		    fb->pending != LTDC_FB_NONE) {
+			if (LTDC_SRCR & LTDC_SRCR_VBR) {
+				fb->stats.dropped++;
+			} else {
+				/* Reloaded already, interrupt still pending. */
+				ltdc_fb_retire(fb);
+			}
+		}
+		if (fb->back != LTDC_FB_NONE) {
+			fb->pending = fb->back;
+			fb->back = LTDC_FB_NONE;
+			LTDC_LxCFBAR(fb->layer) = fb->buffers[fb->pending];
+			LTDC_SRCR = LTDC_SRCR_VBR;
+			ok = true;
+		}
+	}
+	return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Wait until the presented Buffer is displayed
+ *
+ * @param[in] fb Framebuffer manager
+ */
+void ltdc_fb_wait_vsync(struct ltdc_fb *fb)
+{
+	while (fb->pending != LTDC_FB_NONE);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Reset the Frame Statistics
+ *
+ * @param[in] fb Framebuffer manager
+ */
+void ltdc_fb_reset_stats(struct ltdc_fb *fb)
+{
+	CM_ATOMIC_BLOCK() {
+		fb->stats.refreshes = 0;
+		fb->stats.swaps = 0;
+		fb->stats.dropped = 0;
+		fb->stats.frame_last = 0;
+		fb->stats.frame_min = 0xffff;
+		fb->stats.frame_max = 0;
+		fb->last_swap = 0;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Interrupt Handler for buffered Framebuffers
+ */
+void ltdc_fb_isr(void)
+{
+	uint32_t isr = LTDC_ISR;
+
+	if (isr & LTDC_ISR_LIF) {
+		LTDC_ICR = LTDC_ICR_CLIF;
+		for (unsigned i = 0; i < 2; i++) {
+			if (ltdc_fbs[i]) {
+				ltdc_fbs[i]->stats.refreshes++;
+			}
+		}
+	}
+	if (isr & LTDC_ISR_RRIF) {
+		LTDC_ICR = LTDC_ICR_CRRIF;
+		for (unsigned i = 0; i < 2; i++) {
+			if (ltdc_fbs[i] &&
+			    ltdc_fbs[i]->pending != LTDC_FB_NONE) {
+				ltdc_fb_retire(ltdc_fbs[i]);
+			}
+		}
+	}
+}
+
+/**@}*/
@@ -1,3 +1,12 @@
+/** @addtogroup quadspi_file
+ * @copyright SPDX: LGPL-3.0-or-later
+ *
+ * Commands are described by a @ref quadspi_command and can be issued in
+ * indirect mode (polled, or with DMA where the part has it), as status
+ * polling (automatic polling mode), or used to map the flash into the
+ * address space (memory mapped mode).
+ * @{
+ */
 
 #include <libopencm3/stm32/quadspi.h>
 
@@ -10,3 +19,312 @@ void quadspi_disable(uint32_t quadspi)
 {
 	QUADSPI_CR(quadspi) &= ~QUADSPI_CR_EN;
 }
+
+/**
+ * Set the kernel clock prescaler, the flash clock is f / (prescaler + 1).
+ */
+void quadspi_set_prescaler(uint32_t quadspi, uint8_t prescaler)
+{
+	QUADSPI_CR(quadspi) = (QUADSPI_CR(quadspi) &
+		~(QUADSPI_CR_PRESCALE_MASK << QUADSPI_CR_PRESCALE_SHIFT)) |
+		((uint32_t)prescaler << QUADSPI_CR_PRESCALE_SHIFT);
+}
+
+/**
+ * Set the size of the flash, in bytes as a power of two (e.g. 24 for 16MB).
+ */
+void quadspi_set_flash_size(uint32_t quadspi, uint8_t size_log2)
+{
+	QUADSPI_DCR(quadspi) = (QUADSPI_DCR(quadspi) &
+		~(QUADSPI_DCR_FSIZE_MASK << QUADSPI_DCR_FSIZE_SHIFT)) |
+		(((size_log2 - 1U) & QUADSPI_DCR_FSIZE_MASK) <<
+		 QUADSPI_DCR_FSIZE_SHIFT);
+}
+
+/**
+ * Set the minimum number of cycles (1 ... 8) chip select stays high between
+ * commands.
+ */
+void quadspi_set_cs_high_time(uint32_t quadspi, uint8_t cycles)
+{
+	QUADSPI_DCR(quadspi) = (QUADSPI_DCR(quadspi) &
+		~(QUADSPI_DCR_CSHT_MASK << QUADSPI_DCR_CSHT_SHIFT)) |
+		(((cycles - 1U) & QUADSPI_DCR_CSHT_MASK) <<
+		 QUADSPI_DCR_CSHT_SHIFT);
+}
+
+/**
+ * Select whether the clock idles high (SPI mode 3) or low (mode 0).
+ */
+void quadspi_set_clock_mode3(uint32_t quadspi, bool mode3)
+{
+	if (mode3) {
+		QUADSPI_DCR(quadspi) |= QUADSPI_DCR_CKMODE;
+	} else {
+		QUADSPI_DCR(quadspi) &= ~QUADSPI_DCR_CKMODE;
+	}
+}
+
+/**
+ * Delay data sampling by half a clock cycle, needed at high clock rates.
+ */
+void quadspi_set_sample_shift(uint32_t quadspi, bool half_cycle)
+{
+	if (half_cycle) {
+		QUADSPI_CR(quadspi) |= QUADSPI_CR_SSHIFT;
+	} else {
+		QUADSPI_CR(quadspi) &= ~QUADSPI_CR_SSHIFT;
+	}
+}
+
+/**
+ * Set the FIFO level (1 ... 32 bytes) at which FTF, and the DMA request,
+ * are raised in indirect mode.
+ */
+void quadspi_set_fifo_threshold(uint32_t quadspi, uint8_t threshold)
+{
+	QUADSPI_CR(quadspi) = (QUADSPI_CR(quadspi) &
+		~(QUADSPI_CR_FTHRES_MASK << QUADSPI_CR_FTHRES_SHIFT)) |
+		(((threshold - 1U) & QUADSPI_CR_FTHRES_MASK) <<
+		 QUADSPI_CR_FTHRES_SHIFT);
+}
+
+/**
+ * Abort the ongoing command, e.g. to leave memory mapped or auto-poll mode.
+ */
+void quadspi_abort(uint32_t quadspi)
+{
+	QUADSPI_CR(quadspi) |= QUADSPI_CR_ABORT;
+	while (QUADSPI_CR(quadspi) & QUADSPI_CR_ABORT);
+}
+
+void quadspi_wait_while_busy(uint32_t quadspi)
+{
+	while (QUADSPI_SR(quadspi) & QUADSPI_SR_BUSY);
+}
+
+static uint32_t quadspi_ccr(const struct quadspi_command *cmd, uint32_t fmode)
+{
+	uint32_t ccr = (fmode << QUADSPI_CCR_FMODE_SHIFT) |
+		((uint32_t)cmd->data_mode << QUADSPI_CCR_DMODE_SHIFT) |
+		(((uint32_t)cmd->dummy_cycles & QUADSPI_CCR_DCYC_MASK) <<
+		 QUADSPI_CCR_DCYC_SHIFT) |
+		((uint32_t)cmd->alternate_size << QUADSPI_CCR_ABSIZE_SHIFT) |
+		((uint32_t)cmd->alternate_mode << QUADSPI_CCR_ABMODE_SHIFT) |
+		((uint32_t)cmd->address_size << QUADSPI_CCR_ADSIZE_SHIFT) |
+		((uint32_t)cmd->address_mode << QUADSPI_CCR_ADMODE_SHIFT) |
+		((uint32_t)cmd->instruction_mode << QUADSPI_CCR_IMODE_SHIFT) |
+		cmd->instruction;
+
+	if (cmd->ddr) {
+		ccr |= QUADSPI_CCR_DDRM;
+	}
+	if (cmd->sioo) {
+		ccr |= QUADSPI_CCR_SIOO;
+	}
+	return ccr;
+}
+
+/* Program a command. The transfer starts on the last of the CCR/AR writes
+ * that the command needs, so the data length and alternate bytes go first.
+ * An indirect command with len 0 is sent without its data phase: DLR would
+ * be 0xffffffff, reading or writing until the end of the flash.
+ */
+static void quadspi_issue(uint32_t quadspi, const struct quadspi_command *cmd,
+			  uint32_t fmode, uint32_t len)
+{
+	uint32_t ccr = quadspi_ccr(cmd, fmode);
+
+	quadspi_wait_while_busy(quadspi);
+	QUADSPI_FCR(quadspi) = QUADSPI_FCR_CTOF | QUADSPI_FCR_CSMF |
+			       QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF;
+	if (cmd->data_mode != QUADSPI_CCR_MODE_NONE) {
+		if (len) {
+			QUADSPI_DLR(quadspi) = len - 1;
+		} else if (fmode == QUADSPI_CCR_FMODE_IREAD ||
+			   fmode == QUADSPI_CCR_FMODE_IWRITE) {
+			ccr &= ~(QUADSPI_CCR_DMODE_MASK <<
+				 QUADSPI_CCR_DMODE_SHIFT);
+		}
+	}
+	if (cmd->alternate_mode != QUADSPI_CCR_MODE_NONE) {
+		QUADSPI_ABR(quadspi) = cmd->alternate;
+	}
+	QUADSPI_CCR(quadspi) = ccr;
+	if (cmd->address_mode != QUADSPI_CCR_MODE_NONE &&
+	    fmode != QUADSPI_CCR_FMODE_MEMMAP) {
+		QUADSPI_AR(quadspi) = cmd->address;
+	}
+}
+
+static void quadspi_wait_complete(uint32_t quadspi)
+{
+	while (!(QUADSPI_SR(quadspi) & (QUADSPI_SR_TCF | QUADSPI_SR_TEF)));
+	QUADSPI_FCR(quadspi) = QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF;
+}
+
+/**
+ * Send a command without a data phase (e.g. write enable, erase) and wait
+ * for it to complete.
+ */
+void quadspi_command(uint32_t quadspi, const struct quadspi_command *cmd)
+{
+	quadspi_issue(quadspi, cmd, QUADSPI_CCR_FMODE_IWRITE, 0);
+	quadspi_wait_complete(quadspi);
+}
+
+/**
+ * Indirect mode read, polling the FIFO. Whole words are taken from the
+ * FIFO whenever at least four bytes are waiting. With len 0 only the
+ * command is sent.
+ */
+void quadspi_read(uint32_t quadspi, const struct quadspi_command *cmd,
+		  void *buf, uint32_t len)
+{
+	uint8_t *p = buf;
+
+	quadspi_issue(quadspi, cmd, QUADSPI_CCR_FMODE_IREAD, len);
+	while (len) {
+		uint32_t level = (QUADSPI_SR(quadspi) >> QUADSPI_SR_FLEVEL_SHIFT) &
+				 QUADSPI_SR_FLEVEL_MASK;
+
+		if (len >= 4 && level >= 4) {
+			uint32_t word = QUADSPI_DR(quadspi);
+
+			p[0] = word;
+			p[1] = word >> 8;
+			p[2] = word >> 16;
+			p[3] = word >> 24;
+			p += 4;
+			len -= 4;
+		} else if (level) {
+			*p++ = QUADSPI_BYTE_DR(quadspi);
+			len--;
+		}
+	}
+	quadspi_wait_complete(quadspi);
+}
+
+/**
+ * Indirect mode write, polling the FIFO. With len 0 only the command is
+ * sent.
+ */
+void quadspi_write(uint32_t quadspi, const struct quadspi_command *cmd,
+		   const void *buf, uint32_t len)
+{
+	const uint8_t *p = buf;
+
+	quadspi_issue(quadspi, cmd, QUADSPI_CCR_FMODE_IWRITE, len);
+	while (len) {
+		if (!(QUADSPI_SR(quadspi) & QUADSPI_SR_FTF)) {
+			continue;
+		}
+		if (len >= 4) {
+			QUADSPI_DR(quadspi) = p[0] | (p[1] << 8) |
+				(p[2] << 16) | ((uint32_t)p[3] << 24);
+			p += 4;
+			len -= 4;
+		} else {
+			QUADSPI_BYTE_DR(quadspi) = *p++;
+			len--;
+		}
+	}
+	quadspi_wait_complete(quadspi);
+}
+
+/**
+ * Start automatic status polling: cmd (whose data phase returns the status,
+ * typically 1 byte) is repeated every interval clock cycles until the
+ * masked status equals match (all bits, or any bit if or_match is set).
+ * SMF is then set in QUADSPI_SR, raising an interrupt if SMIE is enabled,
+ * and polling stops.
+ */
+void quadspi_start_auto_poll(uint32_t quadspi,
+			     const struct quadspi_command *cmd,
+			     uint32_t mask, uint32_t match, uint16_t interval,
+			     bool or_match)
+{
+	uint32_t len = cmd->data_mode != QUADSPI_CCR_MODE_NONE ? 1 : 0;
+
+	QUADSPI_PSMKR(quadspi) = mask;
+	QUADSPI_PSMAR(quadspi) = match;
+	QUADSPI_PIR(quadspi) = interval;
+	if (or_match) {
+		QUADSPI_CR(quadspi) |= QUADSPI_CR_PMM | QUADSPI_CR_APMS;
+	} else {
+		QUADSPI_CR(quadspi) = (QUADSPI_CR(quadspi) & ~QUADSPI_CR_PMM) |
+				      QUADSPI_CR_APMS;
+	}
+	quadspi_issue(quadspi, cmd, QUADSPI_CCR_FMODE_APOLL, len);
+}
+
+/**
+ * Wait for a status bit pattern using automatic polling, e.g. for the
+ * write in progress bit of a flash to clear.
+ */
+void quadspi_wait_status(uint32_t quadspi, const struct quadspi_command *cmd,
+			 uint32_t mask, uint32_t match)
+{
+	quadspi_start_auto_poll(quadspi, cmd, mask, match, 16, false);
+	while (!(QUADSPI_SR(quadspi) & QUADSPI_SR_SMF));
+	QUADSPI_FCR(quadspi) = QUADSPI_FCR_CSMF;
+	quadspi_wait_while_busy(quadspi);
+}
+
+/**
+ * Enter memory mapped mode: reads from the QUADSPI bank are translated into
+ * cmd, with the address taken from the access. The peripheral prefetches
+ * sequentially after each access; with a nonzero timeout chip select is
+ * released after that many idle cycles, otherwise the prefetch stays active
+ * (lowest latency for code executing in place). Use @ref quadspi_abort to
+ * leave memory mapped mode.
+ */
+void quadspi_memory_mapped(uint32_t quadspi,
+			   const struct quadspi_command *cmd,
+			   uint16_t timeout)
+{
+	if (timeout) {
+		QUADSPI_LPTR(quadspi) = timeout;
+		QUADSPI_CR(quadspi) |= QUADSPI_CR_TCEN;
+	} else {
+		QUADSPI_CR(quadspi) &= ~QUADSPI_CR_TCEN;
+	}
+	quadspi_issue(quadspi, cmd, QUADSPI_CCR_FMODE_MEMMAP, 0);
+}
+
+#ifdef QUADSPI_CR_DMAEN
+/**
+ * Start an indirect read of len bytes, moved by DMA. A DMA stream must have
+ * been set up beforehand to transfer from QUADSPI_DR (byte, half word or word
+ * wide, matching the FIFO threshold) to memory. Call
+ * @ref quadspi_finish_dma once the DMA transfer has completed.
+ */
+void quadspi_start_dma_read(uint32_t quadspi,
+			    const struct quadspi_command *cmd, uint32_t len)
+{
+	QUADSPI_CR(quadspi) |= QUADSPI_CR_DMAEN;
+	quadspi_issue(quadspi, cmd, QUADSPI_CCR_FMODE_IREAD, len);
+}
+
+/**
+ * Start an indirect write of len bytes fed by a DMA stream writing to
+ * QUADSPI_DR, see @ref quadspi_start_dma_read.
+ */
+void quadspi_start_dma_write(uint32_t quadspi,
+			     const struct quadspi_command *cmd, uint32_t len)
+{
+	QUADSPI_CR(quadspi) |= QUADSPI_CR_DMAEN;
+	quadspi_issue(quadspi, cmd, QUADSPI_CCR_FMODE_IWRITE, len);
+}
+
+/**
+ * Wait for the end of a DMA driven command and release the DMA request.
+ */
+void quadspi_finish_dma(uint32_t quadspi)
+{
+	quadspi_wait_complete(quadspi);
+	QUADSPI_CR(quadspi) &= ~QUADSPI_CR_DMAEN;
+}
+#endif
+
+/**@}*/
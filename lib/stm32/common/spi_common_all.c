@@ -51,6 +51,8 @@ LSB first.
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/* Always build the out of line versions of the inlinable accessors. */
+#undef LIBOPENCM3_INLINE
 #include <libopencm3/stm32/spi.h>
 #include <libopencm3/stm32/rcc.h>
 
@@ -54,6 +54,7 @@ LSB first.
 
 #include <libopencm3/stm32/spi.h>
 #include <libopencm3/stm32/rcc.h>
+#include "spi_private.h"
 
 
 /**@{*/
@@ -124,4 +125,12 @@ void spi_set_dff_16bit(uint32_t spi)
 	SPI_CR1(spi) |= SPI_CR1_DFF;
 }
 
+/* Frame size in bytes for the transfer code. There is no packing on this
+ * SPI version. */
+unsigned _spi_frame_setup(uint32_t spi, bool packed)
+{
+	(void)packed;
+	return (SPI_CR1(spi) & SPI_CR1_DFF) ? 2 : 1;
+}
+
 /**@}*/
@@ -53,6 +53,7 @@ LSB first.
 
 #include <libopencm3/stm32/spi.h>
 #include <libopencm3/stm32/rcc.h>
+#include "spi_private.h"
 
 /**@{*/
 
@@ -166,4 +167,19 @@ void spi_fifo_reception_threshold_16bit(uint32_t spi)
 	SPI_CR2(spi) &= ~SPI_CR2_FRXTH;
 }
 
+/* Frame size in bytes for the transfer code, setting the reception threshold
+ * to match. With packed set, 8 bit frames are moved in pairs through 16 bit
+ * data register accesses, and 2 is returned. */
+unsigned _spi_frame_setup(uint32_t spi, bool packed)
+{
+	bool wide = (SPI_CR2(spi) & SPI_CR2_DS_MASK) > SPI_CR2_DS_8BIT;
+
+	if (wide || packed) {
+		SPI_CR2(spi) &= ~SPI_CR2_FRXTH;
+		return 2;
+	}
+	SPI_CR2(spi) |= SPI_CR2_FRXTH;
+	return 1;
+}
+
 /**@}*/
@@ -0,0 +1,33 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This is a "private" header file for the SPI transfer code.
+ * The functions are implemented per SPI version or DMA controller type.
+ */
+
+#ifndef SPI_PRIVATE_H
+#define SPI_PRIVATE_H
+
+#include <libopencm3/stm32/spi.h>
+
+unsigned _spi_frame_setup(uint32_t spi, bool packed);
+void _spi_bus_dma_start(struct spi_bus *bus, const struct spi_transaction *t);
+void _spi_bus_dma_stop(struct spi_bus *bus);
+int _spi_bus_dma_status(struct spi_bus *bus);
+
+#endif
@@ -0,0 +1,328 @@
+/** @addtogroup spi_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/spi.h>
+#include "spi_private.h"
+
+/*
+ * Frames are kept in byte buffers, little endian, so that neither buffer
+ * needs to be aligned. The data register is accessed with the width of a
+ * unit: a frame, or a pair of 8 bit frames where the SPI packs them.
+ */
+
+static uint16_t spi_unit_get(const uint8_t *buf, uint32_t i, unsigned size)
+{
+	if (!buf) {
+		return SPI_TRANSFER_DUMMY;
+	}
+	buf += i * size;
+	return size == 2 ? buf[0] | (buf[1] << 8) : buf[0];
+}
+
+static void spi_unit_put(uint8_t *buf, uint32_t i, unsigned size,
+			 uint16_t data)
+{
+	if (!buf) {
+		return;
+	}
+	buf += i * size;
+	buf[0] = data;
+	if (size == 2) {
+		buf[1] = data >> 8;
+	}
+}
+
+/* 16 bit accesses move a halfword frame or, with FRXTH clear, a packed pair
+ * of 8 bit frames. Byte accesses are needed for single 8 bit frames on SPIs
+ * with a FIFO; without one, DR holds a single frame whatever the width. */
+static void spi_unit_write(uint32_t spi, unsigned size, uint16_t data)
+{
+#ifdef SPI_DR8
+	if (size == 1) {
+		SPI_DR8(spi) = data;
+		return;
+	}
+#else
+	(void)size;
+#endif
+	SPI_DR(spi) = data;
+}
+
+static uint16_t spi_unit_read(uint32_t spi, unsigned size)
+{
+#ifdef SPI_DR8
+	if (size == 1) {
+		return SPI_DR8(spi);
+	}
+#else
+	(void)size;
+#endif
+	return SPI_DR(spi);
+}
+
+/* Let the last frame go out and clear the overrun. */
+static void spi_recover(uint32_t spi)
+{
+	while (!(SPI_SR(spi) & SPI_SR_TXE));
+	while (SPI_SR(spi) & SPI_SR_BSY);
+	/* Reading DR, then SR, clears OVR. */
+	while (SPI_SR(spi) & SPI_SR_RXNE) {
+		(void)SPI_DR(spi);
+	}
+}
+
+static int spi_transfer_units(uint32_t spi, const uint8_t *tx, uint8_t *rx,
+			      uint32_t n, unsigned size)
+{
+	uint32_t sent = 0, received = 0;
+
+	while (received < n) {
+		uint32_t sr = SPI_SR(spi);
+
+		if (sr & SPI_SR_OVR) {
+			spi_recover(spi);
+			return -1;
+		}
+		/* Two units in flight keep the shifter busy without letting
+		 * the receiver overrun while it is read in time. */
+		if (sent < n && sent - received < 2 && (sr & SPI_SR_TXE)) {
+			spi_unit_write(spi, size, spi_unit_get(tx, sent, size));
+			sent++;
+		}
+		if (sr & SPI_SR_RXNE) {
+			spi_unit_put(rx, received, size,
+				     spi_unit_read(spi, size));
+			received++;
+		}
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SPI Transfer a Block of Frames
+
+Sends len frames and stores the frames received meanwhile. The next frame is
+written while the previous one is shifted, so frames follow back to back; on
+SPIs with a FIFO, 8 bit frames are moved in pairs. Either buffer may be NULL:
+without tx SPI_TRANSFER_DUMMY is sent (to clock data in), without rx the
+received frames are dropped. Frames are bytes, or halfwords for frames over
+8 bits, and the buffers need not be aligned.
+
+The SPI must be set up as master and enabled; chip select is left to the
+caller. On SPIs without a FIFO, an interrupt delaying the loop by more than
+a frame makes the receiver overrun, which aborts the transfer.
+
+@param[in] spi Unsigned int32. SPI peripheral identifier @ref spi_reg_base.
+@param[in] tx Frames to send, or NULL
+@param[out] rx Buffer for the received frames, or NULL
+@param[in] len Number of frames
+@returns 0 on success, -1 on a receiver overrun.
+*/
+int spi_transfer(uint32_t spi, const void *tx, void *rx, uint32_t len)
+{
+	const uint8_t *txp = tx;
+	uint8_t *rxp = rx;
+	unsigned frame = _spi_frame_setup(spi, false);
+	uint32_t bytes = len * frame;
+	unsigned unit = _spi_frame_setup(spi, bytes >= 2);
+	uint32_t n = bytes / unit;
+	int ret;
+
+	ret = spi_transfer_units(spi, txp, rxp, n, unit);
+	/* Back to single frames, so that spi_xfer() and friends see RXNE
+	 * again; this also sets up the odd tail below. */
+	_spi_frame_setup(spi, false);
+	if (!ret && n * unit < bytes) {
+		/* Odd number of packed 8 bit frames: the last one alone. */
+		ret = spi_transfer_units(spi, txp ? txp + bytes - 1 : NULL,
+					 rxp ? rxp + bytes - 1 : NULL, 1, 1);
+	}
+	return ret;
+}
+
+/* Start the head transaction. Called with interrupts masked. */
+static void spi_bus_start(struct spi_bus *bus)
+{
+	struct spi_transaction *t = bus->head;
+
+	if (t->cs_port) {
+		gpio_clear(t->cs_port, t->cs_pins);
+	}
+	bus->frame = _spi_frame_setup(bus->spi, false);
+	bus->sent = 0;
+	bus->received = 0;
+
+	if (bus->dma) {
+		_spi_bus_dma_start(bus, t);
+		spi_enable_rx_dma(bus->spi);
+		spi_enable_tx_dma(bus->spi);
+	} else {
+		SPI_CR2(bus->spi) |= SPI_CR2_RXNEIE | SPI_CR2_ERRIE;
+		spi_unit_write(bus->spi, bus->frame,
+			       spi_unit_get(t->tx, 0, bus->frame));
+		bus->sent = 1;
+	}
+}
+
+/* End the head transaction and start the next one. Called with interrupts
+ * masked. */
+static void spi_bus_finish(struct spi_bus *bus, int status)
+{
+	struct spi_transaction *t = bus->head;
+
+	if (bus->dma) {
+		spi_disable_tx_dma(bus->spi);
+		spi_disable_rx_dma(bus->spi);
+		_spi_bus_dma_stop(bus);
+	} else {
+		SPI_CR2(bus->spi) &= ~(SPI_CR2_RXNEIE | SPI_CR2_ERRIE);
+	}
+	if (status) {
+		bus->errors++;
+		spi_recover(bus->spi);
+	}
+	if (t->cs_port && (!t->cs_hold || status)) {
+		gpio_set(t->cs_port, t->cs_pins);
+	}
+
+	bus->head = t->next;
+	if (!bus->head) {
+		bus->tail = NULL;
+	}
+	t->next = NULL;
+	/* Start the next one first: the callback may submit more, which
+	 * only starts a transfer on an idle bus. */
+	if (bus->head) {
+		spi_bus_start(bus);
+	}
+	if (t->callback) {
+		t->callback(t, status);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SPI Queue Transactions
+
+Appends a transaction, or a chain of transactions linked through next, to the
+bus queue and starts it if the bus is idle. The transactions and their buffers
+must not be touched until their callbacks have been called.
+
+@param[in] bus SPI bus
+@param[in] t First transaction
+@returns 0 if queued, -1 (nothing queued) if a transaction has no frames.
+*/
+int spi_bus_submit(struct spi_bus *bus, struct spi_transaction *t)
+{
+	struct spi_transaction *last = t;
+
+	/* Stops early at an empty transaction, which would never see a frame
+	 * to complete it. */
+	while (last->len && last->next) {
+		last = last->next;
+	}
+	if (!last->len) {
+		return -1;
+	}
+
+	CM_ATOMIC_BLOCK() {
+		if (bus->tail) {
+			bus->tail->next = t;
+			bus->tail = last;
+		} else {
+			bus->head = t;
+			bus->tail = last;
+			spi_bus_start(bus);
+		}
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SPI Check for pending Transactions
+
+@param[in] bus SPI bus
+@returns true if a transaction is queued or running.
+*/
+bool spi_bus_busy(const struct spi_bus *bus)
+{
+	return bus->head != NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SPI Bus Interrupt Handler
+
+Moves one frame per interrupt when the bus has no DMA controller.
+
+@param[in] bus SPI bus
+*/
+void spi_bus_isr(struct spi_bus *bus)
+{
+	struct spi_transaction *t = bus->head;
+	uint32_t sr = SPI_SR(bus->spi);
+
+	if (!t || bus->dma) {
+		return;
+	}
+	if (sr & (SPI_SR_OVR | SPI_SR_MODF)) {
+		spi_bus_finish(bus, -1);
+		return;
+	}
+	if (!(sr & SPI_SR_RXNE)) {
+		return;
+	}
+
+	spi_unit_put(t->rx, bus->received, bus->frame,
+		     spi_unit_read(bus->spi, bus->frame));
+	bus->received++;
+	if (bus->received == t->len) {
+		spi_bus_finish(bus, 0);
+	} else if (bus->sent < t->len) {
+		/* The transmit buffer is empty once a frame came in. */
+		spi_unit_write(bus->spi, bus->frame,
+			       spi_unit_get(t->tx, bus->sent, bus->frame));
+		bus->sent++;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SPI Bus Receive DMA Interrupt Handler
+
+@param[in] bus SPI bus
+*/
+void spi_bus_dma_isr(struct spi_bus *bus)
+{
+	int status;
+
+	if (!bus->head || !bus->dma) {
+		return;
+	}
+	status = _spi_bus_dma_status(bus);
+	if (status) {
+		spi_bus_finish(bus, status < 0 ? -1 : 0);
+	}
+}
+
+/**@}*/
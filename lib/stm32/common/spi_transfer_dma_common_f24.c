@@ -0,0 +1,99 @@
+/** @addtogroup spi_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/spi.h>
+#include "spi_private.h"
+
+/* SPI bus transfers on the stream DMA controller. */
+
+static const uint16_t spi_dma_dummy = SPI_TRANSFER_DUMMY;
+static uint16_t spi_dma_sink;
+
+static void spi_dma_setup(uint32_t dma, uint8_t stream, uint32_t request,
+			  uint32_t dir, uint32_t spi, const void *buf,
+			  bool inc, uint32_t len, unsigned frame)
+{
+	dma_stream_reset(dma, stream);
+	dma_channel_select(dma, stream, request);
+	dma_set_transfer_mode(dma, stream, dir);
+	if (frame == 2) {
+		dma_set_peripheral_size(dma, stream, DMA_SxCR_PSIZE_16BIT);
+		dma_set_memory_size(dma, stream, DMA_SxCR_MSIZE_16BIT);
+	} else {
+		dma_set_peripheral_size(dma, stream, DMA_SxCR_PSIZE_8BIT);
+		dma_set_memory_size(dma, stream, DMA_SxCR_MSIZE_8BIT);
+	}
+	if (inc) {
+		dma_enable_memory_increment_mode(dma, stream);
+	}
+	dma_set_priority(dma, stream, DMA_SxCR_PL_HIGH);
+	dma_set_peripheral_address(dma, stream, (uint32_t)&SPI_DR(spi));
+	dma_set_memory_address(dma, stream, (uint32_t)buf);
+	dma_set_number_of_data(dma, stream, len);
+}
+
+void _spi_bus_dma_start(struct spi_bus *bus, const struct spi_transaction *t)
+{
+	spi_dma_setup(bus->dma, bus->rx_stream, bus->rx_request,
+		      DMA_SxCR_DIR_PERIPHERAL_TO_MEM, bus->spi,
+		      t->rx ? t->rx : &spi_dma_sink, t->rx != NULL, t->len,
+		      bus->frame);
+	dma_enable_transfer_complete_interrupt(bus->dma, bus->rx_stream);
+	dma_enable_transfer_error_interrupt(bus->dma, bus->rx_stream);
+	dma_enable_stream(bus->dma, bus->rx_stream);
+
+	spi_dma_setup(bus->dma, bus->tx_stream, bus->tx_request,
+		      DMA_SxCR_DIR_MEM_TO_PERIPHERAL, bus->spi,
+		      t->tx ? t->tx : &spi_dma_dummy, t->tx != NULL, t->len,
+		      bus->frame);
+	dma_enable_stream(bus->dma, bus->tx_stream);
+}
+
+static void spi_dma_stop(uint32_t dma, uint8_t stream)
+{
+	dma_disable_stream(dma, stream);
+	while (DMA_SCR(dma, stream) & DMA_SxCR_EN);
+	dma_clear_interrupt_flags(dma, stream, DMA_ISR_FLAGS);
+}
+
+void _spi_bus_dma_stop(struct spi_bus *bus)
+{
+	spi_dma_stop(bus->dma, bus->tx_stream);
+	spi_dma_stop(bus->dma, bus->rx_stream);
+}
+
+int _spi_bus_dma_status(struct spi_bus *bus)
+{
+	if (dma_get_interrupt_flag(bus->dma, bus->rx_stream, DMA_TEIF) ||
+	    dma_get_interrupt_flag(bus->dma, bus->tx_stream, DMA_TEIF)) {
+		return -1;
+	}
+	if (dma_get_interrupt_flag(bus->dma, bus->rx_stream, DMA_TCIF)) {
+		return 1;
+	}
+	return 0;
+}
+
+/**@}*/
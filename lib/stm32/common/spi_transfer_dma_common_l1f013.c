@@ -0,0 +1,97 @@
+/** @addtogroup spi_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/spi.h>
+#include "spi_private.h"
+
+/* SPI bus transfers on the channel DMA controller. Where the part has a
+ * DMAMUX or a channel selection register, the application routes the
+ * requests; rx_request and tx_request are not used. */
+
+static const uint16_t spi_dma_dummy = SPI_TRANSFER_DUMMY;
+static uint16_t spi_dma_sink;
+
+static void spi_dma_setup(uint32_t dma, uint8_t channel, bool to_spi,
+			  uint32_t spi, const void *buf, bool inc,
+			  uint32_t len, unsigned frame)
+{
+	dma_channel_reset(dma, channel);
+	if (to_spi) {
+		dma_set_read_from_memory(dma, channel);
+	} else {
+		dma_set_read_from_peripheral(dma, channel);
+	}
+	if (frame == 2) {
+		dma_set_peripheral_size(dma, channel, DMA_CCR_PSIZE_16BIT);
+		dma_set_memory_size(dma, channel, DMA_CCR_MSIZE_16BIT);
+	} else {
+		dma_set_peripheral_size(dma, channel, DMA_CCR_PSIZE_8BIT);
+		dma_set_memory_size(dma, channel, DMA_CCR_MSIZE_8BIT);
+	}
+	if (inc) {
+		dma_enable_memory_increment_mode(dma, channel);
+	}
+	dma_set_priority(dma, channel, DMA_CCR_PL_HIGH);
+	dma_set_peripheral_address(dma, channel, (uint32_t)&SPI_DR(spi));
+	dma_set_memory_address(dma, channel, (uint32_t)buf);
+	dma_set_number_of_data(dma, channel, len);
+}
+
+void _spi_bus_dma_start(struct spi_bus *bus, const struct spi_transaction *t)
+{
+	spi_dma_setup(bus->dma, bus->rx_stream, false, bus->spi,
+		      t->rx ? t->rx : &spi_dma_sink, t->rx != NULL, t->len,
+		      bus->frame);
+	dma_enable_transfer_complete_interrupt(bus->dma, bus->rx_stream);
+	dma_enable_transfer_error_interrupt(bus->dma, bus->rx_stream);
+	dma_enable_channel(bus->dma, bus->rx_stream);
+
+	spi_dma_setup(bus->dma, bus->tx_stream, true, bus->spi,
+		      t->tx ? t->tx : &spi_dma_dummy, t->tx != NULL, t->len,
+		      bus->frame);
+	dma_enable_channel(bus->dma, bus->tx_stream);
+}
+
+void _spi_bus_dma_stop(struct spi_bus *bus)
+{
+	dma_disable_channel(bus->dma, bus->tx_stream);
+	dma_disable_channel(bus->dma, bus->rx_stream);
+	dma_clear_interrupt_flags(bus->dma, bus->tx_stream, DMA_FLAGS);
+	dma_clear_interrupt_flags(bus->dma, bus->rx_stream, DMA_FLAGS);
+}
+
+int _spi_bus_dma_status(struct spi_bus *bus)
+{
+	if (dma_get_interrupt_flag(bus->dma, bus->rx_stream, DMA_TEIF) ||
+	    dma_get_interrupt_flag(bus->dma, bus->tx_stream, DMA_TEIF)) {
+		return -1;
+	}
+	if (dma_get_interrupt_flag(bus->dma, bus->rx_stream, DMA_TCIF)) {
+		return 1;
+	}
+	return 0;
+}
+
+/**@}*/
@@ -38,18 +38,12 @@ void st_usbfs_set_address(usbd_device *dev, uint8_t addr)
 	SET_REG(USB_DADDR_REG, (addr & USB_DADDR_ADDR) | USB_DADDR_EF);
 }
 
-/**
- * Set the receive buffer size for a given USB endpoint.
- *
- * @param dev the usb device handle returned from @ref usbd_init
- * @param ep Index of endpoint to configure.
- * @param size Size in bytes of the RX buffer. Legal sizes : {2,4,6...62}; {64,96,128...992}.
- * @returns (uint16) Actual size set
+/*
+ * Compute the COUNTn_RX register value for a receive buffer of the given size,
+ * returning the buffer size the hardware will actually use in realsize.
  */
-uint16_t st_usbfs_set_ep_rx_bufsize(usbd_device *dev, uint8_t ep, uint32_t size)
+static uint16_t st_usbfs_rx_count(uint32_t size, uint16_t *realsize)
 {
-	uint16_t realsize;
-	(void)dev;
 	/*
 	 * Writes USB_COUNTn_RX reg fields : bits <14:10> are NUM_BLOCK; bit 15 is BL_SIZE
 	 * - When (size <= 62), BL_SIZE is set to 0 and NUM_BLOCK set to (size / 2).
@@ -65,19 +59,74 @@ uint16_t st_usbfs_set_ep_rx_bufsize(usbd_device *dev, uint8_t ep, uint32_t size)
 	if (size > 62) {
 		/* Round up, div by 32 and sub 1 == (size + 31)/32 - 1 == (size-1)/32)*/
 		size = ((size - 1) >> 5) & 0x1F;
-		realsize = (size + 1) << 5;
+		*realsize = (size + 1) << 5;
 		/* Set BL_SIZE bit (no macro for this) */
 		size |= (1<<5);
 	} else {
 		/* round up and div by 2 */
 		size = (size + 1) >> 1;
-		realsize = size << 1;
+		*realsize = size << 1;
 	}
+	return size << 10;
+}
+
+/**
+ * Set the receive buffer size for a given USB endpoint.
+ *
+ * @param dev the usb device handle returned from @ref usbd_init
+ * @param ep Index of endpoint to configure.
+ * @param size Size in bytes of the RX buffer. Legal sizes : {2,4,6...62}; {64,96,128...992}.
+ * @returns (uint16) Actual size set
+ */
+uint16_t st_usbfs_set_ep_rx_bufsize(usbd_device *dev, uint8_t ep, uint32_t size)
+{
+	uint16_t realsize;
+	(void)dev;
 	/* write to the BL_SIZE and NUM_BLOCK fields */
-	USB_SET_EP_RX_COUNT(ep, size << 10);
+	USB_SET_EP_RX_COUNT(ep, st_usbfs_rx_count(size, &realsize));
 	return realsize;
 }
 
+/*
+ * Isochronous endpoints are always double buffered: both buffer descriptors
+ * of the endpoint serve the one direction, the hardware using the buffer
+ * selected by the DTOG bit while the application works on the other one.
+ */
+static void st_usbfs_iso_ep_setup(usbd_device *dev, uint8_t addr,
+		uint16_t max_size, usbd_endpoint_callback callback)
+{
+	const uint8_t ep = addr & 0x7f;
+	/* Keep both buffers on a half-word boundary */
+	const uint16_t bufsize = (max_size + 1) & ~1U;
+
+	USB_CLR_EP_TX_DTOG(ep);
+	USB_CLR_EP_RX_DTOG(ep);
+	USB_SET_EP_TX_ADDR(ep, dev->pm_top);
+
+	if (addr & 0x80) {
+		USB_SET_EP_TX_COUNT(ep, 0);
+		USB_SET_EP_RX_ADDR(ep, dev->pm_top + bufsize);
+		USB_SET_EP_RX_COUNT(ep, 0);
+		if (callback) {
+			dev->user_callback_ctr[ep][USB_TRANSACTION_IN] = callback;
+		}
+		/* There is no handshake, the endpoint just sends whatever is in the buffer */
+		USB_SET_EP_TX_STAT(ep, USB_EP_TX_STAT_VALID);
+		dev->pm_top += 2 * bufsize;
+	} else {
+		uint16_t realsize;
+		const uint16_t count = st_usbfs_rx_count(max_size, &realsize);
+		USB_SET_EP_TX_COUNT(ep, count);
+		USB_SET_EP_RX_ADDR(ep, dev->pm_top + realsize);
+		USB_SET_EP_RX_COUNT(ep, count);
+		if (callback) {
+			dev->user_callback_ctr[ep][USB_TRANSACTION_OUT] = callback;
+		}
+		USB_SET_EP_RX_STAT(ep, USB_EP_RX_STAT_VALID);
+		dev->pm_top += 2 * realsize;
+	}
+}
+
 void st_usbfs_ep_setup(usbd_device *dev, uint8_t addr, uint8_t type,
 		uint16_t max_size,
 		void (*callback) (usbd_device *usbd_dev,
@@ -97,6 +146,11 @@ void st_usbfs_ep_setup(usbd_device *dev, uint8_t addr, uint8_t type,
 	USB_SET_EP_ADDR(addr, addr);
 	USB_SET_EP_TYPE(addr, typelookup[type]);
 
+	if (type == USB_ENDPOINT_ATTR_ISOCHRONOUS) {
+		st_usbfs_iso_ep_setup(dev, addr | dir, max_size, callback);
+		return;
+	}
+
 	if (dir || (addr == 0)) {
 		USB_SET_EP_TX_ADDR(addr, dev->pm_top);
 		if (callback) {
@@ -202,6 +256,18 @@ uint16_t st_usbfs_ep_write_packet(usbd_device *dev, uint8_t addr,
 	(void)dev;
 	addr &= 0x7F;
 
+	if ((*USB_EP_REG(addr) & USB_EP_TYPE) == USB_EP_TYPE_ISO) {
+		/* Fill the buffer the hardware is not sending from */
+		if (*USB_EP_REG(addr) & USB_EP_TX_DTOG) {
+			st_usbfs_copy_to_pm(USB_GET_EP_TX_BUFF(addr), buf, len);
+			USB_SET_EP_TX_COUNT(addr, len);
+		} else {
+			st_usbfs_copy_to_pm(USB_GET_EP_RX_BUFF(addr), buf, len);
+			USB_SET_EP_RX_COUNT(addr, len);
+		}
+		return len;
+	}
+
 	if ((*USB_EP_REG(addr) & USB_EP_TX_STAT) == USB_EP_TX_STAT_VALID) {
 		return 0;
 	}
@@ -217,6 +283,19 @@ uint16_t st_usbfs_ep_read_packet(usbd_device *dev, uint8_t addr,
 					 void *buf, uint16_t len)
 {
 	(void)dev;
+	if ((*USB_EP_REG(addr) & USB_EP_TYPE) == USB_EP_TYPE_ISO) {
+		/* The last packet is in the buffer the hardware is not receiving into */
+		if (*USB_EP_REG(addr) & USB_EP_RX_DTOG) {
+			len = MIN(USB_GET_EP_TX_COUNT(addr) & 0x3ff, len);
+			st_usbfs_copy_from_pm(buf, USB_GET_EP_TX_BUFF(addr), len);
+		} else {
+			len = MIN(USB_GET_EP_RX_COUNT(addr) & 0x3ff, len);
+			st_usbfs_copy_from_pm(buf, USB_GET_EP_RX_BUFF(addr), len);
+		}
+		USB_CLR_EP_RX_CTR(addr);
+		return len;
+	}
+
 	if ((*USB_EP_REG(addr) & USB_EP_RX_STAT) == USB_EP_RX_STAT_VALID) {
 		return 0;
 	}
@@ -0,0 +1,140 @@
+/** @addtogroup timer_file
+ *
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/timer.h>
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Start streaming Register Tuples
+ *
+ * The timer should be set up (with ARR/CCR preload) and may already run; the
+ * first tuple is written at the next update event. The DMA controller clock
+ * must be enabled.
+ *
+ * @param[in] burst Stream description, must stay valid until stopped
+ */
+void timer_burst_start(struct timer_burst *burst)
+{
+	uint32_t dma = burst->dma;
+	uint8_t stream = burst->stream;
+	bool dbm = burst->tables[1] != NULL;
+
+	TIM_DIER(burst->timer) &= ~TIM_DIER_UDE;
+	dma_stream_reset(dma, stream);
+	dma_channel_select(dma, stream, burst->channel);
+	dma_set_transfer_mode(dma, stream, DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
+	if (burst->halfwords) {
+		dma_set_peripheral_size(dma, stream, DMA_SxCR_PSIZE_16BIT);
+		dma_set_memory_size(dma, stream, DMA_SxCR_MSIZE_16BIT);
+	} else {
+		dma_set_peripheral_size(dma, stream, DMA_SxCR_PSIZE_32BIT);
+		dma_set_memory_size(dma, stream, DMA_SxCR_MSIZE_32BIT);
+	}
+	dma_enable_memory_increment_mode(dma, stream);
+	dma_set_priority(dma, stream, DMA_SxCR_PL_HIGH);
+	dma_set_peripheral_address(dma, stream,
+				   timer_get_dma_burst_address(burst->timer));
+	dma_set_memory_address(dma, stream, (uint32_t)burst->tables[0]);
+	dma_set_number_of_data(dma, stream,
+			       (uint16_t)(burst->tuples * burst->regs));
+	if (dbm) {
+		dma_set_memory_address_1(dma, stream,
+					 (uint32_t)burst->tables[1]);
+		dma_enable_double_buffer_mode(dma, stream);
+	} else if (burst->circular) {
+		dma_enable_circular_mode(dma, stream);
+		dma_enable_half_transfer_interrupt(dma, stream);
+	}
+	dma_enable_transfer_complete_interrupt(dma, stream);
+	dma_enable_transfer_error_interrupt(dma, stream);
+	dma_enable_stream(dma, stream);
+
+	timer_set_dma_burst(burst->timer, burst->first, burst->regs);
+	TIM_DIER(burst->timer) |= TIM_DIER_UDE;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Stop streaming Register Tuples
+ *
+ * The registers keep the last values written.
+ *
+ * @param[in] burst Stream description
+ */
+void timer_burst_stop(struct timer_burst *burst)
+{
+	TIM_DIER(burst->timer) &= ~TIM_DIER_UDE;
+	dma_disable_stream(burst->dma, burst->stream);
+	while (DMA_SCR(burst->dma, burst->stream) & DMA_SxCR_EN);
+	dma_clear_interrupt_flags(burst->dma, burst->stream, DMA_ISR_FLAGS);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Check whether a Stream is running
+ *
+ * @param[in] burst Stream description
+ * @returns false once a one shot table has been sent, or after a DMA error
+ */
+bool timer_burst_busy(const struct timer_burst *burst)
+{
+	return DMA_SCR(burst->dma, burst->stream) & DMA_SxCR_EN;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer DMA Stream Interrupt Handler for Bursts
+ *
+ * @param[in] burst Stream description
+ */
+void timer_burst_isr(struct timer_burst *burst)
+{
+	uint32_t dma = burst->dma;
+	uint8_t stream = burst->stream;
+
+	if (dma_get_interrupt_flag(dma, stream, DMA_TEIF)) {
+		/* The stream has been disabled by the hardware. */
+		dma_clear_interrupt_flags(dma, stream, DMA_TEIF);
+		TIM_DIER(burst->timer) &= ~TIM_DIER_UDE;
+	}
+	if (dma_get_interrupt_flag(dma, stream, DMA_HTIF)) {
+		dma_clear_interrupt_flags(dma, stream, DMA_HTIF);
+		if (burst->callback) {
+			burst->callback(burst, 0);
+		}
+	}
+	if (dma_get_interrupt_flag(dma, stream, DMA_TCIF)) {
+		unsigned part = 1;
+
+		dma_clear_interrupt_flags(dma, stream, DMA_TCIF);
+		if (burst->tables[1]) {
+			/* The stream already moved on to the other table. */
+			part = dma_get_target(dma, stream) ^ 1;
+		} else if (!burst->circular) {
+			TIM_DIER(burst->timer) &= ~TIM_DIER_UDE;
+		}
+		if (burst->callback) {
+			burst->callback(burst, part);
+		}
+	}
+}
+
+/**@}*/
@@ -116,6 +116,8 @@ knob.
 
 /**@{*/
 
+/* Always build the out of line versions of the inlinable accessors. */
+#undef LIBOPENCM3_INLINE
 #include <libopencm3/stm32/timer.h>
 #include <libopencm3/stm32/rcc.h>
 
@@ -1901,6 +1903,43 @@ void timer_slave_set_extclockmode2(uint32_t timer_peripheral,
 	}
 }
 
-/* TODO Timer DMA burst */
+/*---------------------------------------------------------------------------*/
+/** @brief Set up Timer DMA Bursts
+
+Each DMA request of the timer then transfers length values through the DMA
+burst register (see @ref timer_get_dma_burst_address) to consecutive timer
+registers, starting with first. This updates, for example, ARR, RCR and all
+CCRx on every update event (with the request enabled by TIM_DIER_UDE).
+
+@param[in] timer_peripheral Unsigned int32. Timer register address base
+@param[in] first Pointer to the first register written, e.g. &TIM_ARR(TIM1)
+@param[in] length Unsigned int8. Number of registers, 1 ... @ref
+TIM_DMA_BURST_MAX
+*/
+
+void timer_set_dma_burst(uint32_t timer_peripheral, volatile uint32_t *first,
+			 uint8_t length)
+{
+	uint32_t dba = ((uint32_t)first - timer_peripheral) / 4;
+
+	TIM_DCR(timer_peripheral) = ((dba << TIM_DCR_DBA_SHIFT) &
+				     TIM_DCR_DBA_MASK) |
+				    (((uint32_t)(length - 1) << TIM_DCR_DBL_SHIFT) &
+				     TIM_DCR_DBL_MASK);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the Timer DMA Burst Register Address
+
+The address to give a DMA channel as peripheral address for burst transfers.
+
+@param[in] timer_peripheral Unsigned int32. Timer register address base
+@returns Unsigned int32. Address of TIMx_DMAR
+*/
+
+uint32_t timer_get_dma_burst_address(uint32_t timer_peripheral)
+{
+	return (uint32_t)&TIM_DMAR(timer_peripheral);
+}
 
 /**@}*/
@@ -31,6 +31,8 @@ Devices can have up to 3 USARTs and 2 UARTs.
 
 /**@{*/
 
+/* Always build the out of line versions of the inlinable accessors. */
+#undef LIBOPENCM3_INLINE
 #include <libopencm3/stm32/usart.h>
 #include <libopencm3/stm32/rcc.h>
 
@@ -26,6 +26,8 @@
 
 /**@{*/
 
+/* Always build the out of line versions of the inlinable accessors. */
+#undef LIBOPENCM3_INLINE
 #include <libopencm3/stm32/usart.h>
 
 /*---------------------------------------------------------------------------*/
@@ -714,6 +714,193 @@ void adc_disable_regulator(uint32_t adc)
 	ADC_CR(adc) &= ~ADC_CR_ADVREGEN;
 }
 
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Set up Hardware Oversampling
+ *
+ * The converter accumulates ratio conversions and shifts the sum right by
+ * shift bits, so that only the averaged (or extended resolution) result is
+ * written to the data registers. This must be done while no regular or
+ * injected conversion is ongoing.
+ *
+ * @param[in] adc Unsigned int32. ADC block register address base @ref
+ * adc_reg_base
+ * @param[in] ratio Unsigned int32. ADC_CFGR2_OVSR_2x ... ADC_CFGR2_OVSR_256x
+ * @param[in] shift Unsigned int8. Right shift of the sum, 0 ... 8
+ * @param[in] mode Unsigned int32. Any of ADC_CFGR2_ROVSE (regular group),
+ * ADC_CFGR2_JOVSE (injected group), ADC_CFGR2_TROVS (each conversion of a
+ * regular oversampling run needs its own trigger) and ADC_CFGR2_ROVSM (an
+ * injected conversion interrupting regular oversampling restarts it rather
+ * than resuming it)
+ */
+void adc_set_oversampling(uint32_t adc, uint32_t ratio, uint8_t shift,
+			  uint32_t mode)
+{
+	const uint32_t mask = ADC_CFGR2_ROVSE | ADC_CFGR2_JOVSE |
+			      ADC_CFGR2_OVSR_MASK | ADC_CFGR2_OVSS_MASK |
+			      ADC_CFGR2_TROVS | ADC_CFGR2_ROVSM;
+
+	ADC_CFGR2(adc) = (ADC_CFGR2(adc) & ~mask) |
+			 (ratio & ADC_CFGR2_OVSR_MASK) |
+			 ADC_CFGR2_OVSS_VAL(shift & 0xf) |
+			 (mode & (ADC_CFGR2_ROVSE | ADC_CFGR2_JOVSE |
+				  ADC_CFGR2_TROVS | ADC_CFGR2_ROVSM));
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Disable Hardware Oversampling
+ *
+ * @param[in] adc Unsigned int32. ADC block register address base @ref
+ * adc_reg_base
+ */
+void adc_disable_oversampling(uint32_t adc)
+{
+	ADC_CFGR2(adc) &= ~(ADC_CFGR2_ROVSE | ADC_CFGR2_JOVSE);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Enable Bulb Sampling Mode
+ *
+ * The sampling period starts right after the previous conversion ends, so
+ * that the trigger only ends the sampling and starts the conversion. This
+ * gives long sampling times without delaying the conversion after a trigger.
+ * Only valid with external triggers and not in continuous mode.
+ *
+ * @param[in] adc Unsigned int32. ADC block register address base @ref
+ * adc_reg_base
+ */
+void adc_enable_bulb_sampling(uint32_t adc)
+{
+	ADC_CFGR2(adc) |= ADC_CFGR2_BULB;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Disable Bulb Sampling Mode
+ *
+ * @param[in] adc Unsigned int32. ADC block register address base @ref
+ * adc_reg_base
+ */
+void adc_disable_bulb_sampling(uint32_t adc)
+{
+	ADC_CFGR2(adc) &= ~ADC_CFGR2_BULB;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Enable Sampling Time Control Trigger Mode
+ *
+ * The trigger edge starts the sampling and the opposite edge ends it, so the
+ * sampling time follows the trigger pulse width.
+ *
+ * @param[in] adc Unsigned int32. ADC block register address base @ref
+ * adc_reg_base
+ */
+void adc_enable_sampling_trigger_mode(uint32_t adc)
+{
+	ADC_CFGR2(adc) |= ADC_CFGR2_SMPTRIG;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Disable Sampling Time Control Trigger Mode
+ *
+ * @param[in] adc Unsigned int32. ADC block register address base @ref
+ * adc_reg_base
+ */
+void adc_disable_sampling_trigger_mode(uint32_t adc)
+{
+	ADC_CFGR2(adc) &= ~ADC_CFGR2_SMPTRIG;
+}
+
+static void adc_stop_injected(uint32_t adc)
+{
+	if (ADC_CR(adc) & ADC_CR_JADSTART) {
+		ADC_CR(adc) |= ADC_CR_JADSTP;
+		while (ADC_CR(adc) & ADC_CR_JADSTART);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Start a Triggered Injected Scan
+ *
+ * The sequence, trigger and polarity are written to JSQR in one access (with
+ * the queue enabled every write is a new context) and the injected group is
+ * armed. From then on every trigger, typically a timer TRGO or compare event
+ * placed in the middle of a PWM period, converts the sequence, and
+ * adc_injected_scan_isr() collects the results at the end of the sequence.
+ * With injected oversampling enabled only the filtered results are reported.
+ *
+ * The ADC must be enabled. The application calls adc_injected_scan_isr()
+ * from the ADC interrupt handler and enables it in the NVIC.
+ *
+ * @param[in] scan Scan setup
+ * @returns false if the setup is invalid.
+ */
+bool adc_injected_scan_start(struct adc_injected_scan *scan)
+{
+	uint32_t adc = scan->adc;
+	uint32_t jsqr;
+
+	if (scan->length < 1 || scan->length > ADC_JSQR_MAX_CHANNELS ||
+	    !(scan->polarity & ADC_JSQR_JEXTEN_MASK)) {
+		return false;
+	}
+
+	adc_stop_injected(adc);
+
+	jsqr = ADC_JSQR_JL_VAL(scan->length) |
+	       (scan->trigger & ADC_JSQR_JEXTSEL_MASK) |
+	       (scan->polarity & ADC_JSQR_JEXTEN_MASK);
+	for (unsigned i = 0; i < scan->length; i++) {
+		jsqr |= ADC_JSQR_JSQ_VAL(i + 1, scan->channels[i] & 0x1f);
+	}
+	ADC_JSQR(adc) = jsqr;
+
+	ADC_ISR(adc) = ADC_ISR_JEOC | ADC_ISR_JEOS | ADC_ISR_JQOVF;
+	ADC_IER(adc) |= ADC_IER_JEOSIE | ADC_IER_JQOVFIE;
+	ADC_CR(adc) |= ADC_CR_JADSTART;
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Stop a Triggered Injected Scan
+ *
+ * @param[in] scan Scan setup
+ */
+void adc_injected_scan_stop(struct adc_injected_scan *scan)
+{
+	adc_stop_injected(scan->adc);
+	ADC_IER(scan->adc) &= ~(ADC_IER_JEOSIE | ADC_IER_JQOVFIE);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief ADC Injected Scan Interrupt Handler
+ *
+ * Call this from the ADC interrupt for each scan running on an ADC sharing
+ * the interrupt. Only the injected flags are handled and cleared.
+ *
+ * @param[in] scan Scan setup
+ */
+void adc_injected_scan_isr(struct adc_injected_scan *scan)
+{
+	uint32_t adc = scan->adc;
+	uint32_t isr = ADC_ISR(adc) & ADC_IER(adc);
+
+	if (isr & ADC_ISR_JQOVF) {
+		ADC_ISR(adc) = ADC_ISR_JQOVF;
+		scan->overflows++;
+	}
+	if (!(isr & ADC_ISR_JEOS)) {
+		return;
+	}
+
+	for (unsigned i = 0; i < scan->length; i++) {
+		scan->results[i] = (&ADC_JDR1(adc))[i];
+	}
+	ADC_ISR(adc) = ADC_ISR_JEOC | ADC_ISR_JEOS;
+	scan->sequences++;
+	if (scan->done) {
+		scan->done(scan, scan->results);
+	}
+}
+
 /**@}*/
 
 
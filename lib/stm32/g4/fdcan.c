@@ -81,6 +81,47 @@ unsigned fdcan_get_txbuf_element_size(uint32_t canport)
 	return sizeof(struct fdcan_tx_buffer_element);
 }
 
+/** Returns number of elements of receive FIFO.
+ *
+ * On STM32G4 message RAM layout is fixed, each FIFO has three elements.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] fifo_id ID of FIFO whose size is queried.
+ * @returns Number of elements of FIFO.
+ */
+unsigned fdcan_get_fifo_size(uint32_t canport, unsigned fifo_id)
+{
+	(void) (canport);
+	(void) (fifo_id);
+	return 3;
+}
+
+/** Returns index of first transmit FIFO/queue element.
+ *
+ * STM32G4 has no dedicated transmit buffers, Tx FIFO/queue starts at element 0.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @returns Index of first Tx FIFO/queue element.
+ */
+unsigned fdcan_get_txfifo_start(uint32_t canport)
+{
+	(void) (canport);
+	return 0;
+}
+
+/** Returns number of elements of transmit FIFO/queue.
+ *
+ * On STM32G4 message RAM layout is fixed, Tx FIFO/queue has three elements.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @returns Number of Tx FIFO/queue elements.
+ */
+unsigned fdcan_get_txfifo_size(uint32_t canport)
+{
+	(void) (canport);
+	return 3;
+}
+
 /** Configure amount of filters and initialize filtering block.
  *
  * This function allows to configure global amount of filters present.
@@ -42,7 +42,9 @@
 
 /**@{*/
 
+#include <string.h>
 #include <libopencm3/stm32/flash.h>
+#include "../common/flash_async_private.h"
 
 /** @brief Wait until Last Operation has Ended
  * This loops indefinitely until an operation (write or erase) has completed
@@ -138,19 +140,16 @@ void flash_program_double_word(uint32_t address, uint64_t data)
 	FLASH_CR &= ~FLASH_CR_PG;
 }
 
-/** @brief Program a Data Block to FLASH
- * This programs an arbitrary length data block to FLASH memory.
- * The program error flag should be checked separately for the event that
- * memory was not properly erased.
- * @param[in] address Starting address in Flash.
- * @param[in] data Pointer to start of data block.
- * @param[in] len Length of data block in bytes (multiple of 8).
- */
-void flash_program(uint32_t address, uint8_t *data, uint32_t len)
+static void flash_erase_page_start(uint32_t page)
 {
-	for (uint32_t i = 0; i < len; i += 8) {
-		flash_program_double_word(address+i, *(uint64_t*)(data + i));
+	/* page and bank are contiguous bits */
+	FLASH_CR &= ~((FLASH_CR_PNB_MASK << FLASH_CR_PNB_SHIFT) | FLASH_CR_BKER);
+	if (page > 255)	{
+		FLASH_CR |= FLASH_CR_BKER;
 	}
+	FLASH_CR |= page << FLASH_CR_PNB_SHIFT;
+	FLASH_CR |= FLASH_CR_PER;
+	FLASH_CR |= FLASH_CR_START;
 }
 
 /** @brief Erase a page of FLASH
@@ -159,15 +158,7 @@ void flash_program(uint32_t address, uint8_t *data, uint32_t len)
 void flash_erase_page(uint32_t page)
 {
 	flash_wait_for_last_operation();
-
-	/* page and bank are contiguous bits */
-	FLASH_CR &= ~((FLASH_CR_PNB_MASK << FLASH_CR_PNB_SHIFT) | FLASH_CR_BKER);
-	if (page > 255)	{
-		FLASH_CR |= FLASH_CR_BKER;
-	}
-	FLASH_CR |= page << FLASH_CR_PNB_SHIFT;
-	FLASH_CR |= FLASH_CR_PER;
-	FLASH_CR |= FLASH_CR_START;
+	flash_erase_page_start(page);
 
 	flash_wait_for_last_operation();
 	FLASH_CR &= ~FLASH_CR_PER;
@@ -205,5 +196,73 @@ void flash_program_option_bytes(uint32_t data)
 	FLASH_CR |= FLASH_CR_OPTSTRT;
 	flash_wait_for_last_operation();
 }
-/**@}*/
+/* Interrupt driven jobs, see flash_common_async.c. There is one controller,
+ * so a single queue; programming goes one double word at a time, the last
+ * one padded with 0xff when the job length is not a multiple of 8. With
+ * DBANK set the application can keep running from the other bank.
+ */
 
+unsigned _flash_async_lane(const struct flash_job *job)
+{
+	(void)job;
+	return 0;
+}
+
+uint32_t _flash_async_step(unsigned lane, struct flash_job *job)
+{
+	uint32_t errors;
+
+	(void)lane;
+	FLASH_SR = FLASH_SR_PROGRAM_ERRORS | FLASH_SR_EOP;
+	FLASH_CR &= ~(FLASH_CR_PER | FLASH_CR_PG);
+	FLASH_CR |= FLASH_CR_EOPIE | FLASH_CR_ERRIE;
+
+	if (job->type == FLASH_JOB_ERASE) {
+		flash_erase_page_start(job->sector);
+		job->done = 1;
+	} else {
+		uint32_t address = job->address + job->done;
+		uint32_t amount = job->len - job->done;
+		uint32_t dword[2] = { 0xffffffff, 0xffffffff };
+
+		if (amount > 8) {
+			amount = 8;
+		}
+		/* A short tail is padded with the erased value. */
+		memcpy(dword, job->data + job->done, amount);
+		FLASH_CR |= FLASH_CR_PG;
+		MMIO32(address) = dword[0];
+		MMIO32(address + 4) = dword[1];
+		job->done += amount;
+	}
+
+	/* Sequence, size and alignment errors are flagged right away and
+	 * raise no interrupt, so report them here. */
+	errors = FLASH_SR & FLASH_SR_PROGRAM_ERRORS;
+	FLASH_SR = errors;
+	return errors;
+}
+
+void _flash_async_idle(unsigned lane)
+{
+	(void)lane;
+	FLASH_CR &= ~(FLASH_CR_EOPIE | FLASH_CR_ERRIE | FLASH_CR_PG |
+		      FLASH_CR_PER);
+}
+
+/** @brief Flash Job Interrupt Handler
+ * Call this from flash_isr() when using @ref flash_async_submit.
+ */
+void flash_async_isr(void)
+{
+	uint32_t sr = FLASH_SR;
+	uint32_t errors = sr & FLASH_SR_PROGRAM_ERRORS;
+
+	if (!(sr & FLASH_SR_EOP) && !errors) {
+		return;
+	}
+	FLASH_SR = errors | FLASH_SR_EOP;
+	_flash_async_complete(0, errors);
+}
+
+/**@}*/
@@ -98,6 +98,40 @@ unsigned fdcan_get_txbuf_element_size(uint32_t canport)
 	return 8 + fdcan_dlc_to_length((element_size & FDCAN_TXESC_TBDS_MASK) | 0x8);
 }
 
+/** Returns number of elements of receive FIFO.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] fifo_id ID of FIFO whose size is queried.
+ * @returns Number of elements of FIFO, as configured in message RAM.
+ */
+unsigned fdcan_get_fifo_size(uint32_t canport, unsigned fifo_id)
+{
+	return (FDCAN_RXFIC(canport, fifo_id) >> FDCAN_RXFIC_FIS_SHIFT)
+		& FDCAN_RXFIC_FIS_MASK;
+}
+
+/** Returns index of first transmit FIFO/queue element.
+ *
+ * Tx FIFO/queue elements follow dedicated transmit buffers, if any.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @returns Index of first Tx FIFO/queue element.
+ */
+unsigned fdcan_get_txfifo_start(uint32_t canport)
+{
+	return (FDCAN_TXBC(canport) >> FDCAN_TXBC_NDTB_SHIFT) & FDCAN_TXBC_NDTB_MASK;
+}
+
+/** Returns number of elements of transmit FIFO/queue.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @returns Number of Tx FIFO/queue elements, as configured in message RAM.
+ */
+unsigned fdcan_get_txfifo_size(uint32_t canport)
+{
+	return (FDCAN_TXBC(canport) >> FDCAN_TXBC_TFQS_SHIFT) & FDCAN_TXBC_TFQS_MASK;
+}
+
 /** Initialize allocation of standard filter block in CAN message RAM.
  *
  * Allows specifying size of standard filtering block (in term of available filtering
@@ -277,6 +311,201 @@ int fdcan_set_tx_element_size(uint32_t canport, uint8_t txbuf)
 	return FDCAN_E_OK;
 }
 
+/** Size of Rx FIFO or Tx buffer element in message RAM words.
+ *
+ * @param [in] data_size payload size stored per element, a valid frame length
+ * @returns Element size in words, or 0 if data_size is not a valid length.
+ */
+static unsigned fdcan_ram_element_words(uint8_t data_size)
+{
+	uint32_t dlc = fdcan_length_to_dlc(data_size);
+
+	if (dlc == 0xFF) {
+		return 0;
+	}
+
+	if (dlc < 8) {
+		dlc = 8;
+	}
+
+	return 2 + fdcan_dlc_to_length(dlc) / 4;
+}
+
+/** Plan allocation of message RAM for one FDCAN block.
+ *
+ * Checks that the requested sections fit into given amount of message RAM.
+ * Rx FIFOs and Tx FIFO/queue requested as @ref FDCAN_RAM_AUTO then share
+ * the space left over, one element at a time, up to their hardware limits.
+ * This way a block can use all of its part of message RAM for deep FIFOs,
+ * which keeps fast CAN-FD traffic from overrunning them.
+ *
+ * H7 message RAM has @ref FDCAN_RAM_WORDS words, which are shared by all
+ * FDCAN blocks. To split it between two blocks, plan each of them with half
+ * of it, or the first one with the space it needs and the second one with
+ * the rest.
+ *
+ * @param [in,out] cfg requested allocation. Automatic sizes are replaced with
+ *				sizes computed.
+ * @param [in] words amount of message RAM available, in 32bit words
+ * @returns Amount of message RAM used in words, or error code if requested
+ * allocation doesn't fit or is invalid. See @ref fdcan_error.
+ */
+int fdcan_plan_ram(struct fdcan_ram_config *cfg, unsigned words)
+{
+	unsigned rx_words = fdcan_ram_element_words(cfg->rx_data_size);
+	unsigned tx_words = fdcan_ram_element_words(cfg->tx_data_size);
+	bool rx_auto[2] = { false, false };
+	bool tx_auto = false;
+	unsigned used, left;
+	bool grown;
+
+	if (rx_words == 0 || tx_words == 0) {
+		return FDCAN_E_INVALID;
+	}
+
+	if (cfg->std_filters > FDCAN_RAM_STD_FILTERS_MAX
+		|| cfg->ext_filters > FDCAN_RAM_EXT_FILTERS_MAX
+		|| cfg->tx_events > FDCAN_RAM_TX_EVENTS_MAX) {
+		return FDCAN_E_OUTOFRANGE;
+	}
+
+	used = cfg->std_filters * sizeof(struct fdcan_standard_filter) / 4
+		+ cfg->ext_filters * sizeof(struct fdcan_extended_filter) / 4
+		+ cfg->tx_events * sizeof(struct fdcan_tx_event_element) / 4;
+
+	for (unsigned fifo_id = 0; fifo_id < 2; fifo_id++) {
+		if (cfg->rx_fifo[fifo_id] == FDCAN_RAM_AUTO) {
+			rx_auto[fifo_id] = true;
+			cfg->rx_fifo[fifo_id] = 0;
+		} else if (cfg->rx_fifo[fifo_id] > FDCAN_RAM_RX_FIFO_MAX) {
+			return FDCAN_E_OUTOFRANGE;
+		}
+		used += cfg->rx_fifo[fifo_id] * rx_words;
+	}
+
+	if (cfg->tx_fifo == FDCAN_RAM_AUTO) {
+		tx_auto = true;
+		cfg->tx_fifo = 0;
+	} else if (cfg->tx_fifo > FDCAN_RAM_TX_FIFO_MAX) {
+		return FDCAN_E_OUTOFRANGE;
+	}
+	used += cfg->tx_fifo * tx_words;
+
+	if (used > words) {
+		return FDCAN_E_OUTOFRANGE;
+	}
+	left = words - used;
+
+	/* Hand out the rest round robin, so that automatic sections grow
+	 * evenly until space or their limits are exhausted. */
+	do {
+		grown = false;
+		for (unsigned fifo_id = 0; fifo_id < 2; fifo_id++) {
+			if (rx_auto[fifo_id] && left >= rx_words
+				&& cfg->rx_fifo[fifo_id] < FDCAN_RAM_RX_FIFO_MAX) {
+				cfg->rx_fifo[fifo_id]++;
+				left -= rx_words;
+				grown = true;
+			}
+		}
+		if (tx_auto && left >= tx_words
+			&& cfg->tx_fifo < FDCAN_RAM_TX_FIFO_MAX) {
+			cfg->tx_fifo++;
+			left -= tx_words;
+			grown = true;
+		}
+	} while (grown);
+
+	return words - left;
+}
+
+/** Allocate message RAM for one FDCAN block.
+ *
+ * Programs a complete message RAM layout of FDCAN block starting at given
+ * offset: standard and extended filters, both Rx FIFOs, Tx event FIFO and
+ * Tx FIFO/queue, in this order and without gaps, along with element sizes.
+ * Dedicated Rx and Tx buffers are not used. Filter lists are cleared.
+ * This function can only be called while FDCAN block is in INIT mode, use it
+ * in place of @ref fdcan_init_filter. Sizes shall be resolved using
+ * @ref fdcan_plan_ram beforehand.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] cfg allocation to program
+ * @param [in] offset start of allocation in message RAM, in bytes
+ * @returns Offset of first byte of message RAM following the allocation,
+ * which is where allocation of another FDCAN block may start, or error
+ * code. See @ref fdcan_error.
+ */
+int fdcan_init_ram(uint32_t canport, const struct fdcan_ram_config *cfg,
+		uint32_t offset)
+{
+	unsigned rx_words = fdcan_ram_element_words(cfg->rx_data_size);
+	unsigned tx_words = fdcan_ram_element_words(cfg->tx_data_size);
+	struct fdcan_standard_filter *lfssa;
+	struct fdcan_extended_filter *lfesa;
+	unsigned words;
+
+	if (rx_words == 0 || tx_words == 0 || (offset % 4) != 0) {
+		return FDCAN_E_INVALID;
+	}
+
+	if (cfg->std_filters > FDCAN_RAM_STD_FILTERS_MAX
+		|| cfg->ext_filters > FDCAN_RAM_EXT_FILTERS_MAX
+		|| cfg->rx_fifo[0] > FDCAN_RAM_RX_FIFO_MAX
+		|| cfg->rx_fifo[1] > FDCAN_RAM_RX_FIFO_MAX
+		|| cfg->tx_events > FDCAN_RAM_TX_EVENTS_MAX
+		|| cfg->tx_fifo > FDCAN_RAM_TX_FIFO_MAX) {
+		return FDCAN_E_OUTOFRANGE;
+	}
+
+	words = cfg->std_filters * sizeof(struct fdcan_standard_filter) / 4
+		+ cfg->ext_filters * sizeof(struct fdcan_extended_filter) / 4
+		+ (cfg->rx_fifo[0] + cfg->rx_fifo[1]) * rx_words
+		+ cfg->tx_events * sizeof(struct fdcan_tx_event_element) / 4
+		+ cfg->tx_fifo * tx_words;
+
+	if (offset + words * 4 > CAN_MSG_SIZE) {
+		return FDCAN_E_OUTOFRANGE;
+	}
+
+	fdcan_set_rx_element_size(canport, 0, cfg->rx_data_size, cfg->rx_data_size);
+	fdcan_set_tx_element_size(canport, cfg->tx_data_size);
+
+	/* Filter list start addresses are passed in words, start addresses
+	 * of other sections in bytes. */
+	fdcan_init_std_filter_ram(canport, offset / 4, cfg->std_filters);
+	offset += cfg->std_filters * sizeof(struct fdcan_standard_filter);
+
+	fdcan_init_ext_filter_ram(canport, offset / 4, cfg->ext_filters);
+	offset += cfg->ext_filters * sizeof(struct fdcan_extended_filter);
+
+	for (unsigned fifo_id = 0; fifo_id < 2; fifo_id++) {
+		fdcan_init_fifo_ram(canport, fifo_id, offset, cfg->rx_fifo[fifo_id]);
+		offset += cfg->rx_fifo[fifo_id] * rx_words * 4;
+	}
+
+	fdcan_init_tx_event_ram(canport, offset, cfg->tx_events);
+	offset += cfg->tx_events * sizeof(struct fdcan_tx_event_element);
+
+	FDCAN_TXBC(canport) &= ~(FDCAN_TXBC_NDTB_MASK << FDCAN_TXBC_NDTB_SHIFT);
+	fdcan_init_tx_buffer_ram(canport, offset, cfg->tx_fifo);
+	offset += cfg->tx_fifo * tx_words * 4;
+
+	lfssa = fdcan_get_flssa_addr(canport);
+	lfesa = fdcan_get_flesa_addr(canport);
+
+	for (int q = 0; q < cfg->std_filters; ++q) {
+		lfssa[q].type_id1_conf_id2 = 0;
+	}
+
+	for (int q = 0; q < cfg->ext_filters; ++q) {
+		lfesa[q].conf_id1 = 0;
+		lfesa[q].type_id2 = 0;
+	}
+
+	return offset;
+}
+
 /** Configure amount of filters and initialize filtering block.
  *
  * This function allows to configure global amount of filters present.
@@ -25,6 +25,7 @@
 
 #include <string.h>
 #include <libopencm3/stm32/flash.h>
+#include "../common/flash_async_private.h"
 
 #define REBASE(x)        MMIO32((x) + (bank_base_address))
 #define MIN(x, y)         ((x) < (y) ? (x) : (y))
@@ -338,3 +339,68 @@ void flash_lock_option_bytes(void)
 {
 	FLASH_OPTCR |= FLASH_OPTCR_OPTLOCK;
 }
+
+/*
+ * Interrupt driven jobs, see flash_common_async.c. Each bank has its own
+ * controller, so each gets its own queue and both can run at once.
+ */
+
+#define FLASH_SR_PROGRAM_ERROR_MASK (FLASH_SR_WRPERR | FLASH_SR_PGSERR | \
+		FLASH_SR_STRBERR | FLASH_SR_INCERR | FLASH_SR_OPERR)
+#define FLASH_CR_ASYNC_IE_MASK (FLASH_CR_EOPIE | FLASH_CR_WRPERRIE | \
+		FLASH_CR_PGSERRIE | FLASH_CR_STRBERRIE | FLASH_CR_INCERRIE | \
+		FLASH_CR_OPERRIE)
+
+unsigned _flash_async_lane(const struct flash_job *const job)
+{
+	return flash_bank_from_address(job->address) - FLASH_BANK_1;
+}
+
+uint32_t _flash_async_step(const unsigned lane, struct flash_job *const job)
+{
+	const enum flash_bank bank = FLASH_BANK_1 + lane;
+	const uintptr_t bank_base_address = flash_bank_address(bank);
+
+	REBASE(FLASH_CCR) = FLASH_SR_PROGRAM_ERROR_MASK | FLASH_SR_EOP;
+	REBASE(FLASH_CR) |= FLASH_CR_ASYNC_IE_MASK;
+
+	if (job->type == FLASH_JOB_ERASE) {
+		flash_erase_sector(bank, job->sector, FLASH_CR_PROGRAM_X64);
+		job->done = 1;
+	} else {
+		/* One flash word per operation, forcing out a partial one */
+		const uintptr_t address = job->address + job->done;
+		const size_t offset = address & FLASH_WRITE_BLOCK_MASK;
+		const size_t amount = MIN(job->len - job->done, FLASH_WRITE_BLOCK_SIZE - offset);
+		if (!(REBASE(FLASH_CR) & FLASH_CR_PG))
+			flash_program_enable(bank, FLASH_CR_PROGRAM_X64);
+		memcpy((void *)address, job->data + job->done, amount);
+		if (offset + amount != FLASH_WRITE_BLOCK_SIZE)
+			flash_program_force(bank);
+		job->done += amount;
+	}
+
+	/* Sequence and protection errors show up straight away */
+	const uint32_t errors = REBASE(FLASH_SR) & (FLASH_SR_PROGRAM_ERROR_MASK & ~FLASH_SR_OPERR);
+	REBASE(FLASH_CCR) = errors;
+	return errors;
+}
+
+void _flash_async_idle(const unsigned lane)
+{
+	const uintptr_t bank_base_address = flash_bank_address(FLASH_BANK_1 + lane);
+	REBASE(FLASH_CR) &= ~(FLASH_CR_ASYNC_IE_MASK | FLASH_CR_PG | FLASH_CR_SER);
+}
+
+void flash_async_isr(void)
+{
+	for (unsigned lane = 0; lane < FLASH_ASYNC_LANES; ++lane) {
+		const uintptr_t bank_base_address = flash_bank_address(FLASH_BANK_1 + lane);
+		const uint32_t status = REBASE(FLASH_SR);
+		const uint32_t errors = status & FLASH_SR_PROGRAM_ERROR_MASK;
+		if (!(status & FLASH_SR_EOP) && !errors)
+			continue;
+		REBASE(FLASH_CCR) = errors | FLASH_SR_EOP;
+		_flash_async_complete(lane, errors);
+	}
+}
@@ -52,5 +52,41 @@ void adc_disable_regulator(uint32_t adc)
 	ADC_CR(adc) &= ~ADC_CR_ADVREGEN;
 }
 
+/**
+ * Set up hardware oversampling.
+ * The converter accumulates ratio conversions and shifts the sum right by
+ * shift bits, so only the averaged result reaches the data registers. Must be
+ * done while no regular or injected conversion is ongoing.
+ * @param[in] adc ADC block register address base
+ * @param[in] ratio ADC_CFGR2_OVSR_2x ... ADC_CFGR2_OVSR_256x
+ * @param[in] shift Right shift of the sum, 0 ... 8
+ * @param[in] mode Any of ADC_CFGR2_ROVSE, ADC_CFGR2_JOVSE, ADC_CFGR2_TROVS
+ * and ADC_CFGR2_ROVSM
+ * @sa adc_disable_oversampling
+ */
+void adc_set_oversampling(uint32_t adc, uint32_t ratio, uint8_t shift,
+			  uint32_t mode)
+{
+	const uint32_t mask = ADC_CFGR2_ROVSE | ADC_CFGR2_JOVSE |
+			      ADC_CFGR2_OVSR_MASK | ADC_CFGR2_OVSS_MASK |
+			      ADC_CFGR2_TROVS | ADC_CFGR2_ROVSM;
+
+	ADC_CFGR2(adc) = (ADC_CFGR2(adc) & ~mask) |
+			 (ratio & ADC_CFGR2_OVSR_MASK) |
+			 ADC_CFGR2_OVSS_VAL(shift & 0xf) |
+			 (mode & (ADC_CFGR2_ROVSE | ADC_CFGR2_JOVSE |
+				  ADC_CFGR2_TROVS | ADC_CFGR2_ROVSM));
+}
+
+/**
+ * Disable hardware oversampling for both groups.
+ * @param[in] adc ADC block register address base
+ * @sa adc_set_oversampling
+ */
+void adc_disable_oversampling(uint32_t adc)
+{
+	ADC_CFGR2(adc) &= ~(ADC_CFGR2_ROVSE | ADC_CFGR2_JOVSE);
+}
+
 /**@}*/
 
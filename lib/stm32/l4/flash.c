@@ -136,21 +136,6 @@ void flash_program_double_word(uint32_t address, uint64_t data)
 	FLASH_CR &= ~FLASH_CR_PG;
 }
 
-/** @brief Program a Data Block to FLASH
- * This programs an arbitrary length data block to FLASH memory.
- * The program error flag should be checked separately for the event that
- * memory was not properly erased.
- * @param[in] address Starting address in Flash.
- * @param[in] data Pointer to start of data block.
- * @param[in] len Length of data block in bytes (multiple of 8).
- */
-void flash_program(uint32_t address, uint8_t *data, uint32_t len)
-{
-	for (uint32_t i = 0; i < len; i += 8) {
-		flash_program_double_word(address+i, *(uint64_t*)(data + i));
-	}
-}
-
 /** @brief Erase a page of FLASH
  * @param[in] page (0 - 255 for bank 1, 256-511 for bank 2)
  */
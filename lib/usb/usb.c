@@ -175,4 +175,14 @@ void usbd_ep_nak_set(usbd_device *usbd_dev, uint8_t addr, uint8_t nak)
 	usbd_dev->driver->ep_nak_set(usbd_dev, addr, nak);
 }
 
+uint16_t usbd_fifo_mem_unused(usbd_device *usbd_dev)
+{
+	const uint16_t mem_size = usbd_dev->driver->fifo_mem_size;
+
+	if (usbd_dev->fifo_mem_top >= mem_size) {
+		return 0;
+	}
+	return (mem_size - usbd_dev->fifo_mem_top) * 4U;
+}
+
 /**@}*/
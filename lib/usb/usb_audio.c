@@ -15,6 +15,186 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <libopencm3/usb/audio.h>
 
-/* This stub exists just to trick doxygen. */
+/* Largest isochronous packet a full or high speed endpoint can carry */
+#define USB_AUDIO_MAX_PACKET 1024U
+
+void usb_audio_stream_init(struct usb_audio_stream *stream, usbd_device *usbd_dev,
+			   uint8_t ep, uint16_t max_packet, uint32_t rate,
+			   uint8_t frame_size, bool high_speed,
+			   uint8_t *buf, uint32_t buf_size)
+{
+	stream->usbd_dev = usbd_dev;
+	stream->ep = ep;
+	stream->frame_size = frame_size;
+	stream->max_packet = max_packet < USB_AUDIO_MAX_PACKET ? max_packet : USB_AUDIO_MAX_PACKET;
+	stream->interval_rate = high_speed ? 8000 : 1000;
+	stream->rate = rate;
+	stream->rate_accum = 0;
+	stream->buf = buf;
+	stream->buf_size = buf_size;
+	stream->head = 0;
+	stream->tail = 0;
+	stream->overruns = 0;
+	stream->underruns = 0;
+}
+
+uint32_t usb_audio_stream_level(const struct usb_audio_stream *stream)
+{
+	return stream->head - stream->tail;
+}
+
+/* Copy into the ring at the head, the caller has checked there is room */
+static void usb_audio_ring_put(struct usb_audio_stream *stream, const uint8_t *data, uint32_t len)
+{
+	const uint32_t mask = stream->buf_size - 1;
+	const uint32_t offset = stream->head & mask;
+	const uint32_t first = stream->buf_size - offset < len ? stream->buf_size - offset : len;
+
+	memcpy(stream->buf + offset, data, first);
+	memcpy(stream->buf, data + first, len - first);
+	stream->head += len;
+}
+
+/* Copy out of the ring at the tail, the caller has checked the data is there */
+static void usb_audio_ring_get(struct usb_audio_stream *stream, uint8_t *data, uint32_t len)
+{
+	const uint32_t mask = stream->buf_size - 1;
+	const uint32_t offset = stream->tail & mask;
+	const uint32_t first = stream->buf_size - offset < len ? stream->buf_size - offset : len;
+
+	memcpy(data, stream->buf + offset, first);
+	memcpy(data + first, stream->buf, len - first);
+	stream->tail += len;
+}
+
+void usb_audio_stream_rx(struct usb_audio_stream *stream)
+{
+	uint32_t packet[USB_AUDIO_MAX_PACKET / 4];
+	uint16_t len = usbd_ep_read_packet(stream->usbd_dev, stream->ep, packet, stream->max_packet);
+	const uint32_t space = stream->buf_size - usb_audio_stream_level(stream);
+
+	/* Only ever store whole audio frames */
+	len -= len % stream->frame_size;
+	if (len > space) {
+		stream->overruns += len;
+		return;
+	}
+	usb_audio_ring_put(stream, (const uint8_t *)packet, len);
+}
+
+void usb_audio_stream_tx(struct usb_audio_stream *stream)
+{
+	uint32_t packet[USB_AUDIO_MAX_PACKET / 4];
+	const uint32_t level = usb_audio_stream_level(stream);
+
+	/* Nominal frames for this (micro)frame, carrying the fractional part over */
+	stream->rate_accum += stream->rate;
+	uint32_t frames = stream->rate_accum / stream->interval_rate;
+	stream->rate_accum -= frames * stream->interval_rate;
+
+	/* Nudge by a frame to keep the ring around half full */
+	if (level > (stream->buf_size / 4) * 3) {
+		frames++;
+	} else if (level < stream->buf_size / 4 && frames) {
+		frames--;
+	}
+
+	uint32_t len = frames * stream->frame_size;
+	if (len > stream->max_packet) {
+		len = stream->max_packet - stream->max_packet % stream->frame_size;
+	}
+	if (len > level) {
+		stream->underruns++;
+		len = level - level % stream->frame_size;
+	}
+
+	usb_audio_ring_get(stream, (uint8_t *)packet, len);
+	if (!usbd_ep_write_packet(stream->usbd_dev, stream->ep, packet, len) && len) {
+		/* Endpoint still busy with the previous packet, keep the data */
+		stream->tail -= len;
+	}
+}
+
+uint32_t usb_audio_stream_write(struct usb_audio_stream *stream, const void *data, uint32_t len)
+{
+	const uint32_t space = stream->buf_size - usb_audio_stream_level(stream);
+
+	if (len > space) {
+		len = space;
+	}
+	usb_audio_ring_put(stream, data, len);
+	return len;
+}
+
+uint32_t usb_audio_stream_read(struct usb_audio_stream *stream, void *data, uint32_t len)
+{
+	const uint32_t level = usb_audio_stream_level(stream);
+
+	if (len > level) {
+		len = level;
+	}
+	usb_audio_ring_get(stream, data, len);
+	return len;
+}
+
+void usb_audio_feedback_init(struct usb_audio_feedback *fb, usbd_device *usbd_dev,
+			     uint8_t ep, enum usb_audio_feedback_format format,
+			     uint8_t refresh, uint32_t rate)
+{
+	fb->usbd_dev = usbd_dev;
+	fb->ep = ep;
+	fb->format = format;
+	/* The frame count is shifted left by (fraction bits - refresh), and
+	 * the (micro)frame counter is 16 bits wide. */
+	if (format == USB_AUDIO_FEEDBACK_10_14 && refresh > 14) {
+		refresh = 14;
+	} else if (refresh > 15) {
+		refresh = 15;
+	}
+	fb->refresh = refresh;
+	fb->frames = 0;
+	fb->valid = false;
+	fb->last_count = 0;
+	/* Frames per frame in 10.14, or per microframe in 16.16 */
+	if (format == USB_AUDIO_FEEDBACK_10_14) {
+		fb->nominal = (rate << 14) / 1000;
+	} else {
+		fb->nominal = (rate << 13) / 1000;
+	}
+	fb->value = fb->nominal;
+}
+
+void usb_audio_feedback_sof(struct usb_audio_feedback *fb, uint32_t count)
+{
+	const uint8_t shift = fb->format == USB_AUDIO_FEEDBACK_10_14 ? 14 : 16;
+
+	if (!fb->valid) {
+		fb->last_count = count;
+		fb->frames = 0;
+		fb->valid = true;
+	} else if (++fb->frames >= (1U << fb->refresh)) {
+		/* Frames consumed over 2^refresh (micro)frames, scaled to the fixed point format */
+		uint32_t value = (count - fb->last_count) << (shift - fb->refresh);
+		/* Hosts reject values too far off nominal, keep within an eighth of it */
+		const uint32_t limit = fb->nominal / 8;
+		if (value > fb->nominal + limit) {
+			value = fb->nominal + limit;
+		} else if (value < fb->nominal - limit) {
+			value = fb->nominal - limit;
+		}
+		fb->value = value;
+		fb->last_count = count;
+		fb->frames = 0;
+	}
+
+	/* Little endian on the wire, 3 or 4 bytes depending on the format */
+	const uint8_t packet[4] = {
+		fb->value & 0xff, (fb->value >> 8) & 0xff,
+		(fb->value >> 16) & 0xff, (fb->value >> 24) & 0xff,
+	};
+	usbd_ep_write_packet(fb->usbd_dev, fb->ep, packet,
+			     fb->format == USB_AUDIO_FEEDBACK_10_14 ? 3 : 4);
+}
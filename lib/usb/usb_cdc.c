@@ -15,6 +15,431 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/usb/usbd.h>
 #include <libopencm3/usb/cdc.h>
+#include "usb_private.h"
 
-/* This stub exists just to trick doxygen. */
+/*
+ * CDC-ACM function driver.
+ *
+ * Data moves between the bulk endpoints and two ring buffers supplied by the
+ * application. Packets are written to and read from the rings in place,
+ * only a packet that wraps around the end of a ring is staged through a
+ * small bounce buffer. When the receive ring can no longer hold a full
+ * packet the OUT endpoint is set to NAK, so the host is throttled instead of
+ * data being dropped, and released again once the application has read
+ * enough.
+ */
+
+struct _usbd_cdcacm {
+	usbd_device *usbd_dev;
+	uint8_t comm_iface;
+	uint8_t ep_notif;
+	uint8_t ep_in;
+	uint8_t ep_out;
+	uint16_t ep_size;
+	bool configured;
+
+	uint8_t *tx_buf;
+	uint16_t tx_size;
+	volatile uint16_t tx_head;
+	volatile uint16_t tx_tail;
+	volatile bool tx_busy;
+	bool tx_zlp;
+	uint8_t tx_coalesce;
+	volatile uint8_t tx_age;
+
+	uint8_t *rx_buf;
+	uint16_t rx_size;
+	volatile uint16_t rx_head;
+	volatile uint16_t rx_tail;
+	volatile bool rx_throttled;
+
+	struct usb_cdc_line_coding line_coding;
+	uint16_t control_line_state;
+
+	void (*line_coding_cb)(usbd_cdcacm *acm,
+			       const struct usb_cdc_line_coding *coding);
+	void (*control_line_cb)(usbd_cdcacm *acm, uint16_t state);
+	void (*rx_cb)(usbd_cdcacm *acm);
+
+	uint8_t tx_bounce[USB_CDCACM_MAX_PACKET];
+	uint8_t rx_bounce[USB_CDCACM_MAX_PACKET];
+};
+
+static usbd_cdcacm _cdcacm;
+
+/* Start the next IN packet if the endpoint is idle. */
+static void cdcacm_tx_kick(usbd_cdcacm *acm, bool flush)
+{
+	if (!acm->configured || acm->tx_busy) {
+		return;
+	}
+
+	const uint16_t level = acm->tx_head - acm->tx_tail;
+	if (!level) {
+		/* A transfer ending on a full packet needs a ZLP to complete it on the host */
+		if (acm->tx_zlp) {
+			acm->tx_zlp = false;
+			acm->tx_busy = true;
+			usbd_ep_write_packet(acm->usbd_dev, acm->ep_in, NULL, 0);
+		}
+		return;
+	}
+
+	/* Hold back a partial packet while the coalescing timer runs */
+	if (level < acm->ep_size && !flush && acm->tx_age < acm->tx_coalesce) {
+		return;
+	}
+
+	const uint16_t len = MIN(level, acm->ep_size);
+	const uint16_t offset = acm->tx_tail & (acm->tx_size - 1);
+	const uint16_t contiguous = acm->tx_size - offset;
+	const uint8_t *packet = acm->tx_buf + offset;
+	if (contiguous < len) {
+		memcpy(acm->tx_bounce, packet, contiguous);
+		memcpy(acm->tx_bounce + contiguous, acm->tx_buf, len - contiguous);
+		packet = acm->tx_bounce;
+	}
+
+	if (usbd_ep_write_packet(acm->usbd_dev, acm->ep_in, packet, len)) {
+		acm->tx_tail += len;
+		acm->tx_busy = true;
+		acm->tx_zlp = len == acm->ep_size;
+		acm->tx_age = 0;
+	}
+}
+
+static void cdcacm_data_tx_cb(usbd_device *usbd_dev, uint8_t ep)
+{
+	(void)usbd_dev;
+	(void)ep;
+
+	_cdcacm.tx_busy = false;
+	cdcacm_tx_kick(&_cdcacm, false);
+}
+
+static void cdcacm_data_rx_cb(usbd_device *usbd_dev, uint8_t ep)
+{
+	usbd_cdcacm *acm = &_cdcacm;
+	const uint16_t offset = acm->rx_head & (acm->rx_size - 1);
+	const uint16_t contiguous = acm->rx_size - offset;
+	const uint16_t space = acm->rx_size - (uint16_t)(acm->rx_head - acm->rx_tail);
+	uint16_t len;
+
+	/* Throttle the host unless there is room for another full packet after
+	 * this one. This must happen before the read: on some cores reading the
+	 * packet re-arms the endpoint unless it is already set to NAK. */
+	if (space < 2 * acm->ep_size) {
+		acm->rx_throttled = true;
+		usbd_ep_nak_set(usbd_dev, ep, 1);
+	}
+
+	if (contiguous >= acm->ep_size && space >= acm->ep_size) {
+		len = usbd_ep_read_packet(usbd_dev, ep, acm->rx_buf + offset, acm->ep_size);
+	} else {
+		/* Never store more than there is room for */
+		len = MIN(usbd_ep_read_packet(usbd_dev, ep, acm->rx_bounce, acm->ep_size),
+			  space);
+		memcpy(acm->rx_buf + offset, acm->rx_bounce, MIN(len, contiguous));
+		if (len > contiguous) {
+			memcpy(acm->rx_buf, acm->rx_bounce + contiguous, len - contiguous);
+		}
+	}
+	acm->rx_head += len;
+
+	if (acm->rx_cb) {
+		acm->rx_cb(acm);
+	}
+}
+
+static void cdcacm_sof(void)
+{
+	usbd_cdcacm *acm = &_cdcacm;
+
+	if (acm->tx_head != acm->tx_tail && acm->tx_age < acm->tx_coalesce) {
+		acm->tx_age++;
+	}
+	cdcacm_tx_kick(acm, false);
+}
+
+static enum usbd_request_return_codes cdcacm_control_request(usbd_device *usbd_dev,
+	struct usb_setup_data *req, uint8_t **buf, uint16_t *len,
+	usbd_control_complete_callback *complete)
+{
+	usbd_cdcacm *acm = &_cdcacm;
+
+	(void)usbd_dev;
+	(void)complete;
+
+	if (req->wIndex != acm->comm_iface) {
+		return USBD_REQ_NEXT_CALLBACK;
+	}
+
+	switch (req->bRequest) {
+	case USB_CDC_REQ_SET_CONTROL_LINE_STATE:
+		acm->control_line_state = req->wValue;
+		if (acm->control_line_cb) {
+			acm->control_line_cb(acm, req->wValue);
+		}
+		return USBD_REQ_HANDLED;
+	case USB_CDC_REQ_SET_LINE_CODING:
+		if (*len < sizeof(struct usb_cdc_line_coding)) {
+			return USBD_REQ_NOTSUPP;
+		}
+		memcpy(&acm->line_coding, *buf, sizeof(struct usb_cdc_line_coding));
+		if (acm->line_coding_cb) {
+			acm->line_coding_cb(acm, &acm->line_coding);
+		}
+		return USBD_REQ_HANDLED;
+	case USB_CDC_REQ_GET_LINE_CODING:
+		*buf = (uint8_t *)&acm->line_coding;
+		*len = MIN(*len, sizeof(struct usb_cdc_line_coding));
+		return USBD_REQ_HANDLED;
+	}
+
+	return USBD_REQ_NOTSUPP;
+}
+
+static void cdcacm_set_config(usbd_device *usbd_dev, uint16_t wValue)
+{
+	usbd_cdcacm *acm = &_cdcacm;
+
+	acm->configured = wValue != 0;
+	acm->tx_head = acm->tx_tail = 0;
+	acm->rx_head = acm->rx_tail = 0;
+	acm->tx_busy = false;
+	acm->tx_zlp = false;
+	acm->tx_age = 0;
+	acm->rx_throttled = false;
+	if (!acm->configured) {
+		return;
+	}
+
+	usbd_ep_setup(usbd_dev, acm->ep_out, USB_ENDPOINT_ATTR_BULK,
+		      acm->ep_size, cdcacm_data_rx_cb);
+	usbd_ep_setup(usbd_dev, acm->ep_in, USB_ENDPOINT_ATTR_BULK,
+		      acm->ep_size, cdcacm_data_tx_cb);
+	usbd_ep_setup(usbd_dev, acm->ep_notif, USB_ENDPOINT_ATTR_INTERRUPT,
+		      16, NULL);
+
+	usbd_register_control_callback(
+				usbd_dev,
+				USB_REQ_TYPE_CLASS | USB_REQ_TYPE_INTERFACE,
+				USB_REQ_TYPE_TYPE | USB_REQ_TYPE_RECIPIENT,
+				cdcacm_control_request);
+}
+
+/** @addtogroup usb_cdc */
+/** @{ */
+
+/** @brief Initializes the USB CDC-ACM function.
+
+The endpoints are set up and the class requests handled from the set
+configuration callback, so this must be called before the host configures
+the device.
+
+@note Currently you can only have one CDC-ACM function active.
+
+@param[in] usbd_dev The USB device to associate the function with.
+@param[in] comm_iface Number of the communications class interface.
+@param[in] ep_notif The interrupt 'IN' endpoint for notifications.
+@param[in] ep_in The bulk 'IN' endpoint.
+@param[in] ep_out The bulk 'OUT' endpoint.
+@param[in] ep_size The bulk endpoint size, at most @ref USB_CDCACM_MAX_PACKET.
+@param[in] tx_buf Transmit ring buffer.
+@param[in] tx_buf_size Size of @a tx_buf, must be a power of two.
+@param[in] rx_buf Receive ring buffer.
+@param[in] rx_buf_size Size of @a rx_buf, must be a power of two and at least
+		@a ep_size.
+
+@return Pointer to the usbd_cdcacm struct.
+*/
+usbd_cdcacm *usb_cdcacm_init(usbd_device *usbd_dev, uint8_t comm_iface,
+			     uint8_t ep_notif, uint8_t ep_in, uint8_t ep_out,
+			     uint16_t ep_size,
+			     uint8_t *tx_buf, uint16_t tx_buf_size,
+			     uint8_t *rx_buf, uint16_t rx_buf_size)
+{
+	usbd_cdcacm *acm = &_cdcacm;
+
+	memset(acm, 0, sizeof(*acm));
+	acm->usbd_dev = usbd_dev;
+	acm->comm_iface = comm_iface;
+	acm->ep_notif = ep_notif;
+	acm->ep_in = ep_in;
+	acm->ep_out = ep_out;
+	acm->ep_size = MIN(ep_size, USB_CDCACM_MAX_PACKET);
+	acm->tx_buf = tx_buf;
+	acm->tx_size = tx_buf_size;
+	acm->rx_buf = rx_buf;
+	acm->rx_size = rx_buf_size;
+
+	acm->line_coding.dwDTERate = 115200;
+	acm->line_coding.bCharFormat = USB_CDC_1_STOP_BITS;
+	acm->line_coding.bParityType = USB_CDC_NO_PARITY;
+	acm->line_coding.bDataBits = 8;
+
+	usbd_register_set_config_callback(usbd_dev, cdcacm_set_config);
+
+	return acm;
+}
+
+/** @brief Queue data for transmission to the host.
+
+Data is sent in full packets while more is queued than fits into one. A
+partial packet is sent as soon as the endpoint is idle, or once the
+coalescing timer expires if one is set.
+
+@param[in] acm The CDC-ACM function.
+@param[in] buf Data to send.
+@param[in] len Number of bytes.
+
+@return Number of bytes queued, less than @a len if the ring is full.
+*/
+uint16_t usb_cdcacm_write(usbd_cdcacm *acm, const void *buf, uint16_t len)
+{
+	const uint8_t *data = buf;
+	const uint16_t offset = acm->tx_head & (acm->tx_size - 1);
+
+	len = MIN(len, usb_cdcacm_tx_space(acm));
+	const uint16_t first = MIN(len, acm->tx_size - offset);
+	memcpy(acm->tx_buf + offset, data, first);
+	memcpy(acm->tx_buf, data + first, len - first);
+	acm->tx_head += len;
+
+	CM_ATOMIC_BLOCK() {
+		cdcacm_tx_kick(acm, false);
+	}
+	return len;
+}
+
+/** @brief Take received data out of the receive ring.
+
+Releases the OUT endpoint again if it was throttled and there is now room
+for a full packet.
+
+@param[in] acm The CDC-ACM function.
+@param[out] buf Destination buffer.
+@param[in] len Size of @a buf.
+
+@return Number of bytes copied.
+*/
+uint16_t usb_cdcacm_read(usbd_cdcacm *acm, void *buf, uint16_t len)
+{
+	uint8_t *data = buf;
+	const uint16_t offset = acm->rx_tail & (acm->rx_size - 1);
+
+	len = MIN(len, usb_cdcacm_rx_level(acm));
+	const uint16_t first = MIN(len, acm->rx_size - offset);
+	memcpy(data, acm->rx_buf + offset, first);
+	memcpy(data + first, acm->rx_buf, len - first);
+	acm->rx_tail += len;
+
+	CM_ATOMIC_BLOCK() {
+		if (acm->rx_throttled &&
+		    acm->rx_size - usb_cdcacm_rx_level(acm) >= acm->ep_size) {
+			acm->rx_throttled = false;
+			usbd_ep_nak_set(acm->usbd_dev, acm->ep_out, 0);
+		}
+	}
+	return len;
+}
+
+/** @brief Get the free space in the transmit ring, in bytes. */
+uint16_t usb_cdcacm_tx_space(usbd_cdcacm *acm)
+{
+	return acm->tx_size - (uint16_t)(acm->tx_head - acm->tx_tail);
+}
+
+/** @brief Get the number of received bytes waiting to be read. */
+uint16_t usb_cdcacm_rx_level(usbd_cdcacm *acm)
+{
+	return acm->rx_head - acm->rx_tail;
+}
+
+/** @brief Send queued data now, without waiting for the coalescing timer. */
+void usb_cdcacm_flush(usbd_cdcacm *acm)
+{
+	CM_ATOMIC_BLOCK() {
+		cdcacm_tx_kick(acm, true);
+	}
+}
+
+/** @brief Set the transmit coalescing timer.
+
+A partial packet is held back for up to @a frames USB frames (milliseconds at
+full speed) to give the application the chance to fill it. This takes over the
+SOF callback of the device.
+
+@param[in] acm The CDC-ACM function.
+@param[in] frames Frames to hold a partial packet for, 0 disables coalescing.
+*/
+void usb_cdcacm_set_tx_coalesce(usbd_cdcacm *acm, uint8_t frames)
+{
+	acm->tx_coalesce = frames;
+	acm->tx_age = 0;
+	usbd_register_sof_callback(acm->usbd_dev, frames ? cdcacm_sof : NULL);
+}
+
+/** @brief Get the line coding last set by the host. */
+const struct usb_cdc_line_coding *usb_cdcacm_line_coding(usbd_cdcacm *acm)
+{
+	return &acm->line_coding;
+}
+
+/** @brief Get the control line state (DTR/RTS) last set by the host. */
+uint16_t usb_cdcacm_control_line_state(usbd_cdcacm *acm)
+{
+	return acm->control_line_state;
+}
+
+/** @brief Register a callback for SET_LINE_CODING requests. */
+void usb_cdcacm_register_line_coding_callback(usbd_cdcacm *acm,
+		void (*callback)(usbd_cdcacm *acm,
+				 const struct usb_cdc_line_coding *coding))
+{
+	acm->line_coding_cb = callback;
+}
+
+/** @brief Register a callback for SET_CONTROL_LINE_STATE requests. */
+void usb_cdcacm_register_control_line_callback(usbd_cdcacm *acm,
+		void (*callback)(usbd_cdcacm *acm, uint16_t state))
+{
+	acm->control_line_cb = callback;
+}
+
+/** @brief Register a callback run whenever data was received. */
+void usb_cdcacm_register_rx_callback(usbd_cdcacm *acm,
+		void (*callback)(usbd_cdcacm *acm))
+{
+	acm->rx_cb = callback;
+}
+
+/** @brief Send a SERIAL_STATE notification.
+
+@param[in] acm The CDC-ACM function.
+@param[in] state UART state bitmap, USB_CDC_SERIAL_STATE_*.
+
+@return true if the notification was queued, false if the endpoint was busy.
+*/
+bool usb_cdcacm_serial_state(usbd_cdcacm *acm, uint16_t state)
+{
+	uint8_t buf[sizeof(struct usb_cdc_notification) + 2];
+	struct usb_cdc_notification *notif = (void *)buf;
+
+	notif->bmRequestType = 0xA1;
+	notif->bNotification = USB_CDC_NOTIFY_SERIAL_STATE;
+	notif->wValue = 0;
+	notif->wIndex = acm->comm_iface;
+	notif->wLength = 2;
+	buf[sizeof(*notif)] = state & 0xff;
+	buf[sizeof(*notif) + 1] = state >> 8;
+
+	return usbd_ep_write_packet(acm->usbd_dev, acm->ep_notif, buf,
+				    sizeof(buf)) != 0;
+}
+
+/** @} */
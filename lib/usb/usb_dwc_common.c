@@ -31,6 +31,169 @@
 #define dev_base_address (usbd_dev->driver->base_address)
 #define REBASE(x)        MMIO32((x) + (dev_base_address))
 
+/* Smallest transmit FIFO the core supports, in 32-bit words. */
+#define DWC_TX_FIFO_MIN_DEPTH 16U
+
+/* Largest packet size and type per endpoint number, as used by the FIFO planner. */
+struct dwc_fifo_usage {
+	uint16_t in_size[ENDPOINT_COUNT];
+	uint8_t in_type[ENDPOINT_COUNT];
+	uint16_t out_size;
+	uint8_t out_mask;
+};
+
+static uint16_t dwc_fifo_words(const uint16_t max_size)
+{
+	return (max_size + 3U) / 4U;
+}
+
+/*
+ * Walk every alternate setting of a configuration and record the largest
+ * packet each endpoint may move, so the FIFOs fit whichever altsetting the
+ * host picks later on.
+ */
+static void dwc_fifo_scan_config(const struct usb_config_descriptor *const cfg, struct dwc_fifo_usage *const usage)
+{
+	for (size_t i = 0; i < cfg->bNumInterfaces; i++) {
+		const struct usb_interface *const iface = &cfg->interface[i];
+		for (size_t j = 0; j < iface->num_altsetting; j++) {
+			const struct usb_interface_descriptor *const alt = &iface->altsetting[j];
+			for (size_t k = 0; k < alt->bNumEndpoints; k++) {
+				const struct usb_endpoint_descriptor *const ep_desc = &alt->endpoint[k];
+				const uint8_t ep = ep_desc->bEndpointAddress & 0x7fU;
+				const uint16_t size = ep_desc->wMaxPacketSize & 0x7ffU;
+				if (ep == 0 || ep >= ENDPOINT_COUNT) {
+					continue;
+				}
+				if (ep_desc->bEndpointAddress & 0x80U) {
+					if (size > usage->in_size[ep]) {
+						usage->in_size[ep] = size;
+					}
+					usage->in_type[ep] = ep_desc->bmAttributes & USB_ENDPOINT_ATTR_TYPE;
+				} else {
+					if (size > usage->out_size) {
+						usage->out_size = size;
+					}
+					usage->out_mask |= 1U << ep;
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Size the shared receive FIFO for the largest OUT packet of any
+ * configuration. Following the core's databook this needs 5 words per
+ * control endpoint plus 8 for SETUP packets, one status word per packet,
+ * 2 words per OUT endpoint for transfer complete status and one for the
+ * global OUT NAK. Room for two maximum size packets is preferred so the
+ * core can accept a packet while the previous one is being read.
+ */
+static void dwc_fifo_plan_rx(usbd_device *const usbd_dev)
+{
+	const uint16_t mem_size = usbd_dev->driver->fifo_mem_size;
+	uint16_t rx_size = usbd_dev->driver->rx_fifo_size;
+
+	memset(usbd_dev->fifo_tx_depth, 0, sizeof(usbd_dev->fifo_tx_depth));
+	if (mem_size) {
+		uint16_t largest = usbd_dev->desc->bMaxPacketSize0;
+		uint8_t out_eps = 0;
+		for (size_t i = 0; i < usbd_dev->desc->bNumConfigurations; i++) {
+			struct dwc_fifo_usage usage = {0};
+			dwc_fifo_scan_config(&usbd_dev->config[i], &usage);
+			if (usage.out_size > largest) {
+				largest = usage.out_size;
+			}
+			const uint8_t count = __builtin_popcount(usage.out_mask);
+			if (count > out_eps) {
+				out_eps = count;
+			}
+		}
+
+		const uint16_t fixed = 13U + 2U * (out_eps + 1U) + 1U;
+		const uint16_t packet = dwc_fifo_words(largest) + 1U;
+		rx_size = fixed + 2U * packet;
+		if (rx_size > mem_size / 2U) {
+			rx_size = fixed + packet;
+		}
+	}
+
+	usbd_dev->fifo_rx_size = rx_size;
+	usbd_dev->fifo_mem_top = rx_size;
+	REBASE(OTG_GRXFSIZ) = rx_size;
+}
+
+/*
+ * Partition the transmit FIFO RAM left after the receive FIFO and EP0 between
+ * the IN endpoints of the selected configuration. Every endpoint first gets
+ * room for one packet, then isochronous and bulk endpoints are grown to hold
+ * two packets while RAM remains so a packet can be loaded while the previous
+ * one is on the bus. If even single packets do not fit, nothing is planned
+ * and endpoints are allocated linearly in setup order.
+ */
+static void dwc_fifo_plan_tx(usbd_device *const usbd_dev)
+{
+	static const uint8_t double_buffered[] = {USB_ENDPOINT_ATTR_ISOCHRONOUS, USB_ENDPOINT_ATTR_BULK};
+	const uint16_t mem_size = usbd_dev->driver->fifo_mem_size;
+	struct dwc_fifo_usage usage = {0};
+	uint16_t depth[ENDPOINT_COUNT] = {0};
+	uint16_t top = usbd_dev->fifo_mem_top_ep0;
+
+	memset(usbd_dev->fifo_tx_depth, 0, sizeof(usbd_dev->fifo_tx_depth));
+	if (!mem_size || !usbd_dev->current_config) {
+		return;
+	}
+	dwc_fifo_scan_config(&usbd_dev->config[usbd_dev->current_config - 1], &usage);
+
+	uint16_t used = 0;
+	for (size_t ep = 1; ep < ENDPOINT_COUNT; ep++) {
+		if (usage.in_size[ep]) {
+			depth[ep] = MAX(dwc_fifo_words(usage.in_size[ep]), DWC_TX_FIFO_MIN_DEPTH);
+			used += depth[ep];
+		}
+	}
+	if (top + used > mem_size) {
+		return;
+	}
+
+	for (size_t i = 0; i < sizeof(double_buffered); i++) {
+		for (size_t ep = 1; ep < ENDPOINT_COUNT; ep++) {
+			if (!usage.in_size[ep] || usage.in_type[ep] != double_buffered[i]) {
+				continue;
+			}
+			const uint16_t wanted = 2U * dwc_fifo_words(usage.in_size[ep]);
+			if (wanted > depth[ep] && top + used + wanted - depth[ep] <= mem_size) {
+				used += wanted - depth[ep];
+				depth[ep] = wanted;
+			}
+		}
+	}
+
+	for (size_t ep = 1; ep < ENDPOINT_COUNT; ep++) {
+		if (depth[ep]) {
+			usbd_dev->fifo_tx_start[ep] = top;
+			usbd_dev->fifo_tx_depth[ep] = depth[ep];
+			top += depth[ep];
+		}
+	}
+	/* Anything not in the plan is allocated linearly after it */
+	usbd_dev->fifo_mem_top = top;
+}
+
+static bool dwc_ep_is_iso(const uint32_t epctl)
+{
+	return (epctl & OTG_DIEPCTL0_EPTYP_MASK) == (USB_ENDPOINT_ATTR_ISOCHRONOUS << OTG_DIEPCTLX_EPTYP_SHIFT);
+}
+
+/*
+ * Isochronous endpoints only transfer in the frame whose parity they were
+ * armed for. Arm them for the frame following the current one.
+ */
+static uint32_t dwc_iso_next_frame(usbd_device *usbd_dev)
+{
+	return (REBASE(OTG_DSTS) & OTG_DSTS_FNSOF_ODD) ? OTG_DIEPCTLX_SEVNFRM : OTG_DIEPCTLX_SODDFRM;
+}
+
 void dwc_set_address(usbd_device *usbd_dev, uint8_t addr)
 {
 	REBASE(OTG_DCFG) = (REBASE(OTG_DCFG) & ~OTG_DCFG_DAD) | (addr << 4U);
@@ -85,7 +248,7 @@ void dwc_ep_setup(usbd_device *const usbd_dev, const uint8_t addr, const uint8_t
 		REBASE(OTG_DOEPCTL0) |= OTG_DOEPCTL0_EPENA | OTG_DIEPCTL0_SNAK;
 #endif
 
-		REBASE(OTG_GNPTXFSIZ) = ((max_size / 4) << 16) | usbd_dev->driver->rx_fifo_size;
+		REBASE(OTG_GNPTXFSIZ) = ((max_size / 4) << 16) | usbd_dev->fifo_rx_size;
 		usbd_dev->fifo_mem_top += max_size / 4;
 		usbd_dev->fifo_mem_top_ep0 = usbd_dev->fifo_mem_top;
 
@@ -94,8 +257,12 @@ void dwc_ep_setup(usbd_device *const usbd_dev, const uint8_t addr, const uint8_t
 
 	if (addr & 0x80U) {
 		/* Configure an IN endpoint */
-		REBASE(OTG_DIEPTXF(ep)) = ((max_size / 4) << 16) | usbd_dev->fifo_mem_top;
-		usbd_dev->fifo_mem_top += max_size / 4;
+		if (ep < ENDPOINT_COUNT && usbd_dev->fifo_tx_depth[ep]) {
+			REBASE(OTG_DIEPTXF(ep)) = (usbd_dev->fifo_tx_depth[ep] << 16) | usbd_dev->fifo_tx_start[ep];
+		} else {
+			REBASE(OTG_DIEPTXF(ep)) = ((max_size / 4) << 16) | usbd_dev->fifo_mem_top;
+			usbd_dev->fifo_mem_top += max_size / 4;
+		}
 
 #if defined(STM32H7)
 		/* Do not initially arm the IN endpoint - we've got nothing to send the host at first */
@@ -117,19 +284,26 @@ void dwc_ep_setup(usbd_device *const usbd_dev, const uint8_t addr, const uint8_t
 		usbd_dev->doeptsiz[ep] = OTG_DOEPSIZX_PKTCNT(1U) | (max_size & OTG_DOEPSIZX_XFRSIZ_MASK);
 		REBASE(OTG_DOEPTSIZ(ep)) = usbd_dev->doeptsiz[ep];
 		/* Make sure to arm the endpoint as part of enabling it so we can get the first data from it */
-		REBASE(OTG_DOEPCTL(ep)) = OTG_DOEPCTL0_EPENA | OTG_DIEPCTL0_CNAK | OTG_DOEPCTL0_USBAEP | OTG_DOEPCTLX_SD0PID |
+		REBASE(OTG_DOEPCTL(ep)) = OTG_DOEPCTL0_EPENA | OTG_DIEPCTL0_CNAK | OTG_DOEPCTL0_USBAEP |
+			(type == USB_ENDPOINT_ATTR_ISOCHRONOUS ? dwc_iso_next_frame(usbd_dev) : OTG_DOEPCTLX_SD0PID) |
 			(type << OTG_DIEPCTLX_EPTYP_SHIFT) | (max_size & OTG_DOEPCTLX_MPSIZ_MASK);
 
 		if (callback) {
 			usbd_dev->user_callback_ctr[ep][USB_TRANSACTION_OUT] = (void *)callback;
 		}
 	}
+
+	/* Isochronous transfers that miss their frame need cleaning up in dwc_poll() */
+	if (type == USB_ENDPOINT_ATTR_ISOCHRONOUS) {
+		REBASE(OTG_GINTMSK) |= (addr & 0x80U) ? OTG_GINTMSK_IISOIXFRM : OTG_GINTMSK_IISOOXFRM;
+	}
 }
 
 void dwc_endpoints_reset(usbd_device *usbd_dev)
 {
 	/* The core resets the endpoints automatically on reset. */
 	usbd_dev->fifo_mem_top = usbd_dev->fifo_mem_top_ep0;
+	dwc_fifo_plan_tx(usbd_dev);
 
 	/* Disable any currently active endpoints */
 	for (size_t i = 1; i < ENDPOINT_COUNT; i++) {
@@ -213,10 +387,14 @@ uint16_t dwc_ep_write_packet(usbd_device *const usbd_dev, const uint8_t addr, co
 	/* Enable endpoint for transmission. */
 	if (ep == 0U) {
 		REBASE(OTG_DIEPTSIZ(ep)) = OTG_DIEPSIZ0_PKTCNT | (len & OTG_DIEPSIZ0_XFRSIZ_MASK);
+		REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_EPENA | OTG_DIEPCTL0_CNAK;
+	} else if (dwc_ep_is_iso(REBASE(OTG_DIEPCTL(ep)))) {
+		REBASE(OTG_DIEPTSIZ(ep)) = OTG_DIEPSIZX_MCNT_1 | OTG_DIEPSIZX_PKTCNT(1) | (len & OTG_DIEPSIZX_XFRSIZ_MASK);
+		REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_EPENA | OTG_DIEPCTL0_CNAK | dwc_iso_next_frame(usbd_dev);
 	} else {
 		REBASE(OTG_DIEPTSIZ(ep)) = OTG_DIEPSIZX_PKTCNT(1) | (len & OTG_DIEPSIZX_XFRSIZ_MASK);
+		REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_EPENA | OTG_DIEPCTL0_CNAK;
 	}
-	REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_EPENA | OTG_DIEPCTL0_CNAK;
 
 	const uint8_t *const buf8 = buf;
 	/* Figure out where to copy the data to */
@@ -234,8 +412,13 @@ uint16_t dwc_ep_write_packet(usbd_device *const usbd_dev, const uint8_t addr, co
 	}
 
 	/* Enable endpoint for transmission. */
-	REBASE(OTG_DIEPTSIZ(ep)) = OTG_DIEPSIZ0_PKTCNT | (len & OTG_DIEPSIZ0_XFRSIZ_MASK);
-	REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_EPENA | OTG_DIEPCTL0_CNAK;
+	if (ep != 0U && dwc_ep_is_iso(REBASE(OTG_DIEPCTL(ep)))) {
+		REBASE(OTG_DIEPTSIZ(ep)) = OTG_DIEPSIZX_MCNT_1 | OTG_DIEPSIZX_PKTCNT(1) | (len & OTG_DIEPSIZX_XFRSIZ_MASK);
+		REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_EPENA | OTG_DIEPCTL0_CNAK | dwc_iso_next_frame(usbd_dev);
+	} else {
+		REBASE(OTG_DIEPTSIZ(ep)) = OTG_DIEPSIZ0_PKTCNT | (len & OTG_DIEPSIZ0_XFRSIZ_MASK);
+		REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_EPENA | OTG_DIEPCTL0_CNAK;
+	}
 
 	const uint32_t *buf32 = buf;
 	/* Copy buffer to endpoint FIFO, note - memcpy does not work.
@@ -360,6 +543,22 @@ static void dwc_flush_txfifo(usbd_device *usbd_dev, int ep)
 	}
 }
 
+static void dwc_iso_in_drop(usbd_device *usbd_dev, int ep)
+{
+	/* Stop the endpoint from trying to send the stale packet */
+	REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_SNAK;
+	while (!(REBASE(OTG_DIEPINT(ep)) & OTG_DIEPINTX_INEPNE)) {
+		/* idle */
+	}
+	REBASE(OTG_DIEPCTL(ep)) |= OTG_DIEPCTL0_EPDIS;
+	while (!(REBASE(OTG_DIEPINT(ep)) & OTG_DIEPINTX_EPDISD)) {
+		/* idle */
+	}
+	REBASE(OTG_DIEPINT(ep)) = OTG_DIEPINTX_EPDISD;
+	/* and throw away whatever is left of it in the FIFO */
+	dwc_flush_txfifo(usbd_dev, ep);
+}
+
 void dwc_poll(usbd_device *usbd_dev)
 {
 	/* Read interrupt status register. */
@@ -368,7 +567,7 @@ void dwc_poll(usbd_device *usbd_dev)
 	if (intsts & OTG_GINTSTS_ENUMDNE) {
 		/* Handle USB RESET condition. */
 		REBASE(OTG_GINTSTS) = OTG_GINTSTS_ENUMDNE;
-		usbd_dev->fifo_mem_top = usbd_dev->driver->rx_fifo_size;
+		dwc_fifo_plan_rx(usbd_dev);
 		_usbd_reset(usbd_dev);
 		return;
 	}
@@ -420,8 +619,11 @@ void dwc_poll(usbd_device *usbd_dev)
 			}
 #endif
 			REBASE(OTG_DOEPTSIZ(ep)) = usbd_dev->doeptsiz[ep];
-			REBASE(OTG_DOEPCTL(ep)) |=
-				OTG_DOEPCTL0_EPENA | (usbd_dev->force_nak[ep] ? OTG_DOEPCTL0_SNAK : OTG_DOEPCTL0_CNAK);
+			uint32_t doepctl = OTG_DOEPCTL0_EPENA | (usbd_dev->force_nak[ep] ? OTG_DOEPCTL0_SNAK : OTG_DOEPCTL0_CNAK);
+			if (ep != 0U && dwc_ep_is_iso(REBASE(OTG_DOEPCTL(ep)))) {
+				doepctl |= dwc_iso_next_frame(usbd_dev);
+			}
+			REBASE(OTG_DOEPCTL(ep)) |= doepctl;
 			return;
 		}
 
@@ -467,6 +669,31 @@ void dwc_poll(usbd_device *usbd_dev)
 		usbd_dev->rxbcnt = 0;
 	}
 
+	if (intsts & OTG_GINTSTS_IISOIXFR) {
+		/* An isochronous IN packet missed its frame, drop it so the next one can be queued.
+		 * Only packets armed for the frame that is ending are stale, others are still due. */
+		const uint32_t parity = (REBASE(OTG_DSTS) & OTG_DSTS_FNSOF_ODD) ? OTG_DIEPCTLX_EONUM : 0;
+		for (size_t i = 1; i < ENDPOINT_COUNT; i++) {
+			const uint32_t diepctl = REBASE(OTG_DIEPCTL(i));
+			if (dwc_ep_is_iso(diepctl) && (diepctl & OTG_DIEPCTL0_EPENA) &&
+			    (diepctl & OTG_DIEPCTLX_EONUM) == parity) {
+				dwc_iso_in_drop(usbd_dev, i);
+			}
+		}
+		REBASE(OTG_GINTSTS) = OTG_GINTSTS_IISOIXFR;
+	}
+
+	if (intsts & OTG_GINTSTS_INCOMPISOOUT) {
+		/* An isochronous OUT endpoint was armed for the wrong frame, move it to the other parity. */
+		for (size_t i = 1; i < ENDPOINT_COUNT; i++) {
+			const uint32_t doepctl = REBASE(OTG_DOEPCTL(i));
+			if (dwc_ep_is_iso(doepctl) && (doepctl & OTG_DOEPCTL0_EPENA)) {
+				REBASE(OTG_DOEPCTL(i)) |= (doepctl & OTG_DOEPCTLX_EONUM) ? OTG_DOEPCTLX_SEVNFRM : OTG_DOEPCTLX_SODDFRM;
+			}
+		}
+		REBASE(OTG_GINTSTS) = OTG_GINTSTS_INCOMPISOOUT;
+	}
+
 	if (intsts & OTG_GINTSTS_USBSUSP) {
 		if (usbd_dev->user_callback_suspend) {
 			usbd_dev->user_callback_suspend();
@@ -107,6 +107,7 @@ static usbd_device *efm32hg_usbd_init(void)
 
 	OTG_FS_GRXFSIZ = efm32hg_usb_driver.rx_fifo_size;
 	_usbd_dev.fifo_mem_top = efm32hg_usb_driver.rx_fifo_size;
+	_usbd_dev.fifo_rx_size = efm32hg_usb_driver.rx_fifo_size;
 
 	/* Unmask interrupts for TX and RX. */
 	OTG_FS_GAHBCFG |= OTG_GAHBCFG_GINT;
@@ -29,6 +29,8 @@
 
 /* Receive FIFO size in 32-bit words. */
 #define RX_FIFO_SIZE 128
+/* Total FIFO RAM in 32-bit words. */
+#define FIFO_MEM_SIZE 320
 
 static usbd_device *stm32f107_usbd_init(void);
 
@@ -49,6 +51,7 @@ const struct _usbd_driver stm32f107_usb_driver = {
 	.base_address = USB_OTG_FS_BASE,
 	.set_address_before_status = 1,
 	.rx_fifo_size = RX_FIFO_SIZE,
+	.fifo_mem_size = FIFO_MEM_SIZE,
 };
 
 /** Initialize the USB device controller hardware of the STM32. */
@@ -86,6 +89,7 @@ static usbd_device *stm32f107_usbd_init(void)
 
 	OTG_FS_GRXFSIZ = stm32f107_usb_driver.rx_fifo_size;
 	usbd_dev.fifo_mem_top = stm32f107_usb_driver.rx_fifo_size;
+	usbd_dev.fifo_rx_size = stm32f107_usb_driver.rx_fifo_size;
 
 	/* Unmask interrupts for TX and RX. */
 	OTG_FS_GAHBCFG |= OTG_GAHBCFG_GINT;
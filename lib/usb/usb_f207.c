@@ -29,6 +29,8 @@
 
 /* Receive FIFO size in 32-bit words. */
 #define RX_FIFO_SIZE 512
+/* Total FIFO RAM in 32-bit words. */
+#define FIFO_MEM_SIZE 1024
 
 static usbd_device *stm32f207_usbd_init(void);
 
@@ -49,6 +51,7 @@ const struct _usbd_driver stm32f207_usb_driver = {
 	.base_address = USB_OTG_HS_BASE,
 	.set_address_before_status = 1,
 	.rx_fifo_size = RX_FIFO_SIZE,
+	.fifo_mem_size = FIFO_MEM_SIZE,
 };
 
 /** Initialize the USB device controller hardware of the STM32. */
@@ -78,6 +81,7 @@ static usbd_device *stm32f207_usbd_init(void)
 
 	OTG_HS_GRXFSIZ = stm32f207_usb_driver.rx_fifo_size;
 	usbd_dev.fifo_mem_top = stm32f207_usb_driver.rx_fifo_size;
+	usbd_dev.fifo_rx_size = stm32f207_usb_driver.rx_fifo_size;
 
 	/* Unmask interrupts for TX and RX. */
 	OTG_HS_GAHBCFG |= OTG_GAHBCFG_GINT;
@@ -38,10 +38,13 @@ LGPL License Terms @ref lgpl_license
 #ifndef __USB_PRIVATE_H
 #define __USB_PRIVATE_H
 
+#include <libopencm3/usb/bos.h>
+
 #define MAX_USER_CONTROL_CALLBACK	4
 #define MAX_USER_SET_CONFIG_CALLBACK	4
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
 
 /* The max number of endpoints is core-dependant - for the F4 it's 4, for the H7 it's 8 */
 #if defined(STM32H7)
@@ -112,6 +115,14 @@ struct _usbd_device {
 
 	uint16_t fifo_mem_top;
 	uint16_t fifo_mem_top_ep0;
+	uint16_t fifo_rx_size;
+	/*
+	 * Transmit FIFO partitions computed by the FIFO planner when a
+	 * configuration is selected, in 32-bit words. A depth of 0 means the
+	 * endpoint was not planned and is allocated linearly as before.
+	 */
+	uint16_t fifo_tx_start[ENDPOINT_COUNT];
+	uint16_t fifo_tx_depth[ENDPOINT_COUNT];
 	uint8_t force_nak[ENDPOINT_COUNT];
 	/*
 	 * We keep a backup copy of the out endpoint size registers to restore
@@ -173,6 +184,8 @@ struct _usbd_driver {
 	uint32_t base_address;
 	bool set_address_before_status;
 	uint16_t rx_fifo_size;
+	/* Total endpoint FIFO RAM in 32-bit words, 0 disables FIFO planning */
+	uint16_t fifo_mem_size;
 };
 
 #endif
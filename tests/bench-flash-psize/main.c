@@ -0,0 +1,94 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * flash_program() throughput for each program parallelism, measured with
+ * DWT_CYCCNT and printed over ITM. The last sector of the STM32F407VG is
+ * erased and rewritten for every width, so nothing may be linked there.
+ * x64 needs an external VPP supply; build with -DBENCH_VPP to include it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/rcc.h>
+
+#define BENCH_SECTOR	11
+#define BENCH_ADDRESS	0x080E0000U
+#define BENCH_LEN	(16 * 1024)
+
+static const struct {
+	const char *name;
+	uint32_t psize;
+} widths[] = {
+	{ "x8", FLASH_CR_PROGRAM_X8 },
+	{ "x16", FLASH_CR_PROGRAM_X16 },
+	{ "x32", FLASH_CR_PROGRAM_X32 },
+#ifdef BENCH_VPP
+	{ "x64", FLASH_CR_PROGRAM_X64 },
+#endif
+};
+
+static uint8_t data[BENCH_LEN] __attribute__((aligned(8)));
+
+static uint32_t bench_width(uint32_t psize)
+{
+	uint32_t start;
+
+	flash_erase_sector(BENCH_SECTOR, FLASH_CR_PROGRAM_X32);
+	/* The data cache may still hold the old contents. */
+	flash_dcache_disable();
+	flash_dcache_reset();
+	flash_dcache_enable();
+
+	flash_set_program_parallelism(psize);
+	start = dwt_read_cycle_counter();
+	flash_program(BENCH_ADDRESS, data, BENCH_LEN);
+	return dwt_read_cycle_counter() - start;
+}
+
+int main(void)
+{
+	rcc_clock_setup_pll(&rcc_hse_8mhz_3v3[RCC_CLOCK_3V3_168MHZ]);
+
+	if (!dwt_enable_cycle_counter()) {
+		printf("no DWT cycle counter\n");
+		while (1);
+	}
+
+	for (unsigned i = 0; i < BENCH_LEN; i++) {
+		data[i] = i * 7 + (i >> 8);
+	}
+
+	flash_unlock();
+	printf("flash_program, %d bytes\n", BENCH_LEN);
+	for (unsigned i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+		uint32_t cycles = bench_width(widths[i].psize);
+		uint64_t kbps = (uint64_t)BENCH_LEN * rcc_ahb_frequency /
+				cycles / 1024;
+
+		printf("%-4s %10lu cycles %6lu KB/s%s\n", widths[i].name,
+		       (unsigned long)cycles, (unsigned long)kbps,
+		       memcmp((const void *)BENCH_ADDRESS, data, BENCH_LEN) ?
+		       " VERIFY FAILED" : "");
+	}
+	flash_lock();
+
+	while (1);
+	return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+/* The benchmarked port and pin, an output. */
+#define BENCH_PORT	GPIOD
+#define BENCH_PIN	GPIO12
+
+/* Each returns the DWT cycles taken by n calls, including the loop. */
+uint32_t bench_gpio_set_call(unsigned n);
+uint32_t bench_gpio_clear_call(unsigned n);
+uint32_t bench_gpio_toggle_call(unsigned n);
+uint32_t bench_gpio_set_inline(unsigned n);
+uint32_t bench_gpio_clear_inline(unsigned n);
+uint32_t bench_gpio_toggle_inline(unsigned n);
+
+#endif
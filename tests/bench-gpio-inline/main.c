@@ -0,0 +1,91 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Cycles per call of the out of line GPIO accessors against the
+ * LIBOPENCM3_INLINE ones, measured with DWT_CYCCNT and printed over ITM.
+ * The loop overhead is the same for both, so the difference between the
+ * columns is what the call costs.
+ */
+
+#include <stdio.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include "bench.h"
+
+#define CALLS	1000
+#define RUNS	4
+
+struct bench {
+	const char *name;
+	uint32_t (*call)(unsigned n);
+	uint32_t (*inlined)(unsigned n);
+};
+
+static const struct bench benches[] = {
+	{ "set", bench_gpio_set_call, bench_gpio_set_inline },
+	{ "clear", bench_gpio_clear_call, bench_gpio_clear_inline },
+	{ "toggle", bench_gpio_toggle_call, bench_gpio_toggle_inline },
+};
+
+/* Best of several runs, so the first one can warm the flash accelerator. */
+static uint32_t best(uint32_t (*fn)(unsigned n))
+{
+	uint32_t min = UINT32_MAX;
+
+	for (int i = 0; i < RUNS; i++) {
+		uint32_t cycles = fn(CALLS);
+
+		if (cycles < min) {
+			min = cycles;
+		}
+	}
+	return min;
+}
+
+static void print_per_call(uint32_t cycles)
+{
+	uint32_t hundredths = cycles * 100 / CALLS;
+
+	printf(" %5lu.%02lu", (unsigned long)(hundredths / 100),
+	       (unsigned long)(hundredths % 100));
+}
+
+int main(void)
+{
+	rcc_clock_setup_pll(&rcc_hse_8mhz_3v3[RCC_CLOCK_3V3_168MHZ]);
+	rcc_periph_clock_enable(RCC_GPIOD);
+	gpio_mode_setup(BENCH_PORT, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE, BENCH_PIN);
+
+	if (!dwt_enable_cycle_counter()) {
+		printf("no DWT cycle counter\n");
+		while (1);
+	}
+
+	printf("cycles per call, %d calls, best of %d\n", CALLS, RUNS);
+	printf("%-8s %8s %8s\n", "", "call", "inline");
+	for (unsigned i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		printf("%-8s", benches[i].name);
+		print_per_call(best(benches[i].call));
+		print_per_call(best(benches[i].inlined));
+		printf("\n");
+	}
+
+	while (1);
+	return 0;
+}
@@ -0,0 +1,259 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test for can_filter_compile(). Every identifier a rule asks for must
+ * pass the compiled banks, whatever the bank limit; with enough banks, no
+ * other identifier may pass and frames must go to the rule's FIFO.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libopencm3/stm32/can.h>
+
+#define STD_MASK	0x7FF
+#define EXT_MASK	0x1FFFFFFF
+#define MAX_RULES	12
+#define WORK_SIZE	512
+#define MAX_BANKS	28
+#define ITERATIONS	5000
+
+static int failures;
+
+#define CHECK(cond, ...) do {						\
+	if (!(cond)) {							\
+		printf("FAIL %s:%d: ", __func__, __LINE__);		\
+		printf(__VA_ARGS__);					\
+		printf("\n");						\
+		failures++;						\
+		return;							\
+	}								\
+} while (0)
+
+/* Small deterministic generator, so failures repeat on every host. */
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static struct can_filter_block work[WORK_SIZE];
+static struct can_filter_bank banks[MAX_BANKS];
+
+static int compile(const struct can_filter_rule *rules, uint32_t nrules,
+		   uint32_t max_banks)
+{
+	return can_filter_compile(rules, nrules, work, WORK_SIZE, banks,
+				  max_banks);
+}
+
+static bool wanted(const struct can_filter_rule *rules, uint32_t nrules,
+		   uint32_t id, bool ext)
+{
+	for (uint32_t i = 0; i < nrules; i++) {
+		if (rules[i].ext == ext && rules[i].id <= id &&
+		    id <= rules[i].last) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Every wanted identifier passes, on the rule's FIFO if exact is set. */
+static bool all_accepted(const struct can_filter_rule *rules, uint32_t nrules,
+			 int nbanks, bool exact)
+{
+	for (uint32_t i = 0; i < nrules; i++) {
+		for (uint32_t id = rules[i].id; ; id++) {
+			uint8_t fifo;
+
+			if (!can_filter_match(banks, nbanks, id, rules[i].ext,
+					      &fifo)) {
+				printf("  rule %u: %s id 0x%x dropped\n", i,
+				       rules[i].ext ? "ext" : "std", id);
+				return false;
+			}
+			if (exact && fifo != rules[i].fifo) {
+				printf("  rule %u: id 0x%x on FIFO %u\n", i,
+				       id, fifo);
+				return false;
+			}
+			if (id == rules[i].last) {
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+static void test_invalid(void)
+{
+	struct can_filter_rule r = { .id = 0x10, .last = 0x0f };
+
+	CHECK(compile(&r, 1, MAX_BANKS) == -1, "reversed range");
+	r = (struct can_filter_rule){ .id = 0x700, .last = STD_MASK + 1 };
+	CHECK(compile(&r, 1, MAX_BANKS) == -1, "standard id out of range");
+	r = (struct can_filter_rule){ .id = 0, .last = EXT_MASK + 1,
+				      .ext = true };
+	CHECK(compile(&r, 1, MAX_BANKS) == -1, "extended id out of range");
+	r = (struct can_filter_rule){ .id = 1, .last = 1, .fifo = 2 };
+	CHECK(compile(&r, 1, MAX_BANKS) == -1, "bad FIFO");
+
+	/* 1 ... 0x7fe splits into 20 blocks. */
+	r = (struct can_filter_rule){ .id = 1, .last = STD_MASK - 1 };
+	CHECK(can_filter_compile(&r, 1, work, 8, banks, MAX_BANKS) == -1,
+	      "work too small");
+	CHECK(can_filter_compile(&r, 1, work, 20, banks, MAX_BANKS) > 0,
+	      "work just big enough");
+}
+
+static void test_bank_limits(void)
+{
+	const struct can_filter_rule r[4] = {
+		{ 0x100, 0x100, false, 0 },
+		{ 0x200, 0x200, false, 1 },
+		{ 0x300, 0x300, true, 0 },
+		{ 0x400, 0x400, true, 1 },
+	};
+	int nb;
+
+	/* Each FIFO and format combination needs a bank of its own. */
+	CHECK(compile(r, 4, 0) == -1, "no banks");
+	CHECK(compile(r, 4, 3) == -1, "3 banks for 4 groups");
+	nb = compile(r, 4, 4);
+	CHECK(nb == 4, "4 groups in %d banks", nb);
+	CHECK(all_accepted(r, 4, nb, true), "4 groups");
+	CHECK(!can_filter_match(banks, nb, 0x100, true, NULL),
+	      "standard id passes as extended");
+	CHECK(!can_filter_match(banks, nb, 0x300, false, NULL),
+	      "extended id passes as standard");
+
+	CHECK(compile(r, 0, 0) == 0, "no rules");
+}
+
+static void test_full_ranges(void)
+{
+	const struct can_filter_rule std = { 0, STD_MASK, false, 1 };
+	const struct can_filter_rule ext = { 0, EXT_MASK, true, 0 };
+	uint8_t fifo;
+	int nb;
+
+	nb = compile(&std, 1, 1);
+	CHECK(nb == 1, "all standard ids in %d banks", nb);
+	CHECK(all_accepted(&std, 1, nb, true), "all standard ids");
+	CHECK(!can_filter_match(banks, nb, 0, true, NULL),
+	      "extended id passes a standard bank");
+
+	nb = compile(&ext, 1, 1);
+	CHECK(nb == 1, "all extended ids in %d banks", nb);
+	CHECK(can_filter_match(banks, nb, 0, true, &fifo) && fifo == 0 &&
+	      can_filter_match(banks, nb, EXT_MASK, true, &fifo) &&
+	      can_filter_match(banks, nb, 0x12345678, true, &fifo),
+	      "all extended ids");
+	CHECK(!can_filter_match(banks, nb, 0x7FF, false, NULL),
+	      "standard id passes an extended bank");
+}
+
+static void test_exact(void)
+{
+	const struct can_filter_rule r[5] = {
+		{ 0x000, 0x000, false, 0 },
+		{ 0x100, 0x100, false, 0 },
+		{ 0x123, 0x12f, false, 1 },
+		{ 0x7FF, 0x7FF, false, 1 },
+		{ 0x18DAF110, 0x18DAF11F, true, 0 },
+	};
+	int nb = compile(r, 5, MAX_BANKS);
+
+	CHECK(nb > 0, "compile failed");
+	CHECK(all_accepted(r, 5, nb, true), "exact rules");
+	for (uint32_t id = 0; id <= STD_MASK; id++) {
+		CHECK(wanted(r, 5, id, false) ==
+		      can_filter_match(banks, nb, id, false, NULL),
+		      "standard id 0x%x", id);
+	}
+	for (uint32_t id = 0x18DAF000; id < 0x18DAF200; id++) {
+		CHECK(wanted(r, 5, id, true) ==
+		      can_filter_match(banks, nb, id, true, NULL),
+		      "extended id 0x%x", id);
+	}
+}
+
+static void test_random(void)
+{
+	struct can_filter_rule r[MAX_RULES];
+
+	for (int iter = 0; iter < ITERATIONS; iter++) {
+		uint32_t nrules = 1 + rng() % MAX_RULES;
+		uint32_t max_banks = 4 + rng() % (MAX_BANKS - 3);
+		int nb;
+
+		for (uint32_t i = 0; i < nrules; i++) {
+			uint32_t mask;
+
+			r[i].ext = rng() & 1;
+			r[i].fifo = rng() & 1;
+			mask = r[i].ext ? EXT_MASK : STD_MASK;
+			/* Bias towards the ends of the identifier space. */
+			switch (rng() % 4) {
+			case 0:
+				r[i].id = rng() % 64;
+				break;
+			case 1:
+				r[i].id = mask - rng() % 64;
+				break;
+			default:
+				r[i].id = rng() & mask;
+				break;
+			}
+			r[i].last = r[i].id;
+			if (rng() & 1) {
+				r[i].last += rng() % (r[i].ext ? 4096 : 512);
+			}
+			if (r[i].last > mask) {
+				r[i].last = mask;
+			}
+		}
+
+		nb = compile(r, nrules, max_banks);
+		CHECK(nb >= 0 && (uint32_t)nb <= max_banks,
+		      "iteration %d: %d banks, %u allowed", iter, nb,
+		      max_banks);
+		CHECK(all_accepted(r, nrules, nb, false), "iteration %d",
+		      iter);
+	}
+}
+
+int main(void)
+{
+	test_invalid();
+	test_bank_limits();
+	test_full_ranges();
+	test_exact();
+	test_random();
+
+	if (failures) {
+		printf("%d test(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("can_filter: all tests passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,403 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test for the flash_eeprom_* store, run against a simulated NOR array.
+ * Programming can only clear bits of erased units, as on the real parts.
+ * A power budget counts programmed units; when it runs out the unit being
+ * written is torn (only some of its bits are cleared) and every later flash
+ * operation fails, until the store is mounted again. Every value must then
+ * read back as before, except that the interrupted write may or may not
+ * have taken effect.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libopencm3/stm32/common/flash_common_eeprom.h>
+
+#define NSECTORS	3
+#define SECTOR_SIZE	2048
+#define NKEYS		16
+#define MAX_LEN		48
+#define ITERATIONS	20000
+#define POWER_CUTS	2000
+
+static int failures;
+
+#define CHECK(cond, ...) do {						\
+	if (!(cond)) {							\
+		printf("FAIL %s:%d: ", __func__, __LINE__);		\
+		printf(__VA_ARGS__);					\
+		printf("\n");						\
+		failures++;						\
+		return;							\
+	}								\
+} while (0)
+
+/* Small deterministic generator, so failures repeat on every host. */
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+/* --- Simulated flash ----------------------------------------------------- */
+
+static uint8_t nor[NSECTORS][SECTOR_SIZE] __attribute__((aligned(32)));
+static unsigned nor_align;
+/* Programmed units left before the power fails, -1 for no limit */
+static long power_budget = -1;
+static bool powered_off;
+/* Programming over unerased flash, a bug in the store */
+static bool nor_misuse;
+
+static bool nor_erase(void *ctx, const struct flash_eeprom_sector *sector,
+		      uint32_t size)
+{
+	uint8_t *p = (uint8_t *)sector->base;
+
+	(void)ctx;
+	if (powered_off) {
+		return false;
+	}
+	if (power_budget == 0) {
+		/* Interrupted erase, modelled as clearing from the start. */
+		memset(p, 0xff, rng() % size);
+		powered_off = true;
+		return false;
+	}
+	memset(p, 0xff, size);
+	return true;
+}
+
+static bool nor_program(void *ctx, uintptr_t address, const void *data,
+			size_t len)
+{
+	const uint8_t *src = data;
+	uint8_t *dst = (uint8_t *)address;
+
+	(void)ctx;
+	if (powered_off) {
+		return false;
+	}
+	if ((address | len) & (nor_align - 1)) {
+		nor_misuse = true;
+		return false;
+	}
+	for (size_t unit = 0; unit < len; unit += nor_align) {
+		for (size_t i = unit; i < unit + nor_align; i++) {
+			if (dst[i] != 0xff) {
+				nor_misuse = true;
+				return false;
+			}
+		}
+		if (power_budget == 0) {
+			/* Torn unit: some of the bits to clear stay set. */
+			for (size_t i = unit; i < unit + nor_align; i++) {
+				dst[i] &= src[i] | (uint8_t)rng();
+			}
+			powered_off = true;
+			return false;
+		}
+		if (power_budget > 0) {
+			power_budget--;
+		}
+		for (size_t i = unit; i < unit + nor_align; i++) {
+			dst[i] &= src[i];
+		}
+	}
+	return true;
+}
+
+/* Blank (erased, or zeroed to look like foreign data) flash, power on. */
+static void nor_reset(uint8_t fill)
+{
+	memset(nor, fill, sizeof(nor));
+	power_budget = -1;
+	powered_off = false;
+	nor_misuse = false;
+}
+
+static const struct flash_eeprom_ops nor_ops = {
+	.erase = nor_erase,
+	.program = nor_program,
+};
+
+static struct flash_eeprom_sector sectors[NSECTORS];
+static uintptr_t index_ram[NKEYS];
+
+static void ee_setup(struct flash_eeprom *ee, unsigned align)
+{
+	memset(ee, 0, sizeof(*ee));
+	for (unsigned i = 0; i < NSECTORS; i++) {
+		sectors[i].base = (uintptr_t)nor[i];
+		sectors[i].id = i;
+	}
+	nor_align = align;
+	ee->ops = &nor_ops;
+	ee->sectors = sectors;
+	ee->nsectors = NSECTORS;
+	ee->align = align;
+	ee->sector_size = SECTOR_SIZE;
+	ee->index = index_ram;
+	ee->nkeys = NKEYS;
+}
+
+/* --- Reference model ----------------------------------------------------- */
+
+struct value {
+	int len;		/* -1: not set */
+	uint8_t data[MAX_LEN];
+};
+
+static struct value model[NKEYS];
+
+static void random_value(struct value *v)
+{
+	v->len = rng() % (MAX_LEN + 1);
+	for (int i = 0; i < v->len; i++) {
+		v->data[i] = rng();
+	}
+}
+
+static bool value_matches(struct flash_eeprom *ee, uint16_t key,
+			  const struct value *v)
+{
+	uint8_t buf[MAX_LEN];
+	int len = flash_eeprom_read(ee, key, buf, sizeof(buf));
+
+	return len == v->len && (len <= 0 || !memcmp(buf, v->data, len));
+}
+
+static bool store_matches(struct flash_eeprom *ee)
+{
+	for (uint16_t key = 0; key < NKEYS; key++) {
+		if (!value_matches(ee, key, &model[key])) {
+			printf("  key %u: stored value differs\n", key);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void model_clear(void)
+{
+	for (unsigned k = 0; k < NKEYS; k++) {
+		model[k].len = -1;
+	}
+}
+
+/* One random operation; the new value of the key is left in *v. */
+static bool random_op(struct flash_eeprom *ee, uint16_t *key, struct value *v)
+{
+	*key = rng() % NKEYS;
+	switch (rng() % 8) {
+	case 0:
+		v->len = -1;
+		return flash_eeprom_delete(ee, *key);
+	case 1:
+		/* Rewrite the same value, a no-op. */
+		*v = model[*key];
+		if (v->len < 0) {
+			return flash_eeprom_delete(ee, *key);
+		}
+		return flash_eeprom_write(ee, *key, v->data, v->len);
+	default:
+		random_value(v);
+		return flash_eeprom_write(ee, *key, v->data, v->len);
+	}
+}
+
+/* --- Tests --------------------------------------------------------------- */
+
+static void test_config(void)
+{
+	struct flash_eeprom ee;
+
+	ee_setup(&ee, 8);
+	ee.align = 2;
+	CHECK(!flash_eeprom_mount(&ee), "align 2 accepted");
+	ee.align = 12;
+	CHECK(!flash_eeprom_mount(&ee), "align 12 accepted");
+	ee.align = 64;
+	CHECK(!flash_eeprom_mount(&ee), "align 64 accepted");
+	ee_setup(&ee, 8);
+	ee.nsectors = 1;
+	CHECK(!flash_eeprom_mount(&ee), "one sector accepted");
+}
+
+static void test_basic(unsigned align)
+{
+	struct flash_eeprom ee;
+	uint8_t buf[4];
+	const uint8_t v1[3] = { 1, 2, 3 };
+
+	nor_reset(0);
+	ee_setup(&ee, align);
+	CHECK(flash_eeprom_mount(&ee), "mount of blank flash");
+	CHECK(flash_eeprom_read(&ee, 0, buf, sizeof(buf)) == -1,
+	      "empty store has a value");
+	CHECK(!flash_eeprom_write(&ee, NKEYS, v1, 3), "key out of range");
+	CHECK(!flash_eeprom_write(&ee, 0, v1, FLASH_EEPROM_DELETED),
+	      "length out of range");
+
+	CHECK(flash_eeprom_write(&ee, 3, v1, 3), "write");
+	uint32_t free = flash_eeprom_free(&ee);
+	CHECK(flash_eeprom_write(&ee, 3, v1, 3), "rewrite");
+	CHECK(flash_eeprom_free(&ee) == free, "rewrite used flash");
+	CHECK(flash_eeprom_read(&ee, 3, buf, 2) == 3 && buf[0] == 1 &&
+	      buf[1] == 2, "short read");
+	CHECK(flash_eeprom_write(&ee, 4, NULL, 0), "empty value");
+	CHECK(flash_eeprom_read(&ee, 4, buf, sizeof(buf)) == 0,
+	      "empty value read");
+
+	ee_setup(&ee, align);
+	CHECK(flash_eeprom_mount(&ee), "remount");
+	CHECK(flash_eeprom_read(&ee, 3, buf, sizeof(buf)) == 3 &&
+	      !memcmp(buf, v1, 3), "value lost on remount");
+	CHECK(flash_eeprom_delete(&ee, 3), "delete");
+	CHECK(flash_eeprom_read(&ee, 3, buf, sizeof(buf)) == -1,
+	      "deleted value read");
+	CHECK(flash_eeprom_delete(&ee, 3), "delete of unset key");
+
+	ee_setup(&ee, align);
+	CHECK(flash_eeprom_mount(&ee), "remount");
+	CHECK(flash_eeprom_read(&ee, 3, buf, sizeof(buf)) == -1,
+	      "deleted value back on remount");
+}
+
+/* Random writes with garbage collection and remounts, no power failures. */
+static void test_random(unsigned align)
+{
+	struct flash_eeprom ee;
+	unsigned moves = 0;
+
+	nor_reset(0xff);
+	ee_setup(&ee, align);
+	CHECK(flash_eeprom_format(&ee), "format");
+	model_clear();
+
+	for (int iter = 0; iter < ITERATIONS; iter++) {
+		uint8_t active = ee.active;
+		struct value v;
+		uint16_t key;
+
+		CHECK(random_op(&ee, &key, &v), "iteration %d: key %u", iter,
+		      key);
+		model[key] = v;
+		moves += ee.active != active;
+
+		if (rng() % 16 == 0) {
+			flash_eeprom_gc(&ee);
+		}
+		if (rng() % 64 == 0) {
+			ee_setup(&ee, align);
+			CHECK(flash_eeprom_mount(&ee), "iteration %d: remount",
+			      iter);
+		}
+		CHECK(!nor_misuse, "iteration %d: program over unerased flash",
+		      iter);
+		CHECK(store_matches(&ee), "iteration %d", iter);
+	}
+	CHECK(moves > 10, "only %u sector moves", moves);
+
+	/* Everything is erased by gc, except the active sector. */
+	while (flash_eeprom_gc(&ee));
+	for (uint8_t i = 0; i < NSECTORS; i++) {
+		if (i == ee.active) {
+			continue;
+		}
+		for (unsigned j = 0; j < SECTOR_SIZE; j++) {
+			CHECK(nor[i][j] == 0xff, "sector %u not erased", i);
+		}
+	}
+}
+
+/* Power fails at a random point; the store must recover on the next mount. */
+static void test_power_cuts(unsigned align)
+{
+	struct flash_eeprom ee;
+
+	nor_reset(0xff);
+	ee_setup(&ee, align);
+	CHECK(flash_eeprom_format(&ee), "format");
+	model_clear();
+
+	for (int cut = 0; cut < POWER_CUTS; cut++) {
+		struct value v;
+		uint16_t key;
+
+		powered_off = false;
+		power_budget = rng() % 400;
+		while (!powered_off) {
+			bool ok;
+
+			if (rng() % 16 == 0) {
+				flash_eeprom_gc(&ee);
+				continue;
+			}
+			ok = random_op(&ee, &key, &v);
+			if (powered_off) {
+				break;
+			}
+			CHECK(ok, "cut %d: key %u", cut, key);
+			model[key] = v;
+		}
+		power_budget = -1;
+		powered_off = false;
+
+		ee_setup(&ee, align);
+		CHECK(flash_eeprom_mount(&ee), "cut %d: mount", cut);
+		CHECK(!nor_misuse, "cut %d: program over unerased flash", cut);
+		/* The interrupted operation, if any, either happened or not. */
+		if (value_matches(&ee, key, &v)) {
+			model[key] = v;
+		}
+		CHECK(store_matches(&ee), "cut %d", cut);
+
+		/* The store must take writes again straight away. */
+		random_value(&v);
+		CHECK(flash_eeprom_write(&ee, key, v.data, v.len),
+		      "cut %d: write after mount", cut);
+		model[key] = v;
+		CHECK(store_matches(&ee), "cut %d: after write", cut);
+	}
+}
+
+int main(void)
+{
+	static const unsigned aligns[] = { 4, 8, 16, 32 };
+
+	test_config();
+	for (unsigned i = 0; i < sizeof(aligns) / sizeof(aligns[0]); i++) {
+		test_basic(aligns[i]);
+		test_random(aligns[i]);
+		test_power_cuts(aligns[i]);
+	}
+
+	if (failures) {
+		printf("%d test(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("flash_eeprom: all tests passed\n");
+	return EXIT_SUCCESS;
+}